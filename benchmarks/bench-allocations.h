@@ -0,0 +1,52 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_BENCH_ALLOCATIONS_H
+#define LIQUID_BENCH_ALLOCATIONS_H
+
+#include <benchmark/benchmark.h>
+
+#if defined(LIQUID_COUNT_ALLOCATIONS)
+#include "allocation-counter.h"
+#endif
+
+namespace bench
+{
+
+/*!
+ * \class AllocationMeter
+ * \brief reports the number of allocations per iteration of a benchmark
+ *
+ * The meter must be constructed right before the benchmark loop; 
+ * the 'allocs' and 'alloc_bytes' counters are set when it is destroyed.
+ * This does nothing unless the benchmarks are built with LIQUID_COUNT_ALLOCATIONS.
+ */
+class AllocationMeter
+{
+public:
+  explicit AllocationMeter(benchmark::State& state)
+    : m_state(state)
+  {
+
+  }
+
+  ~AllocationMeter()
+  {
+#if defined(LIQUID_COUNT_ALLOCATIONS)
+    allocation_counter::Stats stats = m_scope.stats();
+    m_state.counters["allocs"] = benchmark::Counter(static_cast<double>(stats.allocations), benchmark::Counter::kAvgIterations);
+    m_state.counters["alloc_bytes"] = benchmark::Counter(static_cast<double>(stats.bytes), benchmark::Counter::kAvgIterations);
+#endif
+  }
+
+private:
+  benchmark::State& m_state;
+#if defined(LIQUID_COUNT_ALLOCATIONS)
+  allocation_counter::Scope m_scope;
+#endif
+};
+
+} // namespace bench
+
+#endif // LIQUID_BENCH_ALLOCATIONS_H
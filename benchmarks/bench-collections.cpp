@@ -0,0 +1,361 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// Cost of the array filters as a function of the size of the array.
+
+#include "bench-data.h"
+
+#include "liquid/filter-cache.h"
+#include "liquid/filters.h"
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+#include <limits>
+
+static liquid::Array products(benchmark::State& state)
+{
+  return bench::make_products(static_cast<int>(state.range(0))).property("products").toArray();
+}
+
+static void BM_FilterWhere(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::where(a, "available", true);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_FilterUniq(benchmark::State& state)
+{
+  const liquid::Array a = liquid::ArrayFilters::map(products(state), "vendor");
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::uniq(a);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_FilterReverseSlice(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::slice(liquid::ArrayFilters::reverse(a), 1, static_cast<int>(a.length()) - 2);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_FilterPush(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::push(a, 1);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+// second argument: whether large arrays are sorted by several threads
+static void BM_FilterSortByField(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+  const size_t threshold = liquid::ArrayFilters::parallelSortThreshold();
+
+  if (!state.range(1))
+    liquid::ArrayFilters::setParallelSortThreshold(std::numeric_limits<size_t>::max());
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::sort(a, "price");
+    benchmark::DoNotOptimize(result);
+  }
+
+  liquid::ArrayFilters::setParallelSortThreshold(threshold);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_FilterSortNatural(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::ArrayFilters::sort_natural(a, "title");
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+// second argument: 0 for an array of Values, 1 for Array::fromInts(), 2 for Array::fromDoubles()
+static void BM_FilterSum(benchmark::State& state)
+{
+  const int n = static_cast<int>(state.range(0));
+  std::vector<int> ints;
+
+  for (int i(0); i < n; ++i)
+    ints.push_back(i % 1000);
+
+  liquid::Array a;
+
+  if (state.range(1) == 0)
+    a = liquid::Array(std::vector<liquid::Value>(ints.begin(), ints.end()));
+  else if (state.range(1) == 1)
+    a = liquid::Array::fromInts(ints);
+  else
+    a = liquid::Array::fromDoubles(std::vector<double>(ints.begin(), ints.end()));
+
+  for (auto _ : state)
+  {
+    liquid::Value result = liquid::ArrayFilters::sum(a);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * n);
+}
+
+static void BM_RenderSumLoop(benchmark::State& state)
+{
+  std::vector<liquid::Value> values;
+
+  for (int i(0); i < state.range(0); ++i)
+    values.push_back(i % 1000);
+
+  liquid::Map data;
+  data["values"] = liquid::Array(std::move(values));
+
+  liquid::Template tmplt = liquid::parse(state.range(1) ? "{{ values | sum }}" : "{% assign total = 0 %}{% for x in values %}{% assign total = total + x %}{% endfor %}{{ total }}");
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// orders joined with their customer, with a nested loop or through index_by
+static void render_join(benchmark::State& state, const std::string& source)
+{
+  const int n = static_cast<int>(state.range(0));
+  liquid::Array customers;
+  liquid::Array orders;
+
+  for (int i(0); i < n; ++i)
+  {
+    customers.push(liquid::Map{ {"id", i}, {"name", "customer" + std::to_string(i)} });
+    orders.push(liquid::Map{ {"customer_id", (i * 7) % n}, {"total", i} });
+  }
+
+  liquid::Map data;
+  data["customers"] = customers;
+  data["orders"] = orders;
+
+  liquid::Template tmplt = liquid::parse(source);
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_RenderJoinNestedLoop(benchmark::State& state)
+{
+  render_join(state, "{% for o in orders %}{% for c in customers %}{% if c.id == o.customer_id %}{{ c.name }}{% endif %}{% endfor %}{% endfor %}");
+}
+
+static void BM_RenderJoinIndexBy(benchmark::State& state)
+{
+  render_join(state, "{% assign by_id = customers | index_by: 'id' %}{% for o in orders %}{{ by_id[o.customer_id].name }}{% endfor %}");
+}
+
+static void BM_RenderJoinFind(benchmark::State& state)
+{
+  render_join(state, "{% for o in orders %}{% assign c = customers | find: 'id', o.customer_id %}{{ c.name }}{% endfor %}");
+}
+
+static void BM_RenderConcatSize(benchmark::State& state)
+{
+  const liquid::Array a = products(state);
+  liquid::Map data;
+  data["a"] = a;
+  data["b"] = a;
+  data["c"] = a;
+
+  liquid::Template tmplt = liquid::parse("{% assign all = a + b + c %}{{ all.size }}");
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+// builds an array one element at a time
+static void BM_RenderPushLoop(benchmark::State& state)
+{
+  std::vector<int> numbers;
+
+  for (int i(0); i < state.range(0); ++i)
+    numbers.push_back(i);
+
+  liquid::Map data;
+  data["numbers"] = liquid::Array::fromInts(numbers);
+
+  liquid::Template tmplt = liquid::parse("{% assign list = [] %}{% for n in numbers %}{% assign list = list | push: n %}{% endfor %}{{ list.size }}");
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+// a filter costing about as much as signing a URL
+static liquid::Value expensive_filter(const liquid::Value& val, liquid::FilterArguments)
+{
+  uint64_t h = 14695981039346656037ull;
+
+  for (int round(0); round < 100; ++round)
+  {
+    for (char c : val.as<std::string>())
+      h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+
+  return std::to_string(h);
+}
+
+// second argument: whether the filter is declared pure, and mapped by several threads
+static void BM_RenderMapFilter(benchmark::State& state)
+{
+  liquid::FilterRegistry::Filter filter;
+  filter.name = "sign";
+  filter.inputType = liquid::FilterRegistry::String;
+  filter.function = &expensive_filter;
+  filter.pure = state.range(1) != 0;
+
+  liquid::FilterRegistry filters = liquid::FilterRegistry::builtins();
+  filters.add(filter);
+
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Template tmplt = liquid::parse("{% assign signed = products | map: 'title' | map_filter: 'sign' %}{{ signed | last }}", filters);
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// a translation filter called with a few distinct keys;
+// second argument: 0 for an impure filter, 1 for a pure one, 2 for a pure one with a FilterCache
+static void BM_RenderMemoizedFilter(benchmark::State& state)
+{
+  liquid::FilterRegistry::Filter filter;
+  filter.name = "t";
+  filter.inputType = liquid::FilterRegistry::String;
+  filter.function = &expensive_filter;
+  filter.pure = state.range(1) != 0;
+
+  liquid::FilterRegistry filters = liquid::FilterRegistry::builtins();
+  filters.add(filter);
+
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Template tmplt = liquid::parse("{% for p in products %}{{ 'product.vendor' | t }}{{ p.vendor | t }}{% endfor %}", filters);
+  liquid::Renderer renderer;
+
+  if (state.range(1) == 2)
+    renderer.setFilterCache(std::make_shared<liquid::FilterCache>());
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  if (renderer.filterCache())
+    state.counters["hit_rate"] = renderer.filterCache()->hitRate();
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// second argument: whether the pipes are fused (copies of the builtins are not)
+static void render_pipeline(benchmark::State& state, const std::string& source)
+{
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::FilterRegistry unfused = liquid::FilterRegistry::builtins();
+
+  for (const char* name : { "map", "join", "strip", "downcase", "truncate" })
+    unfused.add(*unfused.find(name));
+
+  liquid::Template tmplt = state.range(1) ? liquid::parse(source) : liquid::parse(source, unfused);
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_RenderMapJoin(benchmark::State& state)
+{
+  render_pipeline(state, "{{ products | map: 'title' | join: ', ' }}");
+}
+
+static void BM_RenderStringChain(benchmark::State& state)
+{
+  render_pipeline(state, "{% for p in products %}{{ p.title | strip | downcase | truncate: 20 }}{% endfor %}");
+}
+
+BENCHMARK(BM_FilterWhere)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_FilterUniq)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_FilterReverseSlice)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_FilterPush)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_RenderConcatSize)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_RenderPushLoop)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_FilterSortByField)->ArgNames({ "n", "parallel" })->RangeMultiplier(16)->Ranges({ { 16, 1 << 20 }, { 0, 1 } });
+BENCHMARK(BM_FilterSortNatural)->ArgName("n")->RangeMultiplier(8)->Range(8, 1 << 15)->Complexity();
+BENCHMARK(BM_RenderJoinNestedLoop)->ArgName("n")->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+BENCHMARK(BM_RenderJoinIndexBy)->ArgName("n")->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+BENCHMARK(BM_RenderJoinFind)->ArgName("n")->RangeMultiplier(4)->Range(16, 1024)->Complexity();
+BENCHMARK(BM_FilterSum)->ArgNames({ "n", "storage" })->ArgsProduct({ { 1 << 10, 1 << 16, 1 << 20 }, { 0, 1, 2 } });
+BENCHMARK(BM_RenderSumLoop)->ArgNames({ "n", "filter" })->ArgsProduct({ { 1 << 10, 1 << 14 }, { 0, 1 } });
+BENCHMARK(BM_RenderMapJoin)->ArgNames({ "n", "fused" })->ArgsProduct({ { 64, 1 << 12, 1 << 16 }, { 0, 1 } });
+BENCHMARK(BM_RenderStringChain)->ArgNames({ "n", "fused" })->ArgsProduct({ { 64, 1 << 12 }, { 0, 1 } });
+BENCHMARK(BM_RenderMapFilter)->ArgNames({ "n", "pure" })->ArgsProduct({ { 64, 1 << 10 }, { 0, 1 } })->UseRealTime();
+BENCHMARK(BM_RenderMemoizedFilter)->ArgNames({ "n", "memo" })->ArgsProduct({ { 64, 1 << 10 }, { 0, 1, 2 } });
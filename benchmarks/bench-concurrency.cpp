@@ -0,0 +1,116 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "bench-data.h"
+#include "latency-histogram.h"
+
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// One parsed template and one data tree are shared by all the threads,
+// each thread using its own Renderer. This is the setup of a server
+// rendering the same page for concurrent requests and exposes contention
+// on shared reference counts and in the allocator.
+
+namespace
+{
+
+struct SharedState
+{
+  liquid::Template tmplt;
+  liquid::Map data;
+
+  std::mutex mutex;
+  bench::LatencyHistogram histogram;
+  int finished_threads = 0;
+  std::chrono::steady_clock::time_point first_start;
+  std::chrono::steady_clock::time_point last_end;
+  double single_thread_throughput = 0;
+};
+
+SharedState& shared_state()
+{
+  static SharedState state;
+  static std::once_flag flag;
+
+  std::call_once(flag, []() {
+    state.tmplt = liquid::parse(bench::loop_heavy_template() + bench::filter_heavy_template());
+    state.data = bench::make_products(50);
+  });
+
+  return state;
+}
+
+int max_threads()
+{
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+} // namespace
+
+static void BM_ConcurrentRender(benchmark::State& state)
+{
+  SharedState& shared = shared_state();
+  liquid::Renderer renderer;
+  bench::LatencyHistogram histogram;
+  const auto first_start = std::chrono::steady_clock::now();
+
+  for (auto _ : state)
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::string result = renderer.render(shared.tmplt, shared.data);
+    auto end = std::chrono::steady_clock::now();
+
+    benchmark::DoNotOptimize(result);
+    histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+  }
+
+  const auto last_end = std::chrono::steady_clock::now();
+
+  state.SetItemsProcessed(state.iterations());
+
+  // The last thread to finish reports the merged percentiles.
+  // Counters are summed across threads, so the other threads leave them unset.
+  std::lock_guard<std::mutex> lock{ shared.mutex };
+
+  if (shared.finished_threads == 0)
+  {
+    shared.histogram.clear();
+    shared.first_start = first_start;
+    shared.last_end = last_end;
+  }
+
+  shared.histogram.merge(histogram);
+  shared.first_start = std::min(shared.first_start, first_start);
+  shared.last_end = std::max(shared.last_end, last_end);
+
+  if (++shared.finished_threads < state.threads())
+    return;
+
+  shared.finished_threads = 0;
+
+  state.counters["p50_ns"] = static_cast<double>(shared.histogram.percentile(50));
+  state.counters["p99_ns"] = static_cast<double>(shared.histogram.percentile(99));
+  state.counters["p999_ns"] = static_cast<double>(shared.histogram.percentile(99.9));
+
+  // renders per second, all threads included
+  const double elapsed = std::chrono::duration<double>(shared.last_end - shared.first_start).count();
+  const double throughput = static_cast<double>(shared.histogram.count()) / std::max(elapsed, 1e-9);
+
+  if (state.threads() == 1)
+    shared.single_thread_throughput = throughput;
+
+  // 1.0 means perfect linear scaling relative to the single thread run
+  if (shared.single_thread_throughput > 0)
+    state.counters["scaling_efficiency"] = throughput / (state.threads() * shared.single_thread_throughput);
+}
+
+BENCHMARK(BM_ConcurrentRender)->ThreadRange(1, max_threads())->UseRealTime();
@@ -0,0 +1,240 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "bench-data.h"
+
+#include "liquid/template.h"
+
+namespace bench
+{
+
+/*!
+ * \fn std::string make_template(size_t target_size, uint64_t seed)
+ * \brief generates a template of roughly the given size
+ *
+ * The template only uses tags and filters supported by the built-in parser
+ * and renderer and is meant to be rendered with the data produced
+ * by \c{make_products()}.
+ */
+std::string make_template(size_t target_size, uint64_t seed)
+{
+  Random rng{ seed };
+  std::string result;
+  result.reserve(target_size + 256);
+
+  while (result.size() < target_size)
+  {
+    switch (rng.range(0, 7))
+    {
+    case 0:
+    case 1:
+      result += rng.sentence(rng.range(4, 16));
+      result += "\n";
+      break;
+    case 2:
+      result += "Welcome to {{ shop.name }}, {{ user.name }}!\n";
+      break;
+    case 3:
+      result += "{% if products.size > " + std::to_string(rng.range(0, 10)) + " %}Many products{% else %}Few products{% endif %}\n";
+      break;
+    case 4:
+      result += "{% for p in products %}{{ p.title }}: {{ p.price }}{% if p.available %} (in stock){% endif %}\n{% endfor %}";
+      break;
+    case 5:
+      result += "{{ products | map: 'title' | join: ', ' }}\n";
+      break;
+    case 6:
+      result += "{% assign total = " + std::to_string(rng.range(1, 100)) + " * 2 + shop.tax %}Total: {{ total }}\n";
+      break;
+    default:
+      result += "{% capture greeting %}Hi {{ user.name }}{% endcapture %}{{ greeting }}\n";
+      break;
+    }
+  }
+
+  return result;
+}
+
+/*!
+ * \fn liquid::Map make_products(int count, uint64_t seed)
+ * \brief generates a catalog of products
+ */
+liquid::Map make_products(int count, uint64_t seed)
+{
+  Random rng{ seed };
+
+  liquid::Map shop;
+  shop["name"] = "The Liquid Store";
+  shop["currency"] = "EUR";
+  shop["tax"] = 20;
+
+  liquid::Map user;
+  user["name"] = "Alice";
+  user["premium"] = true;
+
+  liquid::Array products;
+
+  for (int i(0); i < count; ++i)
+  {
+    liquid::Map p;
+    p["id"] = i;
+    p["title"] = rng.word() + " " + rng.word();
+    p["vendor"] = rng.word();
+    p["price"] = rng.range(1, 1000);
+    p["weight"] = rng.range(1, 5000) / 100.;
+    p["available"] = rng.chance(70);
+    p["description"] = rng.sentence(rng.range(8, 32));
+
+    liquid::Array tags;
+    const int nbtags = rng.range(1, 6);
+
+    for (int j(0); j < nbtags; ++j)
+      tags.push(rng.word());
+
+    p["tags"] = tags;
+
+    products.push(p);
+  }
+
+  liquid::Map data;
+  data["shop"] = shop;
+  data["user"] = user;
+  data["products"] = products;
+  return data;
+}
+
+/*!
+ * \fn std::string text_heavy_template()
+ * \brief returns a template that is mostly made of text
+ */
+std::string text_heavy_template()
+{
+  Random rng{ 3 };
+  std::string result;
+
+  for (int i(0); i < 200; ++i)
+  {
+    result += rng.sentence(24);
+    result += "\n";
+
+    if (i % 20 == 0)
+      result += "{{ shop.name }}\n";
+  }
+
+  return result;
+}
+
+/*!
+ * \fn std::string loop_heavy_template()
+ * \brief returns a template with nested loops over products and tags
+ */
+std::string loop_heavy_template()
+{
+  return
+    "{% for p in products %}"
+    "{{ forloop.index }}. {{ p.title }}"
+    "{% for t in p.tags %}{{ t }}{% if forloop.last == false %}, {% endif %}{% endfor %}"
+    "{% if p.available %} - {{ p.price }}{% else %} - sold out{% endif %}\n"
+    "{% endfor %}";
+}
+
+/*!
+ * \fn std::string filter_heavy_template()
+ * \brief returns a template that applies many filters
+ */
+std::string filter_heavy_template()
+{
+  return
+    "{% for p in products %}"
+    "{{ p.tags | join: ', ' }}|{{ p.tags | first }}|{{ p.tags | last }}|"
+    "{{ p.tags | push: 'new' | pop | concat: p.tags | join: '-' }}\n"
+    "{% endfor %}"
+    "{{ products | map: 'title' | join: ', ' }}\n"
+    "{{ products | map: 'vendor' | first }}\n";
+}
+
+/*!
+ * \fn std::string include_heavy_template()
+ * \brief returns a template that includes partials in a loop
+ *
+ * The partials must be registered with \c{add_partials()}.
+ */
+std::string include_heavy_template()
+{
+  return
+    "{% for p in products %}"
+    "{% include card with product = p and index = forloop.index %}"
+    "{% endfor %}";
+}
+
+/*!
+ * \fn std::string deeply_nested_template(int depth)
+ * \brief returns a template with deeply nested control blocks
+ *
+ * The template walks the chain of maps produced by \c{make_nested_data()}.
+ */
+std::string deeply_nested_template(int depth)
+{
+  std::string result = "{% for item in items %}{% assign n = node %}";
+
+  for (int i(0); i < depth; ++i)
+    result += "{% if n.child %}{% assign n = n.child %}<{{ n.value }}";
+
+  for (int i(0); i < depth; ++i)
+    result += ">{% endif %}";
+
+  result += "{{ item }}\n{% endfor %}";
+  return result;
+}
+
+/*!
+ * \fn liquid::Map make_nested_data(int depth)
+ * \brief generates data for \c{deeply_nested_template()}
+ */
+liquid::Map make_nested_data(int depth)
+{
+  liquid::Map node;
+  node["value"] = 0;
+
+  for (int i(1); i <= depth; ++i)
+  {
+    liquid::Map parent;
+    parent["value"] = i;
+    parent["child"] = node;
+    node = parent;
+  }
+
+  liquid::Array items;
+
+  for (int i(0); i < 50; ++i)
+    items.push(i);
+
+  liquid::Map data;
+  data["node"] = node;
+  data["items"] = items;
+  return data;
+}
+
+/*!
+ * \fn void add_partials(liquid::Renderer& renderer, int count)
+ * \brief registers the partials used by \c{include_heavy_template()}
+ *
+ * In addition to the 'card' and 'price' partials, \a count dummy
+ * partials are registered so that lookup cost is representative
+ * of a real theme.
+ */
+void add_partials(liquid::Renderer& renderer, int count)
+{
+  renderer.templates()["card"] = liquid::parse(
+    "<div>{{ include.index }}: {{ include.product.title }} by {{ include.product.vendor }}"
+    "{% assign amount = include.product.price %}{% include price with amount = amount %}</div>\n");
+
+  renderer.templates()["price"] = liquid::parse(
+    "{% if include.amount > 500 %}<b>{{ include.amount }}</b>{% else %}{{ include.amount }}{% endif %}");
+
+  for (int i(0); i < count; ++i)
+    renderer.templates()["partial_" + std::to_string(i)] = liquid::parse("partial {{ include.x }}");
+}
+
+} // namespace bench
@@ -0,0 +1,37 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_BENCH_DATA_H
+#define LIQUID_BENCH_DATA_H
+
+#include "corpus.h"
+
+#include "liquid/renderer.h"
+#include "liquid/value.h"
+
+#include <cstdint>
+#include <string>
+
+namespace bench
+{
+
+using Random = corpus::Random;
+
+std::string make_template(size_t target_size, uint64_t seed = 1);
+
+liquid::Map make_products(int count, uint64_t seed = 2);
+
+std::string text_heavy_template();
+std::string loop_heavy_template();
+std::string filter_heavy_template();
+std::string include_heavy_template();
+std::string deeply_nested_template(int depth);
+
+liquid::Map make_nested_data(int depth);
+
+void add_partials(liquid::Renderer& renderer, int count);
+
+} // namespace bench
+
+#endif // LIQUID_BENCH_DATA_H
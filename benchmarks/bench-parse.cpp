@@ -0,0 +1,46 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "bench-allocations.h"
+#include "bench-data.h"
+
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+static void parse_template(benchmark::State& state, size_t size)
+{
+  const std::string src = bench::make_template(size);
+
+  {
+    bench::AllocationMeter allocs{ state };
+
+    for (auto _ : state)
+    {
+      liquid::Template tmplt = liquid::parse(src);
+      benchmark::DoNotOptimize(tmplt);
+    }
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(src.size()));
+}
+
+static void BM_ParseSmall(benchmark::State& state)
+{
+  parse_template(state, 256);
+}
+
+static void BM_ParseMedium(benchmark::State& state)
+{
+  parse_template(state, 16 * 1024);
+}
+
+static void BM_ParseHuge(benchmark::State& state)
+{
+  parse_template(state, 1024 * 1024);
+}
+
+BENCHMARK(BM_ParseSmall);
+BENCHMARK(BM_ParseMedium);
+BENCHMARK(BM_ParseHuge)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,219 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "bench-allocations.h"
+#include "bench-data.h"
+
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+
+static void render_template(benchmark::State& state, liquid::Renderer& renderer, const liquid::Template& tmplt, const liquid::Map& data)
+{
+  size_t output_size = 0;
+
+  {
+    bench::AllocationMeter allocs{ state };
+
+    for (auto _ : state)
+    {
+      std::string result = renderer.render(tmplt, data);
+      output_size = result.size();
+      benchmark::DoNotOptimize(result);
+    }
+  }
+
+  if (!renderer.errors().empty())
+    state.SkipWithError(renderer.errors().front().message.c_str());
+
+  // throughput is measured on the produced output
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(output_size));
+}
+
+static void BM_RenderTextHeavy(benchmark::State& state)
+{
+  liquid::Template tmplt = liquid::parse(bench::text_heavy_template());
+  liquid::Map data = bench::make_products(10);
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderLoopHeavy(benchmark::State& state)
+{
+  liquid::Template tmplt = liquid::parse(bench::loop_heavy_template());
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderFilterHeavy(benchmark::State& state)
+{
+  liquid::Template tmplt = liquid::parse(bench::filter_heavy_template());
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderIncludeHeavy(benchmark::State& state)
+{
+  liquid::Template tmplt = liquid::parse(bench::include_heavy_template());
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Renderer renderer;
+  bench::add_partials(renderer, 50);
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderDeeplyNested(benchmark::State& state)
+{
+  const int depth = static_cast<int>(state.range(0));
+  liquid::Template tmplt = liquid::parse(bench::deeply_nested_template(depth));
+  liquid::Map data = bench::make_nested_data(depth);
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderMixed(benchmark::State& state)
+{
+  liquid::Template tmplt = liquid::parse(bench::make_template(16 * 1024));
+  liquid::Map data = bench::make_products(20);
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+// a n-way branch on each of 1000 values, written as an if/elsif chain
+// or as a case/when tag (which is compiled to a hash table)
+static void BM_RenderSwitch(benchmark::State& state)
+{
+  const int ways = static_cast<int>(state.range(0));
+  const bool use_case = state.range(1) != 0;
+
+  std::string src = use_case ? "{% for v in values %}{% case v %}" : "{% for v in values %}";
+
+  for (int i(0); i < ways; ++i)
+  {
+    const std::string n = std::to_string(i);
+
+    if (use_case)
+      src += "{% when " + n + " %}" + n;
+    else
+      src += (i == 0 ? "{% if v == " : "{% elsif v == ") + n + " %}" + n;
+  }
+
+  src += use_case ? "{% else %}-{% endcase %}{% endfor %}" : "{% else %}-{% endif %}{% endfor %}";
+
+  std::vector<int> values;
+
+  for (int i(0); i < 1000; ++i)
+    values.push_back((i * 7) % (ways + ways / 8 + 1));
+
+  liquid::Template tmplt = liquid::parse(src);
+  liquid::Map data;
+  data["values"] = liquid::Array::fromInts(values);
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+static void BM_RenderConditions(benchmark::State& state)
+{
+  const std::string src =
+    "{% for p in products %}"
+    "{% if p.price > 500 and p.available %}A{% elsif p.vendor == 'lorem' or p.price <= 10 %}B{% endif %}"
+    "{% if not p.available %}C{% endif %}"
+    "{% if p.id != 0 and p.title != '' and user.premium %}D{% endif %}"
+    "{% if p.weight >= 25 xor p.price < 250 %}E{% endif %}"
+    "{% endfor %}";
+
+  liquid::Template tmplt = liquid::parse(src);
+  liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+namespace
+{
+
+struct Record
+{
+  std::vector<liquid::Value> fields;
+};
+
+// adapter looking up its fields by name, as generated bindings typically do
+class RecordValue : public liquid::IValue
+{
+public:
+  Record record;
+  bool slots;
+
+  RecordValue(Record r, bool use_slots) : record(std::move(r)), slots(use_slots) { }
+
+  static const std::map<std::string, int>& fields()
+  {
+    static const std::map<std::string, int> names = {
+      { "id", 0 }, { "title", 1 }, { "price", 2 }, { "vendor", 3 }, { "owner", 4 }, { "name", 5 },
+    };
+
+    return names;
+  }
+
+  bool is_map() const override { return true; }
+  std::type_index type_index() const override { return std::type_index(typeid(Record)); }
+  void* data() override { return &record; }
+
+  liquid::Value property(const std::string& name) const override
+  {
+    auto it = fields().find(name);
+    return it != fields().end() && it->second < static_cast<int>(record.fields.size()) ? record.fields.at(it->second) : liquid::Value();
+  }
+
+  int resolve(const std::string& name) const override
+  {
+    if (!slots)
+      return -1;
+
+    auto it = fields().find(name);
+    return it != fields().end() ? it->second : -1;
+  }
+
+  liquid::Value get(int slot) const override
+  {
+    return slot < static_cast<int>(record.fields.size()) ? record.fields.at(slot) : liquid::Value();
+  }
+};
+
+} // namespace
+
+static void BM_RenderMemberAccess(benchmark::State& state)
+{
+  const bool use_slots = state.range(0) != 0;
+
+  liquid::Array records;
+
+  for (int i(0); i < 1000; ++i)
+  {
+    Record owner{ { i, nullptr, nullptr, nullptr, nullptr, "owner" + std::to_string(i % 10) } };
+    Record r{ { i, "product", i * 3, "vendor", liquid::Value(std::make_shared<RecordValue>(owner, use_slots)) } };
+    records.push(liquid::Value(std::make_shared<RecordValue>(r, use_slots)));
+  }
+
+  liquid::Map data;
+  data["records"] = records;
+
+  liquid::Template tmplt = liquid::parse(
+    "{% for r in records %}{% if r.price > 1500 %}{{ r.id }} {{ r.title }} {{ r.vendor }} {{ r.owner.name }}{% endif %}{% endfor %}");
+  liquid::Renderer renderer;
+  render_template(state, renderer, tmplt, data);
+}
+
+BENCHMARK(BM_RenderTextHeavy);
+BENCHMARK(BM_RenderLoopHeavy)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_RenderFilterHeavy)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_RenderIncludeHeavy)->Arg(10)->Arg(100);
+BENCHMARK(BM_RenderDeeplyNested)->Arg(8)->Arg(32)->Arg(128);
+BENCHMARK(BM_RenderMixed);
+BENCHMARK(BM_RenderConditions)->Arg(100)->Arg(1000);
+BENCHMARK(BM_RenderMemberAccess)->ArgName("slots")->Arg(0)->Arg(1);
+BENCHMARK(BM_RenderSwitch)->ArgNames({ "ways", "case" })->ArgsProduct({ { 8, 50 }, { 0, 1 } });
@@ -0,0 +1,159 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// Parse and render cost as a function of one dimension of the shape
+// of a generated template, all the other dimensions being fixed.
+// Google Benchmark fits the complexity of each series (BigO / RMS rows)
+// which makes super-linear growth easy to spot.
+
+#include "bench-allocations.h"
+#include "corpus.h"
+
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+static corpus::Shape base_shape()
+{
+  corpus::Shape shape;
+  shape.depth = 1;
+  shape.loopCount = 8;
+  shape.statements = 4;
+  shape.includeFanout = 0;
+  shape.expressionLength = 2;
+  shape.textRatio = 50;
+  shape.filterChainLength = 0;
+  return shape;
+}
+
+static void parse_corpus(benchmark::State& state, const corpus::Shape& shape)
+{
+  const liquid::Trace trace = corpus::generate(shape);
+
+  {
+    bench::AllocationMeter allocs{ state };
+
+    for (auto _ : state)
+    {
+      liquid::Template tmplt = liquid::parse(trace.source);
+      benchmark::DoNotOptimize(tmplt);
+    }
+  }
+
+  state.SetComplexityN(state.range(0));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(trace.source.size()));
+}
+
+static void render_corpus(benchmark::State& state, const corpus::Shape& shape)
+{
+  const liquid::Trace trace = corpus::generate(shape);
+
+  liquid::Renderer renderer;
+  liquid::Template tmplt = liquid::parse(trace.source);
+
+  for (const auto& p : trace.partials)
+    renderer.templates()[p.first] = liquid::parse(p.second);
+
+  size_t output_size = 0;
+
+  {
+    bench::AllocationMeter allocs{ state };
+
+    for (auto _ : state)
+    {
+      std::string result = renderer.render(tmplt, trace.data);
+      output_size = result.size();
+      benchmark::DoNotOptimize(result);
+    }
+  }
+
+  if (!renderer.errors().empty())
+    state.SkipWithError(renderer.errors().front().message.c_str());
+
+  state.SetComplexityN(state.range(0));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(output_size));
+}
+
+static corpus::Shape depth_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.loopCount = 2;
+  shape.depth = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape loop_count_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.loopCount = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape include_fanout_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.includeFanout = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape expression_length_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.textRatio = 0;
+  shape.expressionLength = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape statements_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.depth = 0;
+  shape.statements = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape text_ratio_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.statements = 64;
+  shape.textRatio = static_cast<int>(n);
+  return shape;
+}
+
+static corpus::Shape filter_chain_shape(int64_t n)
+{
+  corpus::Shape shape = base_shape();
+  shape.textRatio = 0;
+  shape.filterChainLength = static_cast<int>(n);
+  return shape;
+}
+
+static void BM_ParseDepth(benchmark::State& state) { parse_corpus(state, depth_shape(state.range(0))); }
+static void BM_RenderDepth(benchmark::State& state) { render_corpus(state, depth_shape(state.range(0))); }
+static void BM_RenderLoopCount(benchmark::State& state) { render_corpus(state, loop_count_shape(state.range(0))); }
+static void BM_RenderIncludeFanout(benchmark::State& state) { render_corpus(state, include_fanout_shape(state.range(0))); }
+static void BM_ParseExpressionLength(benchmark::State& state) { parse_corpus(state, expression_length_shape(state.range(0))); }
+static void BM_RenderExpressionLength(benchmark::State& state) { render_corpus(state, expression_length_shape(state.range(0))); }
+static void BM_ParseStatements(benchmark::State& state) { parse_corpus(state, statements_shape(state.range(0))); }
+static void BM_RenderStatements(benchmark::State& state) { render_corpus(state, statements_shape(state.range(0))); }
+static void BM_ParseTextRatio(benchmark::State& state) { parse_corpus(state, text_ratio_shape(state.range(0))); }
+static void BM_RenderTextRatio(benchmark::State& state) { render_corpus(state, text_ratio_shape(state.range(0))); }
+static void BM_ParseFilterChain(benchmark::State& state) { parse_corpus(state, filter_chain_shape(state.range(0))); }
+static void BM_RenderFilterChain(benchmark::State& state) { render_corpus(state, filter_chain_shape(state.range(0))); }
+
+// depth grows the rendered output exponentially (loopCount ^ depth),
+// so no complexity is fitted for these
+BENCHMARK(BM_ParseDepth)->ArgName("depth")->DenseRange(1, 10);
+BENCHMARK(BM_RenderDepth)->ArgName("depth")->DenseRange(1, 10);
+BENCHMARK(BM_RenderLoopCount)->ArgName("loops")->RangeMultiplier(4)->Range(1, 4096)->Complexity();
+BENCHMARK(BM_RenderIncludeFanout)->ArgName("includes")->RangeMultiplier(2)->Range(1, 64)->Complexity();
+BENCHMARK(BM_ParseExpressionLength)->ArgName("operands")->RangeMultiplier(4)->Range(1, 1024)->Complexity();
+BENCHMARK(BM_RenderExpressionLength)->ArgName("operands")->RangeMultiplier(4)->Range(1, 1024)->Complexity();
+BENCHMARK(BM_ParseStatements)->ArgName("statements")->RangeMultiplier(4)->Range(16, 16384)->Complexity();
+BENCHMARK(BM_RenderStatements)->ArgName("statements")->RangeMultiplier(4)->Range(16, 16384)->Complexity();
+BENCHMARK(BM_ParseTextRatio)->ArgName("text")->DenseRange(0, 100, 25);
+BENCHMARK(BM_RenderTextRatio)->ArgName("text")->DenseRange(0, 100, 25);
+BENCHMARK(BM_ParseFilterChain)->ArgName("filters")->RangeMultiplier(4)->Range(1, 256)->Complexity();
+BENCHMARK(BM_RenderFilterChain)->ArgName("filters")->RangeMultiplier(4)->Range(1, 256)->Complexity();
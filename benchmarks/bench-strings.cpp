@@ -0,0 +1,505 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// Throughput of the string primitives for each instruction set
+// (scalar, sse2, avx2) and of the string filters, from 1KB to 10MB.
+// The encoding filters are compared with straightforward implementations
+// that append one character at a time.
+
+#include "bench-data.h"
+
+#include "liquid/filters.h"
+#include "liquid/simd_p.h"
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cctype>
+
+static std::string make_text(size_t n)
+{
+  bench::Random random;
+  std::string result;
+  result.reserve(n + 16);
+
+  while (result.size() < n)
+  {
+    result += random.word();
+    result += random.chance(6) ? '\n' : ' ';
+  }
+
+  result.resize(n);
+  return result;
+}
+
+// words in French, Japanese and emojis: 1 to 4 bytes per character
+static std::string make_multilingual_text(size_t n)
+{
+  static const char* words[] = { "d\xC3\xA9j\xC3\xA0", "caf\xC3\xA9", "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", "text", "\xF0\x9F\x98\x80" };
+  bench::Random random;
+  std::string result;
+  result.reserve(n + 16);
+
+  while (result.size() < n)
+  {
+    result += words[random.range(0, 4)];
+    result += ' ';
+  }
+
+  while (result.size() > n)
+    result.pop_back();
+
+  // do not end with a truncated character
+  while (!result.empty() && (static_cast<unsigned char>(result.back()) & 0x80))
+    result.pop_back();
+
+  return result;
+}
+
+static const liquid::simd::Kernels* kernels_or_skip(benchmark::State& state)
+{
+  const auto level = static_cast<liquid::simd::Level>(state.range(1));
+  const liquid::simd::Kernels* k = liquid::simd::kernels(level);
+
+  if (!k)
+    state.SkipWithError("instruction set not supported");
+  else
+    state.SetLabel(liquid::simd::levelName(level));
+
+  return k;
+}
+
+static void BM_SimdToUpper(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+  std::string output(text.size(), '\0');
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    k->to_upper(text.data(), text.size(), &output[0]);
+    benchmark::ClobberMemory();
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdSkipSpaces(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text(static_cast<size_t>(state.range(0)), ' ');
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    size_t n = k->skip_spaces(text.data(), text.size());
+    benchmark::DoNotOptimize(n);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdFind(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+  const std::string needle = "no such sentence";
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    size_t n = k->find(text.data(), text.size(), needle.data(), needle.size());
+    benchmark::DoNotOptimize(n);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdFindHtmlSpecial(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    size_t n = k->find_html_special(text.data(), text.size());
+    benchmark::DoNotOptimize(n);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdBase64Encode(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+  std::string output(4 * ((text.size() + 2) / 3), '\0');
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    k->base64_encode(text.data(), text.size(), &output[0]);
+    benchmark::ClobberMemory();
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdCountUrlReserved(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    size_t n = k->count_url_reserved(text.data(), text.size());
+    benchmark::DoNotOptimize(n);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdUtf8Validate(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_multilingual_text(static_cast<size_t>(state.range(0)));
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    bool valid = k->utf8_validate(text.data(), text.size());
+    benchmark::DoNotOptimize(valid);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_SimdUtf8Count(benchmark::State& state)
+{
+  const liquid::simd::Kernels* k = kernels_or_skip(state);
+  const std::string text = make_multilingual_text(static_cast<size_t>(state.range(0)));
+
+  if (!k)
+    return;
+
+  for (auto _ : state)
+  {
+    size_t n = k->utf8_count(text.data(), text.size());
+    benchmark::DoNotOptimize(n);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterUpcase(benchmark::State& state)
+{
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::upcase(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterStrip(benchmark::State& state)
+{
+  const std::string text = std::string(64, ' ') + make_text(static_cast<size_t>(state.range(0))) + std::string(64, '\n');
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::strip(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterReplace(benchmark::State& state)
+{
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::replace(text, "e", "E");
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterSplit(benchmark::State& state)
+{
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    liquid::Array result = liquid::StringFilters::split(text, " ");
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// one character out of 64 has to be escaped
+static void BM_FilterEscape(benchmark::State& state)
+{
+  std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (size_t i(32); i < text.size(); i += 64)
+    text[i] = "<>&\"'"[(i / 64) % 5];
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::escape(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// words separated by spaces, with a '/' every 64 characters
+static std::string make_url_text(size_t n)
+{
+  std::string text = make_text(n);
+
+  for (size_t i(32); i < text.size(); i += 64)
+    text[i] = '/';
+
+  return text;
+}
+
+static std::string naive_url_encode(const std::string& str)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  std::string result;
+
+  for (char c : str)
+  {
+    if (std::isalnum(static_cast<unsigned char>(c)) || c == '*' || c == '-' || c == '.' || c == '_')
+    {
+      result.push_back(c);
+    }
+    else if (c == ' ')
+    {
+      result.push_back('+');
+    }
+    else
+    {
+      result.push_back('%');
+      result.push_back(hex[static_cast<unsigned char>(c) >> 4]);
+      result.push_back(hex[static_cast<unsigned char>(c) & 0xF]);
+    }
+  }
+
+  return result;
+}
+
+static std::string naive_base64_encode(const std::string& str)
+{
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string result;
+  uint32_t bits = 0;
+  int count = 0;
+
+  for (char c : str)
+  {
+    bits = (bits << 8) | static_cast<unsigned char>(c);
+    count += 8;
+
+    while (count >= 6)
+    {
+      count -= 6;
+      result.push_back(alphabet[(bits >> count) & 0x3F]);
+    }
+  }
+
+  if (count > 0)
+    result.push_back(alphabet[(bits << (6 - count)) & 0x3F]);
+
+  while (result.size() % 4 != 0)
+    result.push_back('=');
+
+  return result;
+}
+
+static void BM_FilterUrlEncode(benchmark::State& state)
+{
+  const std::string text = make_url_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::url_encode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_NaiveUrlEncode(benchmark::State& state)
+{
+  const std::string text = make_url_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = naive_url_encode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterUrlDecode(benchmark::State& state)
+{
+  const std::string text = liquid::StringFilters::url_encode(make_url_text(static_cast<size_t>(state.range(0))));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::url_decode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterBase64Encode(benchmark::State& state)
+{
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::base64_encode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_NaiveBase64Encode(benchmark::State& state)
+{
+  const std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state)
+  {
+    std::string result = naive_base64_encode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+static void BM_FilterBase64Decode(benchmark::State& state)
+{
+  const std::string text = liquid::StringFilters::base64_encode(make_text(static_cast<size_t>(state.range(0))));
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::base64_decode(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// same input as BM_FilterEscape, with an entity every 256 characters
+static void BM_FilterEscapeOnce(benchmark::State& state)
+{
+  std::string text = make_text(static_cast<size_t>(state.range(0)));
+
+  for (size_t i(32); i < text.size(); i += 64)
+    text[i] = "<>&\"'"[(i / 64) % 5];
+
+  for (size_t i(96); i + 5 < text.size(); i += 256)
+    text.replace(i, 5, "&amp;");
+
+  for (auto _ : state)
+  {
+    std::string result = liquid::StringFilters::escape_once(text);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// 256 slices of a multilingual description of n bytes in a single render;
+// the description is indexed once so that each slice is O(1)
+static void BM_RenderUtf8Slice(benchmark::State& state)
+{
+  const size_t n = static_cast<size_t>(state.range(0));
+  const std::string text = make_multilingual_text(n);
+  const int length = liquid::StringFilters::size(text);
+
+  std::vector<int> positions;
+
+  for (int i(0); i < 256; ++i)
+    positions.push_back(static_cast<int>((static_cast<int64_t>(length) * i) / 256));
+
+  liquid::Map data;
+  data["text"] = text;
+  data["positions"] = liquid::Array::fromInts(positions);
+
+  liquid::Template tmplt = liquid::parse("{% for i in positions %}{{ text | slice: i, 3 }}{{ text.size }}{% endfor %}");
+  liquid::Renderer renderer;
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetComplexityN(state.range(0));
+}
+
+static void simd_arguments(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({ "bytes", "isa" });
+
+  for (int64_t n : { 1 << 10, 64 << 10, 1 << 20, 10 << 20 })
+  {
+    for (int level : { liquid::simd::Scalar, liquid::simd::SSE2, liquid::simd::AVX2 })
+      b->Args({ n, level });
+  }
+}
+
+BENCHMARK(BM_SimdToUpper)->Apply(simd_arguments);
+BENCHMARK(BM_SimdSkipSpaces)->Apply(simd_arguments);
+BENCHMARK(BM_SimdFind)->Apply(simd_arguments);
+BENCHMARK(BM_SimdFindHtmlSpecial)->Apply(simd_arguments);
+BENCHMARK(BM_SimdBase64Encode)->Apply(simd_arguments);
+BENCHMARK(BM_SimdCountUrlReserved)->Apply(simd_arguments);
+BENCHMARK(BM_SimdUtf8Validate)->Apply(simd_arguments);
+BENCHMARK(BM_SimdUtf8Count)->Apply(simd_arguments);
+BENCHMARK(BM_FilterUpcase)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterStrip)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterReplace)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterSplit)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterEscape)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterEscapeOnce)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterUrlEncode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_NaiveUrlEncode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterUrlDecode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterBase64Encode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_NaiveBase64Encode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_FilterBase64Decode)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 10 << 20);
+BENCHMARK(BM_RenderUtf8Slice)->ArgName("bytes")->RangeMultiplier(8)->Range(1 << 10, 1 << 20)->Complexity();
@@ -0,0 +1,217 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "bench-data.h"
+
+#include "liquid/json.h"
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+#include "liquid/value.h"
+
+#include <benchmark/benchmark.h>
+
+/* Construction */
+
+static void BM_ValueConstructInt(benchmark::State& state)
+{
+  int n = 0;
+
+  for (auto _ : state)
+  {
+    liquid::Value val{ n++ };
+    benchmark::DoNotOptimize(val);
+  }
+}
+
+static void BM_ValueConstructString(benchmark::State& state)
+{
+  const std::string str = "The quick brown fox jumps over the lazy dog";
+
+  for (auto _ : state)
+  {
+    liquid::Value val{ str };
+    benchmark::DoNotOptimize(val);
+  }
+}
+
+static void BM_ValueConstructArray(benchmark::State& state)
+{
+  const int n = static_cast<int>(state.range(0));
+
+  for (auto _ : state)
+  {
+    liquid::Array array;
+
+    for (int i(0); i < n; ++i)
+      array.push(i);
+
+    benchmark::DoNotOptimize(array);
+  }
+
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+static void BM_ValueConstructMap(benchmark::State& state)
+{
+  const int n = static_cast<int>(state.range(0));
+
+  std::vector<std::string> keys;
+
+  for (int i(0); i < n; ++i)
+    keys.push_back("key" + std::to_string(i));
+
+  for (auto _ : state)
+  {
+    liquid::Map map;
+
+    for (int i(0); i < n; ++i)
+      map[keys[i]] = i;
+
+    benchmark::DoNotOptimize(map);
+  }
+
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+/* Lookup */
+
+static void BM_ValueMapLookup(benchmark::State& state)
+{
+  liquid::Map data = bench::make_products(1);
+  liquid::Map product = data.property("products").at(0).toMap();
+
+  for (auto _ : state)
+  {
+    liquid::Value val = product.property("price");
+    benchmark::DoNotOptimize(val);
+  }
+}
+
+static void BM_ValueArrayAt(benchmark::State& state)
+{
+  liquid::Map data = bench::make_products(100);
+  liquid::Value products = data.property("products");
+  size_t i = 0;
+
+  for (auto _ : state)
+  {
+    liquid::Value val = products.at(i++ % 100);
+    benchmark::DoNotOptimize(val);
+  }
+}
+
+static void BM_ValueNestedLookup(benchmark::State& state)
+{
+  liquid::Map data = bench::make_nested_data(8);
+
+  for (auto _ : state)
+  {
+    liquid::Value val = data.property("node");
+
+    for (int i(0); i < 8; ++i)
+      val = val.property("child");
+
+    benchmark::DoNotOptimize(val);
+  }
+}
+
+/* Compare */
+
+static void BM_ValueCompareInt(benchmark::State& state)
+{
+  liquid::Value a{ 42 };
+  liquid::Value b{ 43 };
+
+  for (auto _ : state)
+  {
+    int c = liquid::compare(a, b);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+static void BM_ValueCompareString(benchmark::State& state)
+{
+  liquid::Value a{ "The quick brown fox jumps over the lazy dog" };
+  liquid::Value b{ "The quick brown fox jumps over the lazy cat" };
+
+  for (auto _ : state)
+  {
+    int c = liquid::compare(a, b);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+static void BM_ValueCompareArray(benchmark::State& state)
+{
+  liquid::Map a = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Map b = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Value lhs = a.property("products");
+  liquid::Value rhs = b.property("products");
+
+  for (auto _ : state)
+  {
+    int c = liquid::compare(lhs, rhs);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+static void BM_ValueCompareMap(benchmark::State& state)
+{
+  liquid::Value lhs = bench::make_products(1).property("products").at(0);
+  liquid::Value rhs = bench::make_products(1).property("products").at(0);
+
+  for (auto _ : state)
+  {
+    int c = liquid::compare(lhs, rhs);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+/* JSON */
+
+static void BM_JsonWrite(benchmark::State& state)
+{
+  const liquid::Value products = bench::make_products(static_cast<int>(state.range(0))).property("products");
+  std::string output;
+
+  for (auto _ : state)
+  {
+    output.clear();
+    liquid::json::write(output, products);
+    benchmark::DoNotOptimize(output);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * output.size());
+}
+
+// second argument: 0 for the json filter, 1 for Renderer::JsonStringify
+static void BM_RenderJson(benchmark::State& state)
+{
+  const liquid::Map data = bench::make_products(static_cast<int>(state.range(0)));
+  liquid::Template tmplt = liquid::parse(state.range(1) ? "{{ products }}" : "{{ products | json }}");
+  liquid::Renderer renderer;
+  renderer.setStringifyMode(liquid::Renderer::JsonStringify);
+
+  for (auto _ : state)
+  {
+    std::string result = renderer.render(tmplt, data);
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+BENCHMARK(BM_ValueConstructInt);
+BENCHMARK(BM_ValueConstructString);
+BENCHMARK(BM_ValueConstructArray)->Arg(16)->Arg(1024);
+BENCHMARK(BM_ValueConstructMap)->Arg(16)->Arg(1024);
+BENCHMARK(BM_ValueMapLookup);
+BENCHMARK(BM_ValueArrayAt);
+BENCHMARK(BM_ValueNestedLookup);
+BENCHMARK(BM_ValueCompareInt);
+BENCHMARK(BM_ValueCompareString);
+BENCHMARK(BM_ValueCompareArray)->Arg(10)->Arg(100);
+BENCHMARK(BM_ValueCompareMap);
+BENCHMARK(BM_JsonWrite)->ArgName("n")->RangeMultiplier(16)->Range(16, 1 << 12);
+BENCHMARK(BM_RenderJson)->ArgNames({ "n", "mode" })->ArgsProduct({ { 64, 1 << 12 }, { 0, 1 } });
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# Copyright (C) 2021 Vincent Chambrin
+# This file is part of the liquid project
+# For conditions of distribution and use, see copyright notice in LICENSE
+
+"""Compares a run of BENCH_liquid against a baseline.
+
+The benchmark binary is run with repetitions and the per-repetition
+timings are reduced to a median and a median absolute deviation (MAD).
+A benchmark is reported as a regression only if its median is slower than
+the baseline by more than a relative threshold *and* the difference is
+larger than a multiple of the combined noise of both runs.
+
+Only the Python standard library is used.
+
+Examples:
+
+  # record a baseline
+  compare.py --binary build/benchmarks/BENCH_liquid --save-baseline baseline.json
+
+  # compare against it, exit code is 1 if a significant slowdown is detected
+  compare.py --binary build/benchmarks/BENCH_liquid --baseline baseline.json
+
+  # compare two existing result files
+  compare.py --baseline old.json --current new.json
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+# scale factor making the MAD a consistent estimator of the standard
+# deviation for normally distributed samples
+MAD_SCALE = 1.4826
+
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n == 0:
+        return float("nan")
+    if n % 2 == 1:
+        return values[n // 2]
+    return 0.5 * (values[n // 2 - 1] + values[n // 2])
+
+
+def mad(values):
+    if len(values) < 2:
+        return 0.0
+    m = median(values)
+    return MAD_SCALE * median([abs(v - m) for v in values])
+
+
+def run_benchmarks(binary, repetitions, bench_filter, min_time):
+    cmd = [binary,
+           "--benchmark_format=json",
+           "--benchmark_repetitions=%d" % repetitions,
+           "--benchmark_report_aggregates_only=false"]
+    if bench_filter:
+        cmd.append("--benchmark_filter=%s" % bench_filter)
+    if min_time:
+        cmd.append("--benchmark_min_time=%s" % min_time)
+    print("Running: %s" % " ".join(cmd), file=sys.stderr)
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE, check=True)
+    return json.loads(proc.stdout.decode("utf-8"))
+
+
+def load_json(path):
+    with open(path, "r") as f:
+        return json.load(f)
+
+
+def collect_samples(results, metric):
+    """Returns a dict mapping a benchmark name to its timings in nanoseconds.
+
+    Aggregates (mean, median, stddev...) computed by Google Benchmark are
+    ignored, the statistics are recomputed from the individual repetitions.
+    """
+    samples = {}
+    for b in results.get("benchmarks", []):
+        if b.get("run_type", "iteration") != "iteration":
+            continue
+        if "error_occurred" in b and b["error_occurred"]:
+            continue
+        name = b.get("run_name", b["name"])
+        scale = TIME_UNITS.get(b.get("time_unit", "ns"), 1.0)
+        samples.setdefault(name, []).append(float(b[metric]) * scale)
+    return samples
+
+
+def format_time(ns):
+    if math.isnan(ns):
+        return "-"
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.2f %s" % (ns / scale, unit)
+    return "%.1f ns" % ns
+
+
+def compare(baseline, current, threshold, noise_factor):
+    rows = []
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            rows.append((name, median(baseline[name]), float("nan"), None, None, "missing"))
+            continue
+        if name not in baseline:
+            rows.append((name, float("nan"), median(current[name]), None, None, "new"))
+            continue
+
+        base_med, cur_med = median(baseline[name]), median(current[name])
+        noise = math.sqrt(mad(baseline[name]) ** 2 + mad(current[name]) ** 2)
+        diff = cur_med - base_med
+        rel = diff / base_med if base_med > 0 else 0.0
+        rel_noise = noise / base_med if base_med > 0 else 0.0
+
+        significant = abs(diff) > noise_factor * noise
+        if significant and rel > threshold:
+            status = "REGRESSION"
+        elif significant and rel < -threshold:
+            status = "improvement"
+        else:
+            status = "ok"
+
+        rows.append((name, base_med, cur_med, rel, rel_noise, status))
+    return rows
+
+
+def print_table(rows, out=sys.stdout):
+    header = ("Benchmark", "Baseline", "Current", "Change", "Noise", "Status")
+    lines = []
+    for name, base, cur, rel, noise, status in rows:
+        lines.append((name, format_time(base), format_time(cur),
+                      "-" if rel is None else "%+.1f%%" % (100 * rel),
+                      "-" if noise is None else "%.1f%%" % (100 * noise),
+                      status))
+    widths = [max(len(str(r[i])) for r in [header] + lines) for i in range(len(header))]
+
+    def fmt(r):
+        return "  ".join(str(c).ljust(w) if i == 0 else str(c).rjust(w)
+                         for i, (c, w) in enumerate(zip(r, widths)))
+
+    print(fmt(header), file=out)
+    print("-" * (sum(widths) + 2 * (len(widths) - 1)), file=out)
+    for r in lines:
+        print(fmt(r), file=out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", help="path to the BENCH_liquid executable")
+    parser.add_argument("--current", help="use an existing result file instead of running the binary")
+    parser.add_argument("--baseline", help="baseline result file (JSON output of Google Benchmark)")
+    parser.add_argument("--save-baseline", metavar="PATH", help="write the current results to PATH and exit")
+    parser.add_argument("--repetitions", type=int, default=10, help="number of repetitions per benchmark (default: 10)")
+    parser.add_argument("--filter", default="", help="regular expression selecting the benchmarks to run")
+    parser.add_argument("--min-time", default="", help="value passed to --benchmark_min_time")
+    parser.add_argument("--metric", choices=("real_time", "cpu_time"), default="cpu_time",
+                        help="timing used for the comparison (default: cpu_time)")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="minimum relative slowdown, in percent, to report a regression (default: 5)")
+    parser.add_argument("--noise-factor", type=float, default=3.0,
+                        help="a change must exceed this many times the combined MAD to be significant (default: 3)")
+    args = parser.parse_args(argv)
+
+    if args.current:
+        current = load_json(args.current)
+    elif args.binary:
+        current = run_benchmarks(args.binary, args.repetitions, args.filter, args.min_time)
+    else:
+        parser.error("either --binary or --current must be provided")
+
+    if args.save_baseline:
+        with open(args.save_baseline, "w") as f:
+            json.dump(current, f, indent=2)
+        print("Baseline written to %s" % args.save_baseline)
+        return 0
+
+    if not args.baseline:
+        parser.error("--baseline is required unless --save-baseline is used")
+
+    if not os.path.exists(args.baseline):
+        print("error: baseline file '%s' does not exist (create one with --save-baseline)" % args.baseline, file=sys.stderr)
+        return 2
+
+    rows = compare(collect_samples(load_json(args.baseline), args.metric),
+                   collect_samples(current, args.metric),
+                   args.threshold / 100.0, args.noise_factor)
+    print_table(rows)
+
+    regressions = [r for r in rows if r[5] == "REGRESSION"]
+    improvements = [r for r in rows if r[5] == "improvement"]
+    print("\n%d regression(s), %d improvement(s), %d benchmark(s) compared"
+          % (len(regressions), len(improvements), len(rows)))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
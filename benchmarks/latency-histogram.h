@@ -0,0 +1,136 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_LATENCY_HISTOGRAM_H
+#define LIQUID_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace bench
+{
+
+/*!
+ * \class LatencyHistogram
+ * \brief records latencies in log-linear buckets
+ *
+ * Like an HDR histogram, values are grouped by power of two and each
+ * power of two is divided in a fixed number of linear sub-buckets.
+ * With 64 sub-buckets, the relative error of a reported percentile
+ * is below 1/64 (~1.6%) whatever the magnitude of the value, while
+ * recording is a couple of integer operations and never allocates.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr int SubBucketBits = 6;
+  static constexpr int SubBucketCount = 1 << SubBucketBits;
+  static constexpr int MaxExponent = 48; // ~3 days in nanoseconds
+
+  LatencyHistogram()
+    : m_counts(static_cast<size_t>((MaxExponent + 1) * SubBucketCount), 0)
+  {
+
+  }
+
+  void record(uint64_t value)
+  {
+    ++m_counts[index_of(value)];
+    ++m_total;
+  }
+
+  void merge(const LatencyHistogram& other)
+  {
+    for (size_t i(0); i < m_counts.size(); ++i)
+      m_counts[i] += other.m_counts[i];
+
+    m_total += other.m_total;
+  }
+
+  void clear()
+  {
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_total = 0;
+  }
+
+  uint64_t count() const { return m_total; }
+
+  /*!
+   * \fn uint64_t percentile(double p) const
+   * \brief returns the value below which a given percentage of the recorded values fall
+   *
+   * The returned value is the upper bound of the bucket containing the percentile.
+   */
+  uint64_t percentile(double p) const
+  {
+    if (m_total == 0)
+      return 0;
+
+    uint64_t rank = static_cast<uint64_t>(p / 100. * static_cast<double>(m_total) + 0.5);
+    rank = rank == 0 ? 1 : (rank > m_total ? m_total : rank);
+
+    uint64_t seen = 0;
+
+    for (size_t i(0); i < m_counts.size(); ++i)
+    {
+      seen += m_counts[i];
+
+      if (seen >= rank)
+        return upper_bound_of(i);
+    }
+
+    return upper_bound_of(m_counts.size() - 1);
+  }
+
+protected:
+  static size_t index_of(uint64_t value)
+  {
+    if (value < SubBucketCount)
+      return static_cast<size_t>(value);
+
+    int exponent = 63 - count_leading_zeros(value);
+
+    if (exponent > MaxExponent)
+      return static_cast<size_t>((MaxExponent + 1) * SubBucketCount - 1);
+
+    // values in [2^exponent, 2^(exponent+1)) are split in SubBucketCount buckets
+    const int shift = exponent - SubBucketBits;
+    const uint64_t sub = (value >> shift) - SubBucketCount;
+    return static_cast<size_t>((exponent - SubBucketBits + 1) * SubBucketCount + static_cast<int>(sub));
+  }
+
+  static uint64_t upper_bound_of(size_t index)
+  {
+    if (index < SubBucketCount)
+      return static_cast<uint64_t>(index);
+
+    const int group = static_cast<int>(index / SubBucketCount);
+    const uint64_t sub = index % SubBucketCount;
+    const int shift = group - 1;
+    return ((SubBucketCount + sub + 1) << shift) - 1;
+  }
+
+  static int count_leading_zeros(uint64_t value)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    int n = 0;
+
+    for (uint64_t mask = uint64_t(1) << 63; mask != 0 && (value & mask) == 0; mask >>= 1)
+      ++n;
+
+    return n;
+#endif
+  }
+
+private:
+  std::vector<uint64_t> m_counts;
+  uint64_t m_total = 0;
+};
+
+} // namespace bench
+
+#endif // LIQUID_LATENCY_HISTOGRAM_H
@@ -0,0 +1,92 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_CACHE_P_H
+#define LIQUID_CACHE_P_H
+
+#include "liquid/filter-cache.h"
+#include "liquid/utf8_p.h"
+#include "liquid/value_p.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace liquid
+{
+
+/*!
+ * \class RenderCache
+ * \brief holds data computed by filters that is reused during a render
+ */
+class LIQUID_API RenderCache
+{
+public:
+
+  /*!
+   * \class Index
+   * \brief the elements of an array grouped by the value of one of their property
+   */
+  struct Index
+  {
+    std::vector<liquid::Value> keys; // in order of first appearance
+    std::unordered_map<liquid::Value, std::vector<liquid::Value>, ValueHash, ValueEqual> groups;
+    liquid::Value byKey; // Map built by index_by, lazily
+    liquid::Value byGroup; // Map built by group_by, lazily
+  };
+
+  RenderCache();
+  ~RenderCache();
+
+  static RenderCache* current();
+
+  static std::shared_ptr<Index> index(const liquid::Array& a, const std::string& field);
+  static std::shared_ptr<const utf8::Index> utf8Index(const liquid::Value& str);
+
+  liquid::Value call(const std::shared_ptr<const FilterRegistry::Filter>& filter, const liquid::Value& input, FilterArguments args);
+
+  const std::shared_ptr<FilterCache>& filterCache() const;
+  void setFilterCache(std::shared_ptr<FilterCache> cache);
+
+  void clear();
+
+  /*!
+   * \class Scope
+   * \brief makes a cache the current one on this thread
+   */
+  class LIQUID_API Scope
+  {
+  public:
+    explicit Scope(RenderCache& cache);
+    ~Scope();
+
+  private:
+    RenderCache* m_previous;
+  };
+
+private:
+  typedef std::pair<const IValue*, std::string> IndexKey;
+
+  // the array is kept alive so that its address is not reused during the render
+  std::map<IndexKey, std::pair<std::shared_ptr<IValue>, std::shared_ptr<Index>>> m_indexes;
+  std::unordered_map<const IValue*, std::pair<std::shared_ptr<IValue>, std::shared_ptr<const utf8::Index>>> m_utf8_indexes;
+  std::unordered_map<FilterCall, liquid::Value, FilterCallHash> m_results;
+  std::shared_ptr<FilterCache> m_filter_cache;
+};
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
+
+#endif // LIQUID_CACHE_P_H
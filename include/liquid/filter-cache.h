@@ -0,0 +1,85 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_FILTER_CACHE_H
+#define LIQUID_FILTER_CACHE_H
+
+#include "liquid/filter.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace liquid
+{
+
+/*!
+ * \class FilterCall
+ * \brief a pure filter together with its input and arguments
+ */
+struct LIQUID_API FilterCall
+{
+  std::shared_ptr<const FilterRegistry::Filter> filter;
+  liquid::Value input;
+  std::vector<liquid::Value> arguments;
+  size_t hash = 0;
+
+  FilterCall(std::shared_ptr<const FilterRegistry::Filter> f, const liquid::Value& in, FilterArguments args);
+
+  static bool isMemoizable(const liquid::Value& in, FilterArguments args);
+
+  bool operator==(const FilterCall& other) const;
+};
+
+struct FilterCallHash
+{
+  size_t operator()(const FilterCall& call) const { return call.hash; }
+};
+
+/*!
+ * \class FilterCache
+ * \brief a bounded, thread-safe cache of the results of pure filters
+ */
+class LIQUID_API FilterCache
+{
+public:
+  explicit FilterCache(size_t capacity = 4096);
+  FilterCache(const FilterCache&) = delete;
+  ~FilterCache();
+
+  size_t capacity() const;
+  size_t size() const;
+
+  bool find(const FilterCall& call, liquid::Value& result);
+  void insert(const FilterCall& call, const liquid::Value& result);
+
+  void clear();
+
+  size_t hits() const;
+  size_t misses() const;
+  double hitRate() const;
+
+  FilterCache& operator=(const FilterCache&) = delete;
+
+private:
+  typedef std::list<std::pair<FilterCall, liquid::Value>> Entries;
+
+  size_t m_capacity;
+  mutable std::mutex m_mutex;
+  Entries m_entries; // most recently used first
+  std::unordered_map<FilterCall, Entries::iterator, FilterCallHash> m_index;
+  std::atomic<size_t> m_hits;
+  std::atomic<size_t> m_misses;
+};
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
+
+#endif // LIQUID_FILTER_CACHE_H
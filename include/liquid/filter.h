@@ -7,52 +7,289 @@
 
 #include "liquid-defs.h"
 
+#include "liquid/errors.h"
 #include "liquid/value.h"
 
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+
 namespace liquid
 {
 
-namespace filters
+/*!
+ * \class FilterArguments
+ * \brief a read-only view over the arguments of a filter
+ *
+ * The arguments are not owned by this class; when called by the renderer,
+ * they live in a small buffer on the stack of the caller.
+ */
+class FilterArguments
+{
+public:
+  FilterArguments() : m_data(nullptr), m_size(0) { }
+  FilterArguments(const liquid::Value* data, size_t size) : m_data(data), m_size(size) { }
+  FilterArguments(const std::vector<liquid::Value>& values) : m_data(values.data()), m_size(values.size()) { }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const liquid::Value* begin() const { return m_data; }
+  const liquid::Value* end() const { return m_data + m_size; }
+
+  const liquid::Value& front() const { return m_data[0]; }
+  const liquid::Value& back() const { return m_data[m_size - 1]; }
+
+  const liquid::Value& operator[](size_t i) const { return m_data[i]; }
+  const liquid::Value& at(size_t i) const
+  {
+    if (i >= m_size)
+      throw std::out_of_range("FilterArguments::at()");
+
+    return m_data[i];
+  }
+
+private:
+  const liquid::Value* m_data;
+  size_t m_size;
+};
+
+/*!
+ * \endclass
+ */
+
+/*!
+ * \class FilterRegistry
+ * \brief maps filter names to their implementation
+ */
+class LIQUID_API FilterRegistry
+{
+public:
+  enum Type {
+    Any,
+    Bool,
+    Int,
+    Double,
+    String,
+    Array,
+    Map,
+  };
+
+  typedef std::function<liquid::Value(const liquid::Value&, FilterArguments)> Function;
+
+  struct LIQUID_API Filter
+  {
+    std::string name;
+    Function function;
+    Type inputType = Any;
+    std::vector<Type> argumentTypes;
+    size_t requiredArguments = 0;
+    bool rawOutput = false;
+    bool pure = false;
+
+    bool acceptsArgumentCount(size_t n) const { return n >= requiredArguments && n <= argumentTypes.size(); }
+
+    liquid::Value operator()(const liquid::Value& object, FilterArguments args) const;
+  };
+
+public:
+  FilterRegistry();
+  FilterRegistry(const FilterRegistry&) = default;
+  FilterRegistry(FilterRegistry&&) noexcept = default;
+  ~FilterRegistry();
+
+  static const FilterRegistry& builtins();
+
+  void add(Filter filter);
+  void add(const std::string& name, Function func, Type input, std::vector<Type> args = {});
+
+  template<typename R, typename...Args>
+  void add(const std::string& name, R(*func)(Args...));
+
+  void remove(const std::string& name);
+  void setPure(const std::string& name, bool pure = true);
+
+  std::shared_ptr<const Filter> find(const std::string& name) const;
+  bool contains(const std::string& name) const;
+  size_t size() const;
+
+  static Filter mapFilter(std::shared_ptr<const Filter> filter);
+
+  static bool matches(Type type, const liquid::Value& val);
+  static std::string typeName(Type type);
+
+  template<typename T>
+  static Type typeOf();
+
+  FilterRegistry& operator=(const FilterRegistry&) = default;
+  FilterRegistry& operator=(FilterRegistry&&) noexcept = default;
+
+private:
+  std::unordered_map<std::string, std::shared_ptr<const Filter>> m_filters;
+};
+
+/*!
+ * \endclass
+ */
+
+namespace details
 {
 
-template<typename R, typename T>
-liquid::Value apply(R(*f)(T), const liquid::Value& obj, const std::vector<liquid::Value>& args)
+// C++11 replacement for std::index_sequence
+template<size_t...I> struct index_sequence { };
+template<size_t N, size_t...I> struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> { };
+template<size_t...I> struct make_index_sequence<0, I...> { typedef index_sequence<I...> type; };
+
+/*
+ * Describes how a Value is passed to a parameter of type T of a filter.
+ * Types stored in a GenericValue are passed by reference, without copy.
+ */
+template<typename T>
+struct filter_arg
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Any;
+  static bool check(const liquid::Value& val) { return val.is<T>(); }
+  static T& get(const liquid::Value& val) { return val.as<T>(); }
+};
+
+template<> struct filter_arg<bool>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Bool;
+  static bool check(const liquid::Value& val) { return val.is<bool>(); }
+  static bool& get(const liquid::Value& val) { return val.as<bool>(); }
+};
+
+template<> struct filter_arg<int>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Int;
+  static bool check(const liquid::Value& val) { return val.is<int>(); }
+  static int& get(const liquid::Value& val) { return val.as<int>(); }
+};
+
+template<> struct filter_arg<double>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Double;
+  static bool check(const liquid::Value& val) { return val.is<double>(); }
+  static double& get(const liquid::Value& val) { return val.as<double>(); }
+};
+
+template<> struct filter_arg<std::string>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::String;
+  static bool check(const liquid::Value& val) { return val.is<std::string>(); }
+  static std::string& get(const liquid::Value& val) { return val.as<std::string>(); }
+};
+
+template<> struct filter_arg<liquid::Value>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Any;
+  static bool check(const liquid::Value&) { return true; }
+  static const liquid::Value& get(const liquid::Value& val) { return val; }
+};
+
+template<> struct filter_arg<liquid::Array>
+{
+  static constexpr FilterRegistry::Type type = FilterRegistry::Array;
+  static bool check(const liquid::Value& val) { return val.isArray(); }
+  static liquid::Array get(const liquid::Value& val) { return val.toArray(); }
+};
+
+template<> struct filter_arg<liquid::Map>
 {
-  using U = typename std::remove_const<typename std::remove_reference<T>::type>::type;
+  static constexpr FilterRegistry::Type type = FilterRegistry::Map;
+  static bool check(const liquid::Value& val) { return val.isMap(); }
+  static liquid::Map get(const liquid::Value& val) { return val.toMap(); }
+};
 
-  if (args.size() != 0)
-    throw std::runtime_error("Invalid argument count for filter");
+template<typename T>
+using filter_arg_t = filter_arg<typename std::remove_const<typename std::remove_reference<T>::type>::type>;
 
-  return f(obj.as<U>());
+inline bool check_all(std::initializer_list<bool> checks)
+{
+  for (bool c : checks)
+  {
+    if (!c)
+      return false;
+  }
+
+  return true;
 }
 
-template<typename R, typename T1, typename T2>
-liquid::Value apply(R(*f)(T1, T2), const liquid::Value& obj, const std::vector<liquid::Value>& args)
+template<typename R, typename T, typename...Args, size_t...I>
+liquid::Value invoke(R(*f)(T, Args...), const liquid::Value& obj, FilterArguments args, index_sequence<I...>)
 {
-  using U1 = typename std::remove_const<typename std::remove_reference<T1>::type>::type;
-  using U2 = typename std::remove_const<typename std::remove_reference<T2>::type>::type;
+  (void)args; // unused by filters without arguments
 
-  if (args.size() != 1)
-    throw std::runtime_error("Invalid argument count for filter");
+  if (!filter_arg_t<T>::check(obj) || !check_all({ true, filter_arg_t<Args>::check(args[I])... }))
+    throw EvaluationException{ "Invalid argument type for filter" };
 
-  return f(obj.as<U1>(), args.at(0).as<U2>());
+  return f(filter_arg_t<T>::get(obj), filter_arg_t<Args>::get(args[I])...);
 }
 
-template<typename R, typename T1, typename T2, typename T3>
-liquid::Value apply(R(*f)(T1, T2, T3), const liquid::Value& obj, const std::vector<liquid::Value>& args)
+} // namespace details
+
+template<typename T>
+inline FilterRegistry::Type FilterRegistry::typeOf()
+{
+  return details::filter_arg_t<T>::type;
+}
+
+namespace filters
 {
-  using U1 = typename std::remove_const<typename std::remove_reference<T1>::type>::type;
-  using U2 = typename std::remove_const<typename std::remove_reference<T2>::type>::type;
-  using U3 = typename std::remove_const<typename std::remove_reference<T3>::type>::type;
 
-  if (args.size() != 2)
-    throw std::runtime_error("Invalid argument count for filter");
+/*!
+ * \fn liquid::Value apply(R(*f)(T, Args...), const liquid::Value& obj, FilterArguments args)
+ * \brief calls a C++ function as a filter
+ *
+ * The object the filter is applied to is passed as the first parameter of the function
+ * and the arguments as the following ones.
+ * The number and the types of the arguments are deduced from the signature of the function;
+ * an EvaluationException is thrown if they do not match.
+ * Parameters of type bool, int, double and std::string (or any type stored in a GenericValue)
+ * are bound by reference to the values; liquid::Value, liquid::Array and liquid::Map
+ * parameters are also supported.
+ */
+template<typename R, typename T, typename...Args>
+liquid::Value apply(R(*f)(T, Args...), const liquid::Value& obj, FilterArguments args)
+{
+  if (args.size() != sizeof...(Args))
+    throw EvaluationException{ "Invalid argument count for filter" };
 
-  return f(obj.as<U1>(), args.at(0).as<U2>(), args.at(1).as<U3>());
+  using Indices = typename details::make_index_sequence<sizeof...(Args)>::type;
+  return details::invoke(f, obj, args, Indices());
 }
 
 } // namespace filters
 
+/*!
+ * \fn void add(const std::string& name, R(*func)(Args...))
+ * \brief registers a function as a filter
+ *
+ * The first parameter of the function receives the object the filter is applied to,
+ * the other parameters receive the arguments of the filter (see \c{filters::apply()}).
+ * Their types are used to check the arguments when the template is parsed and
+ * before the function is called.
+ */
+template<typename R, typename...Args>
+inline void FilterRegistry::add(const std::string& name, R(*func)(Args...))
+{
+  static_assert(sizeof...(Args) >= 1, "a filter must take at least one parameter");
+
+  std::vector<Type> types{ typeOf<Args>()... };
+
+  Filter filter;
+  filter.name = name;
+  filter.inputType = types.front();
+  filter.argumentTypes.assign(types.begin() + 1, types.end());
+  filter.requiredArguments = filter.argumentTypes.size();
+  filter.function = [func](const liquid::Value& object, FilterArguments args) -> liquid::Value {
+    return filters::apply(func, object, args);
+  };
+
+  add(std::move(filter));
+}
+
 } // namespace liquid
 
 #endif // LIQUID_FILTER_H
@@ -23,6 +23,58 @@ public:
   static liquid::Array map(const liquid::Array& a, const std::string& field);
   static liquid::Array push(const liquid::Array& a, const liquid::Value& elem);
   static liquid::Array pop(const liquid::Array& a);
+  static liquid::Array where(const liquid::Array& a, const std::string& field);
+  static liquid::Array where(const liquid::Array& a, const std::string& field, const liquid::Value& value);
+  static liquid::Array uniq(const liquid::Array& a);
+  static liquid::Array compact(const liquid::Array& a);
+  static liquid::Array reverse(const liquid::Array& a);
+  static liquid::Array slice(const liquid::Array& a, int start, int length = 1);
+  static liquid::Map index_by(const liquid::Array& a, const std::string& field);
+  static liquid::Map group_by(const liquid::Array& a, const std::string& field);
+  static liquid::Value find(const liquid::Array& a, const std::string& field, const liquid::Value& value);
+  static liquid::Value sum(const liquid::Array& a);
+  static liquid::Value sum(const liquid::Array& a, const std::string& field);
+  static liquid::Value min(const liquid::Array& a);
+  static liquid::Value max(const liquid::Array& a);
+  static liquid::Value average(const liquid::Array& a);
+  static liquid::Array sort(const liquid::Array& a);
+  static liquid::Array sort(const liquid::Array& a, const std::string& field);
+  static liquid::Array sort_natural(const liquid::Array& a);
+  static liquid::Array sort_natural(const liquid::Array& a, const std::string& field);
+
+  static liquid::Array map_filter(const liquid::Array& a, const FilterRegistry::Filter& filter, FilterArguments args);
+
+  static size_t parallelSortThreshold();
+  static void setParallelSortThreshold(size_t n);
+  static size_t parallelMapThreshold();
+  static void setParallelMapThreshold(size_t n);
+};
+
+class LIQUID_API StringFilters
+{
+public:
+  static std::string upcase(const std::string& str);
+  static std::string downcase(const std::string& str);
+  static std::string capitalize(const std::string& str);
+  static std::string strip(const std::string& str);
+  static std::string lstrip(const std::string& str);
+  static std::string rstrip(const std::string& str);
+  static std::string replace(const std::string& str, const std::string& search, const std::string& replacement);
+  static std::string remove(const std::string& str, const std::string& search);
+  static liquid::Array split(const std::string& str, const std::string& sep);
+  static std::string truncate(const std::string& str, int length, const std::string& ellipsis = "...");
+  static std::string truncatewords(const std::string& str, int words, const std::string& ellipsis = "...");
+  static std::string slice(const std::string& str, int start, int length = 1);
+  static std::string prepend(const liquid::Value& val, const liquid::Value& str);
+  static std::string append(const liquid::Value& val, const liquid::Value& str);
+  static int size(const liquid::Value& val);
+  static std::string newline_to_br(const std::string& str);
+  static std::string escape(const std::string& str);
+  static std::string escape_once(const std::string& str);
+  static std::string url_encode(const std::string& str);
+  static std::string url_decode(const std::string& str);
+  static std::string base64_encode(const std::string& str);
+  static std::string base64_decode(const std::string& str);
 };
 
 class LIQUID_API BuiltinFilters
@@ -0,0 +1,33 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_FUSION_P_H
+#define LIQUID_FUSION_P_H
+
+#include "liquid/objects.h"
+
+namespace liquid
+{
+
+class Renderer;
+
+namespace fusion
+{
+
+// maximum number of string filters evaluated in a single pass
+constexpr size_t MaxStringChain = 8;
+
+LIQUID_API objects::Pipe::Fusion analyze(const objects::Pipe& pipe);
+LIQUID_API liquid::Value eval(Renderer& r, const objects::Pipe& pipe);
+
+} // namespace fusion
+
+} // namespace liquid
+
+#endif // LIQUID_FUSION_P_H
@@ -0,0 +1,29 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_JSON_H
+#define LIQUID_JSON_H
+
+#include "liquid/liquid-defs.h"
+
+#include "liquid/value.h"
+
+#include <string>
+
+namespace liquid
+{
+
+namespace json
+{
+
+LIQUID_API void write(std::string& output, const liquid::Value& val);
+LIQUID_API std::string stringify(const liquid::Value& val);
+
+LIQUID_API liquid::Value parse(const std::string& str);
+
+} // namespace json
+
+} // namespace liquid
+
+#endif // LIQUID_JSON_H
@@ -20,6 +20,7 @@ public:
 
   bool isObject() const override { return true; }
   virtual liquid::Value accept(Renderer& renderer) = 0;
+  virtual bool acceptCondition(Renderer& renderer);
 };
 
 } // namespace liquid
@@ -6,6 +6,10 @@
 #define LIQUID_OBJECTS_H
 
 #include "liquid/object.h"
+#include "liquid/filter.h"
+
+#include <atomic>
+#include <typeinfo>
 
 namespace liquid
 {
@@ -20,6 +24,7 @@ public:
   ~Value() = default;
 
   liquid::Value accept(Renderer& r) override;
+  bool acceptCondition(Renderer& r) override;
 
 public:
   liquid::Value value;
@@ -50,6 +55,37 @@ public:
   std::shared_ptr<Object> index;
 };
 
+/*!
+ * \class InlineCache
+ * \brief remembers the property slot of the types seen by a member access
+ */
+class LIQUID_API InlineCache
+{
+public:
+  InlineCache() = default;
+  InlineCache(const InlineCache&) = delete;
+  ~InlineCache();
+
+  // maximum number of types cached by a member access
+  static constexpr int MaxEntries = 4;
+
+  bool lookup(const IValue& val, int& slot) const;
+  void store(const IValue& val, int slot);
+
+  InlineCache& operator=(const InlineCache&) = delete;
+
+private:
+  struct Entry
+  {
+    const std::type_info* type;
+    int slot;
+    int depth;
+    Entry* next;
+  };
+
+  std::atomic<Entry*> m_head{ nullptr };
+};
+
 class MemberAccess : public Object
 {
 public:
@@ -61,6 +97,7 @@ public:
 public:
   std::shared_ptr<Object> object;
   std::string name;
+  mutable InlineCache cache;
 };
 
 class BinOp : public Object
@@ -86,6 +123,7 @@ public:
   ~BinOp() = default;
 
   liquid::Value accept(Renderer& r) override;
+  bool acceptCondition(Renderer& r) override;
 
 public:
   Operation operation;
@@ -100,6 +138,7 @@ public:
   ~LogicalNot() = default;
 
   liquid::Value accept(Renderer& r) override;
+  bool acceptCondition(Renderer& r) override;
 
 public:
   std::shared_ptr<Object> object;
@@ -114,10 +153,19 @@ public:
 
   liquid::Value accept(Renderer& r) override;
 
+  enum Fusion {
+    NotFused,
+    MapJoin,
+    StringChain,
+  };
+
 public:
   std::shared_ptr<Object> object;
   std::string filterName;
   std::vector<std::shared_ptr<Object>> arguments;
+  std::shared_ptr<const FilterRegistry::Filter> filter;
+  bool overridable = false; // builtin filter resolved by a non-strict parse
+  Fusion fusion = NotFused;
 };
 
 } // namespace objects
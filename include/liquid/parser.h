@@ -124,6 +124,12 @@ public:
 
   std::vector<std::shared_ptr<liquid::templates::Node>> parse(const std::string& document);
 
+  const FilterRegistry& filters() const;
+  void setFilters(const FilterRegistry& filters);
+
+  bool strictFilters() const;
+  void setStrictFilters(bool on = true);
+
 protected:
   void readNode();
   virtual void dispatchNode(std::shared_ptr<liquid::templates::Node> n);
@@ -145,6 +151,9 @@ protected:
   void process_tag_elsif(const Token& keyword, std::vector<Token>& tokens);
   void process_tag_else(const Token& keyword, std::vector<Token>& tokens);
   void process_tag_endif(const Token& keyword, std::vector<Token>& tokens);
+  void process_tag_case(const Token& keyword, std::vector<Token>& tokens);
+  void process_tag_when(const Token& keyword, std::vector<Token>& tokens);
+  void process_tag_endcase(const Token& keyword, std::vector<Token>& tokens);
   void process_tag_for(const Token& keyword, std::vector<Token>& tokens);
   void process_tag_break(const Token& keyword, std::vector<Token>& tokens);
   void process_tag_continue(const Token& keyword, std::vector<Token>& tokens);
@@ -161,6 +170,8 @@ private:
   size_t mPosition;
   std::string mDocument;
   Tokenizer mTokenizer;
+  const FilterRegistry* mFilters;
+  bool mStrictFilters;
   std::vector<std::shared_ptr<liquid::templates::Node>> mNodes;
   std::vector<std::shared_ptr<liquid::templates::Node>> mStack;
 };
@@ -10,6 +10,7 @@
 #include "liquid/objects.h"
 #include "liquid/tags.h"
 
+#include <functional>
 #include <map>
 
 /*!
@@ -19,6 +20,11 @@
 namespace liquid
 {
 
+class FilterCache;
+class RenderCache;
+class Trace;
+class TraceRecorder;
+
 /*!
  * \class Renderer
  * \brief base class for renderers
@@ -38,8 +44,38 @@ public:
 
   std::string render(const Template& t, const liquid::Map& data);
 
+  enum Escaping {
+    NoEscaping,
+    HtmlEscaping,
+    CustomEscaping,
+  };
+
+  typedef std::function<std::string(const std::string&)> EscapeFunction;
+
+  void setEscaping(Escaping mode);
+  void setEscaping(EscapeFunction func);
+  Escaping escaping() const;
+
+  enum StringifyMode {
+    LiquidStringify,
+    JsonStringify,
+  };
+
+  void setStringifyMode(StringifyMode mode);
+  StringifyMode stringifyMode() const;
+
+  bool virtualFilterDispatch() const;
+
+  void setFilterCache(std::shared_ptr<FilterCache> cache);
+  const std::shared_ptr<FilterCache>& filterCache() const;
+
+  void setRecording(bool on);
+  bool isRecording() const;
+  const Trace& trace() const;
+
   liquid::Value eval(const std::shared_ptr<Object>& obj);
   std::vector<liquid::Value> eval(const std::vector<std::shared_ptr<Object>>& objects);
+  liquid::Value evalFilter(const objects::Pipe& pipe, const liquid::Value& object, FilterArguments args);
 
   void process(const std::shared_ptr<Template::Node>& node);
   void process(const std::vector<std::shared_ptr<Template::Node>>& nodes);
@@ -64,12 +100,14 @@ public:
   const std::vector<Error>& errors() const;
 
   static bool evalCondition(const liquid::Value& val);
+  bool evalBool(const std::shared_ptr<Object>& obj);
 
   /* Tags */
   void visitTag(const tags::Assign& tag);
   void visitTag(const tags::Capture& tag);
   void visitTag(const tags::For& tag);
   void visitTag(const tags::If& tag);
+  void visitTag(const tags::Case& tag);
   void visitTag(const tags::Break& tag);
   void visitTag(const tags::Continue& tag);
   void visitTag(const tags::Eject& tag);
@@ -86,10 +124,18 @@ public:
   liquid::Value visitObject(const objects::LogicalNot& obj);
   liquid::Value visitObject(const objects::Pipe& pipe);
 
+  /* Conditions */
+  bool visitCondition(const objects::Value& val);
+  bool visitCondition(const objects::BinOp& binop);
+  bool visitCondition(const objects::LogicalNot& op);
+
 protected:
   const Template& model() const;
 
+  void setVirtualFilterDispatch(bool on = true);
+
   void write(const std::string& str);
+  void writeEscaped(const std::string& str);
 
   void record(const EvaluationException& ex);
   virtual void log(const EvaluationException& ex);
@@ -119,6 +165,12 @@ private:
   std::string m_result;
   std::vector<Error> m_errors;
   std::map<std::string, Template> m_templates;
+  std::shared_ptr<TraceRecorder> m_recorder;
+  std::shared_ptr<RenderCache> m_cache;
+  Escaping m_escaping;
+  EscapeFunction m_escape_function;
+  StringifyMode m_stringify_mode;
+  bool m_virtual_filter_dispatch;
 };
 
 /*!
@@ -0,0 +1,99 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_SIMD_P_H
+#define LIQUID_SIMD_P_H
+
+#include "liquid/liquid-defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace liquid
+{
+
+namespace simd
+{
+
+enum Level {
+  Scalar,
+  SSE2,
+  AVX2,
+};
+
+/*!
+ * \class Kernels
+ * \brief string primitives implemented for a given instruction set
+ *
+ * Functions that search for something return the length of the input
+ * if nothing was found.
+ */
+struct Kernels
+{
+  Level level;
+
+  // writes the ASCII upper/lower case version of src into dst (which may be src)
+  void(*to_upper)(const char* src, size_t n, char* dst);
+  void(*to_lower)(const char* src, size_t n, char* dst);
+
+  // returns the offset of the first (resp. one past the last) non-whitespace character
+  size_t(*skip_spaces)(const char* str, size_t n);
+  size_t(*skip_spaces_backward)(const char* str, size_t n);
+
+  size_t(*find_char)(const char* str, size_t n, char c);
+  size_t(*find)(const char* str, size_t n, const char* needle, size_t m);
+
+  // returns the offset of the first of the characters <>&"'
+  size_t(*find_html_special)(const char* str, size_t n);
+
+  // returns the offset of the first of the characters "\ or of a control character
+  size_t(*find_json_special)(const char* str, size_t n);
+
+  // returns the offset of the first character that is not an ASCII letter, a digit or one of *-._
+  size_t(*find_url_reserved)(const char* str, size_t n);
+  // returns the number of characters found by find_url_reserved, spaces excluded
+  size_t(*count_url_reserved)(const char* str, size_t n);
+  // returns the offset of the first of the characters %+
+  size_t(*find_url_escape)(const char* str, size_t n);
+
+  // returns whether str is valid UTF-8
+  bool(*utf8_validate)(const char* str, size_t n);
+  // returns the number of bytes that are not UTF-8 continuation bytes
+  // (the number of code points of valid UTF-8)
+  size_t(*utf8_count)(const char* str, size_t n);
+
+  // writes the 4 * ((n + 2) / 3) characters of the base64 encoding of src into dst
+  void(*base64_encode)(const char* src, size_t n, char* dst);
+
+  // minmax functions require n > 0
+  int64_t(*sum_int)(const int* values, size_t n);
+  double(*sum_double)(const double* values, size_t n);
+  void(*minmax_int)(const int* values, size_t n, int* min, int* max);
+  void(*minmax_double)(const double* values, size_t n, double* min, double* max);
+};
+
+LIQUID_API const Kernels* kernels(Level level);
+LIQUID_API const Kernels& kernels();
+
+LIQUID_API const char* levelName(Level level);
+
+LIQUID_API void escape_html(const char* str, size_t n, std::string& out);
+LIQUID_API void escape_html_once(const char* str, size_t n, std::string& out);
+
+inline bool is_space(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+} // namespace simd
+
+} // namespace liquid
+
+#endif // LIQUID_SIMD_P_H
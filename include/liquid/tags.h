@@ -9,6 +9,8 @@
 
 #include "liquid/object.h"
 
+#include <unordered_map>
+
 namespace liquid
 {
 
@@ -102,6 +104,32 @@ public:
   std::vector<Block> blocks;
 };
 
+class Case : public Tag
+{
+public:
+  struct When
+  {
+    std::vector<std::shared_ptr<Object>> values; // empty for the 'else' block
+    std::vector<std::shared_ptr<templates::Node>> body;
+  };
+
+  typedef std::unordered_map<liquid::Value, std::vector<size_t>, ValueHash, ValueEqual> DispatchTable;
+
+  Case(std::shared_ptr<Object> expr, size_t off = std::numeric_limits<size_t>::max());
+  ~Case() = default;
+
+  void accept(Renderer& r);
+
+  bool hasElse() const;
+  void compile();
+
+public:
+  std::shared_ptr<Object> object;
+  std::vector<When> whens;
+  bool hashed = false;
+  DispatchTable dispatch;
+};
+
 class Eject : public Tag
 {
 public:
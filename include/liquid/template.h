@@ -146,7 +146,10 @@ private:
  * \endclass
  */
 
+class FilterRegistry;
+
 LIQUID_API Template parse(const std::string& str, std::string filepath = {});
+LIQUID_API Template parse(const std::string& str, const FilterRegistry& filters, std::string filepath = {});
 LIQUID_API Template parseFile(std::string filepath);
 
 /*!
@@ -0,0 +1,63 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_THREAD_POOL_P_H
+#define LIQUID_THREAD_POOL_P_H
+
+#include "liquid/liquid-defs.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace liquid
+{
+
+/*!
+ * \class ThreadPool
+ * \brief a fixed set of worker threads used by the filters that split their work
+ */
+class LIQUID_API ThreadPool
+{
+public:
+  explicit ThreadPool(size_t nthreads);
+  ThreadPool(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  static ThreadPool& global();
+
+  size_t size() const;
+
+  void parallelFor(size_t n, size_t chunks, const std::function<void(size_t, size_t)>& func);
+
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+protected:
+  void post(std::function<void()> task);
+  void work();
+
+private:
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+};
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
+
+#endif // LIQUID_THREAD_POOL_P_H
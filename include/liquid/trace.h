@@ -0,0 +1,59 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_TRACE_H
+#define LIQUID_TRACE_H
+
+#include "liquid/liquid-defs.h"
+
+#include "liquid/value.h"
+
+#include <map>
+#include <string>
+
+namespace liquid
+{
+
+/*!
+ * \class Trace
+ * \brief a self-contained recording of a render
+ *
+ * A trace holds the source of a template, the source of the templates it
+ * included and the subset of the data that was accessed while rendering it.
+ * It can be saved as a JSON bundle and replayed later, for example to
+ * reproduce a slow render outside of the application that produced it.
+ */
+class LIQUID_API Trace
+{
+public:
+  std::string filePath;
+  std::string source;
+  std::map<std::string, std::string> partials;
+  liquid::Map data;
+
+public:
+  Trace();
+  Trace(const Trace&) = default;
+  Trace(Trace&&) noexcept = default;
+  ~Trace() = default;
+
+  void anonymize();
+
+  std::string toJson() const;
+  static Trace fromJson(const std::string& str);
+
+  void save(const std::string& filepath) const;
+  static Trace load(const std::string& filepath);
+
+  Trace& operator=(const Trace&) = default;
+  Trace& operator=(Trace&&) noexcept = default;
+};
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
+
+#endif // LIQUID_TRACE_H
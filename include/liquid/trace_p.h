@@ -0,0 +1,91 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_TRACE_P_H
+#define LIQUID_TRACE_P_H
+
+#include "liquid/trace.h"
+
+#include "liquid/value_p.h"
+
+namespace liquid
+{
+
+class Template;
+
+/*!
+ * \class RecordingValue
+ * \brief wraps an array or a map and records the accesses to its elements
+ *
+ * Every element read through this object is copied into a shadow
+ * value; arrays and maps are themselves wrapped so that the shadow
+ * only contains the parts of the data that were accessed.
+ *
+ * Recorded values are read-only: they do not report the type_index of
+ * the wrapped value and are therefore never writable.
+ */
+class LIQUID_API RecordingValue : public IValue
+{
+public:
+  liquid::Value source;
+  liquid::Value shadow;
+
+public:
+  RecordingValue(liquid::Value src, liquid::Value shdw);
+
+  static liquid::Value wrap(const liquid::Value& src, liquid::Value& shadow_slot);
+
+  bool is_array() const override;
+  bool is_map() const override;
+
+  std::type_index type_index() const override;
+  void* data() override;
+
+  size_t length() const override;
+  Value at(size_t index) const override;
+
+  std::set<std::string> propertyNames() const override;
+  Value property(const std::string& name) const override;
+};
+
+/*!
+ * \class RecordingRootValue
+ * \brief the root of the data while recording
+ *
+ * This is a writable map so that 'global' assignments work as usual,
+ * but they are not propagated to the recorded data.
+ * Variables that are not found in the map are looked up in the source
+ * data and recorded.
+ */
+class LIQUID_API RecordingRootValue : public MapValue
+{
+public:
+  liquid::Map source;
+  liquid::Map shadow;
+
+public:
+  RecordingRootValue(liquid::Map src, liquid::Map shdw);
+
+  std::set<std::string> propertyNames() const override;
+  Value property(const std::string& name) const override;
+};
+
+class LIQUID_API TraceRecorder
+{
+public:
+  Trace trace;
+
+public:
+  liquid::Map start(const Template& tmplt, const liquid::Map& data);
+  void recordPartial(const std::string& name, const Template& tmplt);
+};
+
+} // namespace liquid
+
+#endif // LIQUID_TRACE_P_H
@@ -0,0 +1,81 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// WARNING: This file is part of the private API of the library,
+//          it may change in a non backward compatible way between minor
+//          release without notice.
+//          You've been warned!
+
+#ifndef LIQUID_UTF8_P_H
+#define LIQUID_UTF8_P_H
+
+#include "liquid/value.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace liquid
+{
+
+namespace utf8
+{
+
+// strings shorter than this are never indexed
+constexpr size_t IndexThreshold = 256;
+
+LIQUID_API bool valid(const char* str, size_t n);
+LIQUID_API size_t length(const char* str, size_t n);
+LIQUID_API size_t offset(const char* str, size_t n, size_t index);
+
+/*!
+ * \class Index
+ * \brief byte offsets of every Stride-th character of a string
+ */
+class LIQUID_API Index
+{
+public:
+  static constexpr size_t Stride = 64;
+
+  Index(const char* str, size_t n);
+
+  size_t length() const;
+  size_t offset(size_t index) const;
+
+private:
+  const char* m_data;
+  size_t m_size;
+  size_t m_length;
+  std::vector<size_t> m_points; // empty if each character is a single byte
+};
+
+/*!
+ * \class Text
+ * \brief gives access to the characters of a string by index
+ */
+class LIQUID_API Text
+{
+public:
+  Text(const char* str, size_t n);
+  explicit Text(const liquid::Value& str);
+
+  size_t length() const;
+  size_t offset(size_t index) const;
+  std::string substr(size_t index, size_t count) const;
+
+  std::string slice(int start, int length) const;
+  std::string truncate(int length, const std::string& ellipsis) const;
+
+private:
+  const char* m_data;
+  size_t m_size;
+  size_t m_length;
+  std::shared_ptr<const Index> m_index;
+};
+
+} // namespace utf8
+
+} // namespace liquid
+
+#endif // LIQUID_UTF8_P_H
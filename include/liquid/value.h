@@ -68,6 +68,9 @@ public:
 
   virtual std::set<std::string> propertyNames() const;
   virtual Value property(const std::string& name) const;
+
+  virtual int resolve(const std::string& name) const;
+  virtual Value get(int slot) const;
 };
 
 /*!
@@ -173,6 +176,9 @@ public:
 
   explicit Array(std::shared_ptr<IValue> impl);
 
+  static Array fromInts(std::vector<int> vals);
+  static Array fromDoubles(std::vector<double> vals);
+
   size_t length() const;
   Value at(size_t index) const;
 
@@ -185,6 +191,9 @@ public:
 
   const std::shared_ptr<IValue>& impl() const;
 
+private:
+  void detach();
+
 private:
   std::shared_ptr<IValue> d;
 };
@@ -231,6 +240,18 @@ private:
  */
 
 LIQUID_API int compare(const Value& lhs, const Value& rhs);
+LIQUID_API size_t hash(const Value& val);
+
+// hash and equality functors compatible with liquid::compare()
+struct ValueHash
+{
+  size_t operator()(const Value& val) const { return liquid::hash(val); }
+};
+
+struct ValueEqual
+{
+  bool operator()(const Value& a, const Value& b) const { return liquid::compare(a, b) == 0; }
+};
 
 } // namespace liquid
 
@@ -45,6 +45,151 @@ public:
   Value at(size_t index) const override;
 };
 
+/*!
+ * \class NumberArrayValue
+ * \brief an array of ints or doubles stored contiguously
+ *
+ * Elements are boxed when they are accessed with \c{at()}; 
+ * numeric filters (e.g. \c{sum}) read the vector directly.
+ */
+template<typename T>
+class NumberArrayValue : public IValue
+{
+public:
+  std::vector<T> values;
+
+public:
+  explicit NumberArrayValue(std::vector<T> vals) : values(std::move(vals)) { }
+
+  bool is_array() const override { return true; }
+
+  std::type_index type_index() const override { return std::type_index(typeid(std::vector<T>)); }
+  void* data() override { return &values; }
+
+  size_t length() const override { return values.size(); }
+  Value at(size_t index) const override { return values.at(index); }
+};
+
+/*!
+ * \class ArrayViewValue
+ * \brief a read-only view over a range of an array, possibly reversed
+ */
+class LIQUID_API ArrayViewValue : public IValue
+{
+public:
+  Array source;
+  size_t offset;
+  size_t count;
+  bool reversed;
+
+public:
+  ArrayViewValue(Array src, size_t off, size_t n, bool rev = false);
+
+  static Array slice(const Array& a, size_t off, size_t n);
+  static Array reverse(const Array& a);
+
+  bool is_array() const override;
+
+  std::type_index type_index() const override;
+
+  size_t length() const override;
+  Value at(size_t index) const override;
+};
+
+/*!
+ * \class ConcatArrayValue
+ * \brief a read-only concatenation of arrays
+ */
+class LIQUID_API ConcatArrayValue : public IValue
+{
+public:
+  std::vector<Array> sources;
+  std::vector<size_t> ends;
+
+public:
+  ConcatArrayValue();
+
+  static Array concat(const Array& a, const Array& b);
+
+  bool is_array() const override;
+
+  std::type_index type_index() const override;
+
+  size_t length() const override;
+  Value at(size_t index) const override;
+
+protected:
+  void add(const Array& a);
+};
+
+/*!
+ * \class PersistentVectorValue
+ * \brief a read-only array that can be appended to with structural sharing
+ *
+ * The elements follow a prefix array, which is not copied, and are stored in
+ * a 32-way trie of immutable nodes, the last (up to) 32 of them being kept
+ * apart in a tail. Pushing or popping an element copies the tail and the
+ * path to a leaf, but never the whole array.
+ */
+class LIQUID_API PersistentVectorValue : public IValue
+{
+public:
+  static constexpr size_t Bits = 5;
+  static constexpr size_t Width = 1 << Bits;
+
+  struct Node
+  {
+    std::vector<std::shared_ptr<const Node>> children;
+    std::vector<Value> values;
+  };
+
+  Array prefix;
+  size_t count;
+  size_t shift;
+  std::shared_ptr<const Node> root;
+  std::shared_ptr<const std::vector<Value>> tail;
+
+public:
+  explicit PersistentVectorValue(Array pre);
+
+  static Array push(const Array& a, const Value& elem);
+  static Array pop(const Array& a);
+
+  bool is_array() const override;
+
+  std::type_index type_index() const override;
+
+  size_t length() const override;
+  Value at(size_t index) const override;
+
+protected:
+  size_t tailOffset() const;
+  const std::vector<Value>& leaf(size_t index) const;
+  std::shared_ptr<const Node> pushTail(size_t level, const Node& parent, std::shared_ptr<const Node> tailnode) const;
+  std::shared_ptr<const Node> popTail(size_t level, const Node& node) const;
+};
+
+/*!
+ * \class MappedArrayValue
+ * \brief a read-only array made of a property of each element of another array
+ */
+class LIQUID_API MappedArrayValue : public IValue
+{
+public:
+  Array source;
+  std::string field;
+
+public:
+  MappedArrayValue(Array src, std::string f);
+
+  bool is_array() const override;
+
+  std::type_index type_index() const override;
+
+  size_t length() const override;
+  Value at(size_t index) const override;
+};
+
 class LIQUID_API MapValue : public IValue
 {
 public:
@@ -0,0 +1,194 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/cache_p.h"
+
+namespace liquid
+{
+
+static thread_local RenderCache* current_cache = nullptr;
+
+/*!
+ * \class RenderCache
+ *
+ * Each Renderer owns a cache that is made current on the rendering thread 
+ * for the duration of \c{Renderer::render()} and cleared afterwards.
+ * Values computed from the data are assumed not to change during a render.
+ */
+
+RenderCache::RenderCache()
+{
+
+}
+
+RenderCache::~RenderCache()
+{
+
+}
+
+/*!
+ * \fn static RenderCache* current()
+ * \brief returns the cache of the render in progress on this thread
+ *
+ * Returns nullptr if no render is in progress.
+ */
+RenderCache* RenderCache::current()
+{
+  return current_cache;
+}
+
+static std::shared_ptr<RenderCache::Index> build_index(const liquid::Array& a, const std::string& field)
+{
+  auto result = std::make_shared<RenderCache::Index>();
+  result->groups.reserve(a.length());
+
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i);
+    liquid::Value key = elem.property(field);
+
+    auto it = result->groups.find(key);
+
+    if (it == result->groups.end())
+    {
+      result->keys.push_back(key);
+      it = result->groups.emplace(std::move(key), std::vector<liquid::Value>()).first;
+    }
+
+    it->second.push_back(std::move(elem));
+  }
+
+  return result;
+}
+
+/*!
+ * \fn static std::shared_ptr<Index> index(const liquid::Array& a, const std::string& field)
+ * \brief returns the elements of an array grouped by one of their property
+ *
+ * The index is built once per render for a given array and property;
+ * outside of a render, it is built at each call.
+ */
+std::shared_ptr<RenderCache::Index> RenderCache::index(const liquid::Array& a, const std::string& field)
+{
+  RenderCache* self = current();
+
+  if (!self)
+    return build_index(a, field);
+
+  auto& entry = self->m_indexes[IndexKey(a.impl().get(), field)];
+
+  if (!entry.second)
+  {
+    entry.first = a.impl();
+    entry.second = build_index(a, field);
+  }
+
+  return entry.second;
+}
+
+/*!
+ * \fn static std::shared_ptr<const utf8::Index> utf8Index(const liquid::Value& str)
+ * \brief returns the character index of a string
+ *
+ * The index is built once per render for a given string value;
+ * outside of a render, it is built at each call.
+ */
+std::shared_ptr<const utf8::Index> RenderCache::utf8Index(const liquid::Value& str)
+{
+  RenderCache* self = current();
+  const std::string& s = str.as<std::string>();
+
+  if (!self)
+    return std::make_shared<utf8::Index>(s.data(), s.size());
+
+  auto& entry = self->m_utf8_indexes[str.impl().get()];
+
+  if (!entry.second)
+  {
+    entry.first = str.impl();
+    entry.second = std::make_shared<utf8::Index>(s.data(), s.size());
+  }
+
+  return entry.second;
+}
+
+/*!
+ * \fn liquid::Value call(const std::shared_ptr<const FilterRegistry::Filter>& filter, const liquid::Value& input, FilterArguments args)
+ * \brief calls a pure filter, reusing its result if it was already called with the same values
+ *
+ * Results are memoized for the duration of the render and, if a FilterCache 
+ * was set, across renders.
+ */
+liquid::Value RenderCache::call(const std::shared_ptr<const FilterRegistry::Filter>& filter, const liquid::Value& input, FilterArguments args)
+{
+  if (!FilterCall::isMemoizable(input, args))
+    return (*filter)(input, args);
+
+  FilterCall key{ filter, input, args };
+  auto it = m_results.find(key);
+
+  if (it != m_results.end())
+    return it->second;
+
+  liquid::Value result;
+
+  if (!m_filter_cache || !m_filter_cache->find(key, result))
+  {
+    result = (*filter)(input, args);
+
+    if (m_filter_cache)
+      m_filter_cache->insert(key, result);
+  }
+
+  m_results.emplace(std::move(key), result);
+  return result;
+}
+
+/*!
+ * \fn const std::shared_ptr<FilterCache>& filterCache() const
+ * \brief returns the cache shared across renders, if any
+ */
+const std::shared_ptr<FilterCache>& RenderCache::filterCache() const
+{
+  return m_filter_cache;
+}
+
+/*!
+ * \fn void setFilterCache(std::shared_ptr<FilterCache> cache)
+ * \brief sets the cache shared across renders
+ */
+void RenderCache::setFilterCache(std::shared_ptr<FilterCache> cache)
+{
+  m_filter_cache = std::move(cache);
+}
+
+/*!
+ * \fn void clear()
+ * \brief removes everything from the cache
+ *
+ * The cache shared across renders is left untouched.
+ */
+void RenderCache::clear()
+{
+  m_indexes.clear();
+  m_utf8_indexes.clear();
+  m_results.clear();
+}
+
+RenderCache::Scope::Scope(RenderCache& cache)
+  : m_previous(current_cache)
+{
+  current_cache = &cache;
+}
+
+RenderCache::Scope::~Scope()
+{
+  current_cache = m_previous;
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
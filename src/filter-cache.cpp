@@ -0,0 +1,223 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/filter-cache.h"
+
+#include <functional>
+
+namespace liquid
+{
+
+/*!
+ * \class FilterCall
+ */
+
+FilterCall::FilterCall(std::shared_ptr<const FilterRegistry::Filter> f, const liquid::Value& in, FilterArguments args)
+  : filter(std::move(f)),
+    input(in),
+    arguments(args.begin(), args.end())
+{
+  hash = std::hash<const void*>()(filter.get()) ^ (liquid::hash(input) + 0x9e3779b9);
+
+  for (const liquid::Value& a : arguments)
+    hash = hash * 31 + liquid::hash(a);
+}
+
+static bool is_scalar(const liquid::Value& val)
+{
+  return val.isNull() || val.is<bool>() || val.is<int>() || val.is<double>() || val.is<std::string>();
+}
+
+/*!
+ * \fn static bool isMemoizable(const liquid::Value& in, FilterArguments args)
+ * \brief returns whether a call can be looked up in a cache
+ *
+ * Only calls whose input and arguments are null, booleans, numbers or strings 
+ * are memoized: hashing arrays and maps could cost more than calling the filter.
+ */
+bool FilterCall::isMemoizable(const liquid::Value& in, FilterArguments args)
+{
+  if (!is_scalar(in))
+    return false;
+
+  for (const liquid::Value& a : args)
+  {
+    if (!is_scalar(a))
+      return false;
+  }
+
+  return true;
+}
+
+// 1 and 1.0 compare equal but may not give the same result
+static bool same_value(const liquid::Value& a, const liquid::Value& b)
+{
+  if (a.impl()->type_index() != b.impl()->type_index())
+    return false;
+
+  // every byte of a string matters, including null characters
+  if (a.is<std::string>())
+    return a.as<std::string>() == b.as<std::string>();
+
+  return liquid::compare(a, b) == 0;
+}
+
+bool FilterCall::operator==(const FilterCall& other) const
+{
+  if (hash != other.hash || filter != other.filter || arguments.size() != other.arguments.size())
+    return false;
+
+  if (!same_value(input, other.input))
+    return false;
+
+  for (size_t i(0); i < arguments.size(); ++i)
+  {
+    if (!same_value(arguments[i], other.arguments[i]))
+      return false;
+  }
+
+  return true;
+}
+
+/*!
+ * \endclass
+ */
+
+/*!
+ * \class FilterCache
+ *
+ * A FilterCache can be shared by several renderers (see \c{Renderer::setFilterCache()}), 
+ * possibly used by different threads. When it is full, the least recently used 
+ * result is evicted.
+ */
+
+/*!
+ * \fn FilterCache(size_t capacity)
+ * \brief constructs a cache holding at most \a capacity results
+ */
+FilterCache::FilterCache(size_t capacity)
+  : m_capacity(capacity),
+    m_hits(0),
+    m_misses(0)
+{
+
+}
+
+FilterCache::~FilterCache()
+{
+
+}
+
+/*!
+ * \fn size_t capacity() const
+ * \brief returns the maximum number of results held by the cache
+ */
+size_t FilterCache::capacity() const
+{
+  return m_capacity;
+}
+
+/*!
+ * \fn size_t size() const
+ * \brief returns the number of results held by the cache
+ */
+size_t FilterCache::size() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_index.size();
+}
+
+/*!
+ * \fn bool find(const FilterCall& call, liquid::Value& result)
+ * \brief looks up the result of a call
+ */
+bool FilterCache::find(const FilterCall& call, liquid::Value& result)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_index.find(call);
+
+  if (it == m_index.end())
+  {
+    ++m_misses;
+    return false;
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+  result = it->second->second;
+  ++m_hits;
+  return true;
+}
+
+/*!
+ * \fn void insert(const FilterCall& call, const liquid::Value& result)
+ * \brief stores the result of a call
+ */
+void FilterCache::insert(const FilterCall& call, const liquid::Value& result)
+{
+  if (m_capacity == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  if (m_index.find(call) != m_index.end())
+    return;
+
+  if (m_index.size() == m_capacity)
+  {
+    m_index.erase(m_entries.back().first);
+    m_entries.pop_back();
+  }
+
+  m_entries.emplace_front(call, result);
+  m_index[call] = m_entries.begin();
+}
+
+/*!
+ * \fn void clear()
+ * \brief removes all the results and resets the counters
+ */
+void FilterCache::clear()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_index.clear();
+  m_entries.clear();
+  m_hits = 0;
+  m_misses = 0;
+}
+
+/*!
+ * \fn size_t hits() const
+ * \brief returns the number of calls that were found in the cache
+ */
+size_t FilterCache::hits() const
+{
+  return m_hits.load();
+}
+
+/*!
+ * \fn size_t misses() const
+ * \brief returns the number of calls that were not found in the cache
+ */
+size_t FilterCache::misses() const
+{
+  return m_misses.load();
+}
+
+/*!
+ * \fn double hitRate() const
+ * \brief returns the proportion of calls that were found in the cache
+ */
+double FilterCache::hitRate() const
+{
+  const size_t h = hits();
+  const size_t total = h + misses();
+  return total == 0 ? 0. : static_cast<double>(h) / total;
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
@@ -4,7 +4,19 @@
 
 #include "liquid/filters.h"
 
+#include "liquid/cache_p.h"
 #include "liquid/errors.h"
+#include "liquid/json.h"
+#include "liquid/renderer.h"
+#include "liquid/simd_p.h"
+#include "liquid/thread-pool_p.h"
+#include "liquid/utf8_p.h"
+#include "liquid/value_p.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
 
 namespace liquid
 {
@@ -63,72 +75,1051 @@ std::string ArrayFilters::join(const liquid::Array& vec, const liquid::Value& se
   return join(strings, sep.is<std::string>() ? sep.as<std::string>() : std::string(""));
 }
 
+// copies the first elements of an array into a vector
+static std::vector<liquid::Value> array_values(const liquid::Array& a, size_t count)
+{
+  std::vector<liquid::Value> result;
+  result.reserve(count);
+
+  if (a.isWritable())
+  {
+    const auto& values = static_cast<const VectorValue*>(a.impl().get())->values;
+    result.insert(result.end(), values.begin(), values.begin() + count);
+  }
+  else
+  {
+    for (size_t i(0); i < count; ++i)
+      result.push_back(a.at(i));
+  }
+
+  return result;
+}
+
 liquid::Array ArrayFilters::concat(const liquid::Array& a, const liquid::Array& b)
 {
-  liquid::Array result;
+  // small arrays are appended, so that concatenating in a loop does not 
+  // create ever longer lists of sources
+  if (b.length() > PersistentVectorValue::Width)
+    return ConcatArrayValue::concat(a, b);
 
-  for (int i(0); i < a.length(); ++i)
-    result.push(a.at(i));
+  liquid::Array result = a;
 
-  for (int i(0); i < b.length(); ++i)
-    result.push(b.at(i));
+  for (size_t i(0); i < b.length(); ++i)
+    result = PersistentVectorValue::push(result, b.at(i));
 
-  return result;
+  return b.length() > 0 ? result : ConcatArrayValue::concat(a, b);
 }
 
 liquid::Value ArrayFilters::first(const liquid::Array& a)
 {
-  return a.at(0);
+  return a.length() > 0 ? a.at(0) : liquid::Value();
 }
 
 liquid::Value ArrayFilters::last(const liquid::Array& a)
 {
-  return a.at(a.length() - 1);
+  return a.length() > 0 ? a.at(a.length() - 1) : liquid::Value();
 }
 
 liquid::Array ArrayFilters::map(const liquid::Array& a, const std::string& field)
 {
-  liquid::Array result;
+  return liquid::Array(std::make_shared<MappedArrayValue>(a, field));
+}
 
-  for (int i(0); i < a.length(); ++i)
-    result.push(a.at(i).property(field));
+liquid::Array ArrayFilters::push(const liquid::Array& a, const liquid::Value& elem)
+{
+  return PersistentVectorValue::push(a, elem);
+}
 
-  return result;
+liquid::Array ArrayFilters::pop(const liquid::Array& a)
+{
+  return PersistentVectorValue::pop(a);
 }
 
-liquid::Array ArrayFilters::push(const liquid::Array& a, const liquid::Value& elem)
+/*!
+ * \fn static liquid::Array where(const liquid::Array& a, const std::string& field)
+ * \brief returns the elements of an array whose property \a field is truthy
+ */
+liquid::Array ArrayFilters::where(const liquid::Array& a, const std::string& field)
 {
-  liquid::Array result;
+  std::vector<liquid::Value> result;
+  result.reserve(a.length());
 
-  for (int i(0); i < a.length(); ++i)
-    result.push(a.at(i));
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i);
 
-  result.push(elem);
+    if (Renderer::evalCondition(elem.property(field)))
+      result.push_back(elem);
+  }
 
-  return result;
+  return liquid::Array(std::move(result));
 }
 
-liquid::Array ArrayFilters::pop(const liquid::Array& a)
+/*!
+ * \fn static liquid::Array where(const liquid::Array& a, const std::string& field, const liquid::Value& value)
+ * \brief returns the elements of an array whose property \a field is equal to \a value
+ */
+liquid::Array ArrayFilters::where(const liquid::Array& a, const std::string& field, const liquid::Value& value)
+{
+  std::vector<liquid::Value> result;
+  result.reserve(a.length());
+
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i);
+
+    if (liquid::compare(elem.property(field), value) == 0)
+      result.push_back(elem);
+  }
+
+  return liquid::Array(std::move(result));
+}
+
+/*!
+ * \fn static liquid::Array uniq(const liquid::Array& a)
+ * \brief removes the duplicated elements of an array
+ *
+ * Elements are compared structurally and only the first occurrence is kept.
+ */
+liquid::Array ArrayFilters::uniq(const liquid::Array& a)
+{
+  std::unordered_set<liquid::Value, ValueHash, ValueEqual> seen;
+  seen.reserve(a.length());
+
+  std::vector<liquid::Value> result;
+  result.reserve(a.length());
+
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i);
+
+    if (seen.insert(elem).second)
+      result.push_back(elem);
+  }
+
+  return liquid::Array(std::move(result));
+}
+
+/*!
+ * \fn static liquid::Array compact(const liquid::Array& a)
+ * \brief removes the null elements of an array
+ */
+liquid::Array ArrayFilters::compact(const liquid::Array& a)
+{
+  std::vector<liquid::Value> result;
+  result.reserve(a.length());
+
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i);
+
+    if (!elem.isNull())
+      result.push_back(elem);
+  }
+
+  return liquid::Array(std::move(result));
+}
+
+/*!
+ * \fn static liquid::Array reverse(const liquid::Array& a)
+ * \brief reverses an array
+ *
+ * The result is a read-only view over \a a, no element is copied.
+ */
+liquid::Array ArrayFilters::reverse(const liquid::Array& a)
+{
+  return ArrayViewValue::reverse(a);
+}
+
+/*!
+ * \fn static liquid::Array slice(const liquid::Array& a, int start, int length)
+ * \brief returns a range of an array
+ *
+ * A negative \a start is counted from the end of the array.
+ * The result is a read-only view over \a a, no element is copied.
+ */
+liquid::Array ArrayFilters::slice(const liquid::Array& a, int start, int length)
+{
+  const int n = static_cast<int>(a.length());
+
+  if (start < 0)
+    start += n;
+
+  if (start < 0 || start >= n || length <= 0)
+    return liquid::Array();
+
+  return ArrayViewValue::slice(a, start, std::min(length, n - start));
+}
+
+/*!
+ * \fn static liquid::Map index_by(const liquid::Array& a, const std::string& field)
+ * \brief builds an object mapping the values of a property to the first element that has it
+ *
+ * Values are converted to strings to be used as keys; elements without the property are ignored.
+ * The index is built once per render for a given array and property.
+ */
+liquid::Map ArrayFilters::index_by(const liquid::Array& a, const std::string& field)
+{
+  std::shared_ptr<RenderCache::Index> index = RenderCache::index(a, field);
+
+  if (index->byKey.isNull())
+  {
+    std::map<std::string, liquid::Value> result;
+
+    for (const liquid::Value& key : index->keys)
+    {
+      if (!key.isNull())
+        result.emplace(Renderer::defaultStringify(key), index->groups.at(key).front());
+    }
+
+    index->byKey = liquid::Value(std::move(result));
+  }
+
+  return index->byKey.toMap();
+}
+
+/*!
+ * \fn static liquid::Map group_by(const liquid::Array& a, const std::string& field)
+ * \brief builds an object mapping the values of a property to the array of the elements that have it
+ *
+ * See \c{index_by()}.
+ */
+liquid::Map ArrayFilters::group_by(const liquid::Array& a, const std::string& field)
+{
+  std::shared_ptr<RenderCache::Index> index = RenderCache::index(a, field);
+
+  if (index->byGroup.isNull())
+  {
+    std::map<std::string, liquid::Value> result;
+
+    for (const liquid::Value& key : index->keys)
+    {
+      if (!key.isNull())
+        result.emplace(Renderer::defaultStringify(key), liquid::Value(index->groups.at(key)));
+    }
+
+    index->byGroup = liquid::Value(std::move(result));
+  }
+
+  return index->byGroup.toMap();
+}
+
+/*!
+ * \fn static liquid::Value find(const liquid::Array& a, const std::string& field, const liquid::Value& value)
+ * \brief returns the first element whose property \a field is equal to \a value
+ *
+ * Returns nil if there is no such element. The lookup uses the same index as \c{index_by()}.
+ */
+liquid::Value ArrayFilters::find(const liquid::Array& a, const std::string& field, const liquid::Value& value)
 {
-  liquid::Array result;
+  std::shared_ptr<RenderCache::Index> index = RenderCache::index(a, field);
+  auto it = index->groups.find(value);
+  return it != index->groups.end() ? it->second.front() : liquid::Value();
+}
+
+namespace
+{
+
+// sums and bounds of the numbers of an array, ints and doubles being kept apart
+struct NumberSummary
+{
+  size_t ints = 0;
+  size_t doubles = 0;
+  int64_t int_sum = 0;
+  double double_sum = 0;
+  int int_min = 0;
+  int int_max = 0;
+  double double_min = 0;
+  double double_max = 0;
+
+  void add(int x)
+  {
+    int_min = (ints == 0 || x < int_min) ? x : int_min;
+    int_max = (ints == 0 || x > int_max) ? x : int_max;
+    int_sum += x;
+    ++ints;
+  }
+
+  void add(double x)
+  {
+    double_min = (doubles == 0 || x < double_min) ? x : double_min;
+    double_max = (doubles == 0 || x > double_max) ? x : double_max;
+    double_sum += x;
+    ++doubles;
+  }
+
+  // nulls are ignored
+  void add(const liquid::Value& val, const char* filter)
+  {
+    if (val.is<int>())
+      add(val.as<int>());
+    else if (val.is<double>())
+      add(val.as<double>());
+    else if (!val.isNull())
+      throw EvaluationException{ std::string("Filter '") + filter + "' expects an array of numbers" };
+  }
+
+  // like operator +, the sum is an int if all the numbers are ints
+  liquid::Value sum() const
+  {
+    if (doubles == 0)
+      return static_cast<int>(static_cast<uint32_t>(int_sum));
+    else
+      return static_cast<double>(int_sum) + double_sum;
+  }
 
-  for (int i(0); i < a.length() - 1; ++i)
-    result.push(a.at(i));
+  liquid::Value min() const
+  {
+    if (doubles == 0)
+      return ints == 0 ? liquid::Value() : liquid::Value(int_min);
+    else if (ints == 0 || double_min < int_min)
+      return double_min;
+    else
+      return int_min;
+  }
+
+  liquid::Value max() const
+  {
+    if (doubles == 0)
+      return ints == 0 ? liquid::Value() : liquid::Value(int_max);
+    else if (ints == 0 || double_max > int_max)
+      return double_max;
+    else
+      return int_max;
+  }
+
+  liquid::Value average() const
+  {
+    if (ints + doubles == 0)
+      return liquid::Value();
+
+    return (static_cast<double>(int_sum) + double_sum) / static_cast<double>(ints + doubles);
+  }
+};
+
+} // namespace
+
+/*
+ * Arrays created with Array::fromInts() or Array::fromDoubles() are reduced with 
+ * the vectorized kernels, other arrays are read without copying their elements when possible.
+ */
+static NumberSummary summarize(const liquid::Array& a, const char* filter, bool bounds)
+{
+  NumberSummary result;
+  const std::type_index type = a.impl()->type_index();
+
+  if (type == std::type_index(typeid(std::vector<int>)))
+  {
+    const auto& values = *static_cast<const std::vector<int>*>(a.impl()->data());
+    const simd::Kernels& k = simd::kernels();
+    result.ints = values.size();
+    result.int_sum = k.sum_int(values.data(), values.size());
+
+    if (bounds && !values.empty())
+      k.minmax_int(values.data(), values.size(), &result.int_min, &result.int_max);
+  }
+  else if (type == std::type_index(typeid(std::vector<double>)))
+  {
+    const auto& values = *static_cast<const std::vector<double>*>(a.impl()->data());
+    const simd::Kernels& k = simd::kernels();
+    result.doubles = values.size();
+    result.double_sum = k.sum_double(values.data(), values.size());
+
+    if (bounds && !values.empty())
+      k.minmax_double(values.data(), values.size(), &result.double_min, &result.double_max);
+  }
+  else if (a.isWritable())
+  {
+    for (const liquid::Value& val : static_cast<const VectorValue*>(a.impl().get())->values)
+      result.add(val, filter);
+  }
+  else
+  {
+    for (size_t i(0); i < a.length(); ++i)
+      result.add(a.at(i), filter);
+  }
 
   return result;
 }
 
-liquid::Value BuiltinFilters::apply(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args)
+/*!
+ * \fn static liquid::Value sum(const liquid::Array& a)
+ * \brief returns the sum of the numbers of an array
+ *
+ * Like for operator +, the result is an int if all the elements are ints 
+ * and a double otherwise. Null elements are ignored, other values are an error.
+ */
+liquid::Value ArrayFilters::sum(const liquid::Array& a)
+{
+  return summarize(a, "sum", false).sum();
+}
+
+/*!
+ * \fn static liquid::Value sum(const liquid::Array& a, const std::string& field)
+ * \brief returns the sum of a property of the elements of an array
+ */
+liquid::Value ArrayFilters::sum(const liquid::Array& a, const std::string& field)
+{
+  NumberSummary result;
+
+  for (size_t i(0); i < a.length(); ++i)
+    result.add(a.at(i).property(field), "sum");
+
+  return result.sum();
+}
+
+/*!
+ * \fn static liquid::Value min(const liquid::Array& a)
+ * \brief returns the smallest number of an array, or nil if there is none
+ */
+liquid::Value ArrayFilters::min(const liquid::Array& a)
+{
+  return summarize(a, "min", true).min();
+}
+
+/*!
+ * \fn static liquid::Value max(const liquid::Array& a)
+ * \brief returns the largest number of an array, or nil if there is none
+ */
+liquid::Value ArrayFilters::max(const liquid::Array& a)
+{
+  return summarize(a, "max", true).max();
+}
+
+/*!
+ * \fn static liquid::Value average(const liquid::Array& a)
+ * \brief returns the average of the numbers of an array as a double, or nil if there is none
+ */
+liquid::Value ArrayFilters::average(const liquid::Array& a)
+{
+  return summarize(a, "average", false).average();
+}
+
+static std::atomic<size_t> parallel_map_threshold{ 256 };
+
+/*!
+ * \fn static size_t parallelMapThreshold()
+ * \brief returns the size above which pure filters are mapped by several threads
+ */
+size_t ArrayFilters::parallelMapThreshold()
+{
+  return parallel_map_threshold.load();
+}
+
+/*!
+ * \fn static void setParallelMapThreshold(size_t n)
+ * \brief sets the size above which pure filters are mapped by several threads
+ */
+void ArrayFilters::setParallelMapThreshold(size_t n)
 {
-  if (object.isArray())
+  parallel_map_threshold = n;
+}
+
+/*!
+ * \fn static liquid::Array map_filter(const liquid::Array& a, const FilterRegistry::Filter& filter, FilterArguments args)
+ * \brief applies a filter to each element of an array
+ *
+ * If the filter is pure and the array has at least \c{parallelMapThreshold()} elements, 
+ * the elements are processed concurrently by the threads of a pool. 
+ * The order of the elements is preserved and, if the filter throws, the exception 
+ * is the one raised for the first element that failed.
+ */
+liquid::Array ArrayFilters::map_filter(const liquid::Array& a, const FilterRegistry::Filter& filter, FilterArguments args)
+{
+  // the elements are read by this thread, only the filter must be thread-safe
+  const std::vector<liquid::Value> elems = array_values(a, a.length());
+  std::vector<liquid::Value> result(elems.size());
+
+  auto apply = [&elems, &result, &filter, args](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      result[i] = filter(elems[i], args);
+  };
+
+  if (!filter.pure || elems.size() < std::max<size_t>(parallelMapThreshold(), 2))
   {
-    return ArrayFilters::applyAny(name, object.toArray(), args);
+    apply(0, elems.size());
   }
   else
   {
+    // more chunks than threads, to balance filters whose cost varies
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(elems.size(), std::max<size_t>(2, 4 * (pool.size() + 1)), apply);
+  }
+
+  return liquid::Array(std::move(result));
+}
+
+static std::atomic<size_t> parallel_sort_threshold{ 1 << 16 };
+
+/*!
+ * \fn static size_t parallelSortThreshold()
+ * \brief returns the size above which arrays are sorted by several threads
+ */
+size_t ArrayFilters::parallelSortThreshold()
+{
+  return parallel_sort_threshold.load();
+}
+
+/*!
+ * \fn static void setParallelSortThreshold(size_t n)
+ * \brief sets the size above which arrays are sorted by several threads
+ */
+void ArrayFilters::setParallelSortThreshold(size_t n)
+{
+  parallel_sort_threshold = n;
+}
+
+// sorts chunks of the range concurrently, then merges them
+template<typename It, typename Compare>
+static void parallel_stable_sort(It begin, It end, Compare comp)
+{
+  const size_t n = static_cast<size_t>(end - begin);
+  const size_t threshold = std::max<size_t>(ArrayFilters::parallelSortThreshold(), 2);
+  const size_t nchunks = std::min<size_t>(std::max(2u, std::thread::hardware_concurrency()), n / threshold);
+
+  if (nchunks < 2)
+  {
+    std::stable_sort(begin, end, comp);
+    return;
+  }
+
+  std::vector<It> bounds;
+
+  for (size_t i(0); i < nchunks; ++i)
+    bounds.push_back(begin + n * i / nchunks);
+
+  bounds.push_back(end);
+
+  ThreadPool::global().parallelFor(nchunks, nchunks, [&bounds, &comp](size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i)
+      std::stable_sort(bounds[i], bounds[i + 1], comp);
+  });
+
+  for (size_t step(1); step < nchunks; step *= 2)
+  {
+    for (size_t i(0); i + step < nchunks; i += 2 * step)
+      std::inplace_merge(bounds[i], bounds[i + step], bounds[std::min(i + 2 * step, nchunks)], comp);
+  }
+}
+
+template<typename Key>
+static void sort_indices(std::vector<std::pair<Key, size_t>>& keys, std::vector<size_t>& indices)
+{
+  parallel_stable_sort(keys.begin(), keys.end(), [](const std::pair<Key, size_t>& a, const std::pair<Key, size_t>& b) {
+    return a.first < b.first;
+  });
+
+  for (const auto& k : keys)
+    indices.push_back(k.second);
+}
+
+/*
+ * Sorts the elements according to the keys, which are extracted once by the caller.
+ * Numbers and strings are sorted as doubles and std::strings (possibly by several threads), 
+ * other values with liquid::compare(). Elements whose key is null are put at the end.
+ */
+static liquid::Array sort_by_keys(const std::vector<liquid::Value>& elems, const std::vector<liquid::Value>& keys, bool natural)
+{
+  bool numbers = true;
+  bool strings = true;
+
+  for (const liquid::Value& k : keys)
+  {
+    if (k.isNull())
+      continue;
+
+    numbers = numbers && (k.is<int>() || k.is<double>());
+    strings = strings && k.is<std::string>();
+  }
+
+  std::vector<size_t> indices;
+  indices.reserve(elems.size());
+
+  if (numbers)
+  {
+    std::vector<std::pair<double, size_t>> decorated;
+    decorated.reserve(keys.size());
+
+    for (size_t i(0); i < keys.size(); ++i)
+    {
+      if (keys[i].is<int>())
+        decorated.emplace_back(keys[i].as<int>(), i);
+      else if (keys[i].is<double>())
+        decorated.emplace_back(keys[i].as<double>(), i);
+    }
+
+    sort_indices(decorated, indices);
+  }
+  else if (strings)
+  {
+    std::vector<std::pair<std::string, size_t>> decorated;
+    decorated.reserve(keys.size());
+
+    for (size_t i(0); i < keys.size(); ++i)
+    {
+      if (!keys[i].isNull())
+        decorated.emplace_back(natural ? StringFilters::downcase(keys[i].as<std::string>()) : keys[i].as<std::string>(), i);
+    }
+
+    sort_indices(decorated, indices);
+  }
+  else
+  {
+    std::vector<std::pair<liquid::Value, size_t>> decorated;
+    decorated.reserve(keys.size());
+
+    for (size_t i(0); i < keys.size(); ++i)
+    {
+      if (keys[i].isNull())
+        continue;
+
+      if (natural && keys[i].is<std::string>())
+        decorated.emplace_back(StringFilters::downcase(keys[i].as<std::string>()), i);
+      else
+        decorated.emplace_back(keys[i], i);
+    }
+
+    std::stable_sort(decorated.begin(), decorated.end(), [](const std::pair<liquid::Value, size_t>& a, const std::pair<liquid::Value, size_t>& b) {
+      return liquid::compare(a.first, b.first) < 0;
+    });
+
+    for (const auto& k : decorated)
+      indices.push_back(k.second);
+  }
+
+  for (size_t i(0); i < keys.size(); ++i)
+  {
+    if (keys[i].isNull())
+      indices.push_back(i);
+  }
+
+  std::vector<liquid::Value> result;
+  result.reserve(elems.size());
+
+  for (size_t i : indices)
+    result.push_back(elems[i]);
+
+  return liquid::Array(std::move(result));
+}
+
+/*!
+ * \fn static liquid::Array sort(const liquid::Array& a)
+ * \brief sorts an array
+ *
+ * The sort is stable; null elements are put at the end.
+ * Arrays larger than \c{parallelSortThreshold()} elements are sorted by several threads.
+ */
+liquid::Array ArrayFilters::sort(const liquid::Array& a)
+{
+  std::vector<liquid::Value> elems = array_values(a, a.length());
+  return sort_by_keys(elems, elems, false);
+}
+
+/*!
+ * \fn static liquid::Array sort(const liquid::Array& a, const std::string& field)
+ * \brief sorts an array of objects according to one of their property
+ *
+ * The property of each element is read only once.
+ */
+liquid::Array ArrayFilters::sort(const liquid::Array& a, const std::string& field)
+{
+  std::vector<liquid::Value> elems = array_values(a, a.length());
+  std::vector<liquid::Value> keys;
+  keys.reserve(elems.size());
+
+  for (const liquid::Value& e : elems)
+    keys.push_back(e.property(field));
+
+  return sort_by_keys(elems, keys, false);
+}
+
+/*!
+ * \fn static liquid::Array sort_natural(const liquid::Array& a)
+ * \brief sorts an array, comparing strings case-insensitively
+ */
+liquid::Array ArrayFilters::sort_natural(const liquid::Array& a)
+{
+  std::vector<liquid::Value> elems = array_values(a, a.length());
+  return sort_by_keys(elems, elems, true);
+}
+
+/*!
+ * \fn static liquid::Array sort_natural(const liquid::Array& a, const std::string& field)
+ * \brief sorts an array of objects according to one of their property, comparing strings case-insensitively
+ */
+liquid::Array ArrayFilters::sort_natural(const liquid::Array& a, const std::string& field)
+{
+  std::vector<liquid::Value> elems = array_values(a, a.length());
+  std::vector<liquid::Value> keys;
+  keys.reserve(elems.size());
+
+  for (const liquid::Value& e : elems)
+    keys.push_back(e.property(field));
+
+  return sort_by_keys(elems, keys, true);
+}
+
+/*!
+ * \fn static liquid::Value apply(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args)
+ * \brief applies a built-in filter
+ *
+ * The filter is looked up in \c{FilterRegistry::builtins()}.
+ */
+liquid::Value BuiltinFilters::apply(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args)
+{
+  std::shared_ptr<const FilterRegistry::Filter> filter = FilterRegistry::builtins().find(name);
+
+  if (!filter)
     throw EvaluationException{ "Invalid filter name '" + name + "'" };
+
+  return (*filter)(object, args);
+}
+
+/*!
+ * \class FilterRegistry
+ *
+ * Filters are registered once with \c{add()} and are looked up by name when a template 
+ * is parsed: each filter expression (\c{objects::Pipe}) then keeps a pointer to the 
+ * filter so that no lookup is performed while rendering.
+ * 
+ * Each filter declares the type of the value it can be applied to, the types of its 
+ * arguments and how many of them are required. Unknown filters and filters used 
+ * with a wrong number of arguments are reported when the template is parsed.
+ *
+ * A filter with \c{rawOutput} set produces markup: when it is the last filter of an 
+ * output statement, its result is not escaped by the renderer (see \c{Renderer::setEscaping()}).
+ *
+ * A filter with \c{pure} set (see \c{setPure()}) declares that it is thread-safe and 
+ * without side effects.
+ */
+
+/*!
+ * \fn liquid::Value operator()(const liquid::Value& object, FilterArguments args) const
+ * \brief calls the filter
+ *
+ * This function checks the type of the object and of the arguments and throws 
+ * an EvaluationException if they do not match what the filter expects.
+ */
+liquid::Value FilterRegistry::Filter::operator()(const liquid::Value& object, FilterArguments args) const
+{
+  if (!FilterRegistry::matches(inputType, object))
+    throw EvaluationException{ "Filter '" + name + "' expects " + FilterRegistry::typeName(inputType) + " as input" };
+
+  if (!acceptsArgumentCount(args.size()))
+    throw EvaluationException{ "Invalid argument count for filter '" + name + "'" };
+
+  for (size_t i(0); i < args.size(); ++i)
+  {
+    if (!FilterRegistry::matches(argumentTypes[i], args[i]))
+      throw EvaluationException{ "Filter '" + name + "' expects " + FilterRegistry::typeName(argumentTypes[i]) + " as argument " + std::to_string(i + 1) };
   }
+
+  return function(object, args);
 }
 
-} // namespace liquid
+FilterRegistry::FilterRegistry()
+{
+
+}
+
+FilterRegistry::~FilterRegistry()
+{
+
+}
+
+static FilterRegistry::Filter filter_with_optional_arguments(const std::string& name, FilterRegistry::Function func, FilterRegistry::Type input,
+  std::vector<FilterRegistry::Type> args, size_t required)
+{
+  FilterRegistry::Filter filter;
+  filter.name = name;
+  filter.function = std::move(func);
+  filter.inputType = input;
+  filter.argumentTypes = std::move(args);
+  filter.requiredArguments = required;
+  return filter;
+}
+
+static FilterRegistry create_builtin_filters()
+{
+  FilterRegistry result;
+
+  result.add("join", static_cast<std::string(*)(const liquid::Array&, const liquid::Value&)>(&ArrayFilters::join));
+  result.add("concat", &ArrayFilters::concat);
+  result.add("first", &ArrayFilters::first);
+  result.add("last", &ArrayFilters::last);
+  result.add("map", &ArrayFilters::map);
+  result.add("push", &ArrayFilters::push);
+  result.add("pop", &ArrayFilters::pop);
+  result.add("uniq", &ArrayFilters::uniq);
+  result.add("compact", &ArrayFilters::compact);
+  result.add("reverse", &ArrayFilters::reverse);
+  result.add("index_by", &ArrayFilters::index_by);
+  result.add("group_by", &ArrayFilters::group_by);
+  result.add("find", &ArrayFilters::find);
+  result.add("min", &ArrayFilters::min);
+  result.add("max", &ArrayFilters::max);
+  result.add("average", &ArrayFilters::average);
+
+  result.add(filter_with_optional_arguments("sum", [](const liquid::Value& a, FilterArguments args) -> liquid::Value {
+    return args.empty() ? ArrayFilters::sum(a.toArray()) : ArrayFilters::sum(a.toArray(), args[0].as<std::string>());
+  }, FilterRegistry::Array, { FilterRegistry::String }, 0));
+
+  result.add(filter_with_optional_arguments("sort", [](const liquid::Value& a, FilterArguments args) -> liquid::Value {
+    return args.empty() ? ArrayFilters::sort(a.toArray()) : ArrayFilters::sort(a.toArray(), args[0].as<std::string>());
+  }, FilterRegistry::Array, { FilterRegistry::String }, 0));
+
+  result.add(filter_with_optional_arguments("sort_natural", [](const liquid::Value& a, FilterArguments args) -> liquid::Value {
+    return args.empty() ? ArrayFilters::sort_natural(a.toArray()) : ArrayFilters::sort_natural(a.toArray(), args[0].as<std::string>());
+  }, FilterRegistry::Array, { FilterRegistry::String }, 0));
+
+  result.add(filter_with_optional_arguments("where", [](const liquid::Value& a, FilterArguments args) -> liquid::Value {
+    if (args.size() == 1)
+      return ArrayFilters::where(a.toArray(), args[0].as<std::string>());
+    else
+      return ArrayFilters::where(a.toArray(), args[0].as<std::string>(), args[1]);
+  }, FilterRegistry::Array, { FilterRegistry::String, FilterRegistry::Any }, 1));
+
+  result.add("upcase", &StringFilters::upcase);
+  result.add("downcase", &StringFilters::downcase);
+  result.add("capitalize", &StringFilters::capitalize);
+  result.add("strip", &StringFilters::strip);
+  result.add("lstrip", &StringFilters::lstrip);
+  result.add("rstrip", &StringFilters::rstrip);
+  result.add("replace", &StringFilters::replace);
+  result.add("remove", &StringFilters::remove);
+  result.add("split", &StringFilters::split);
+  result.add("prepend", &StringFilters::prepend);
+  result.add("append", &StringFilters::append);
+  result.add("size", &StringFilters::size);
+  result.add("newline_to_br", &StringFilters::newline_to_br);
+  result.add("escape", &StringFilters::escape);
+  result.add("escape_once", &StringFilters::escape_once);
+  result.add("url_encode", &StringFilters::url_encode);
+  result.add("url_decode", &StringFilters::url_decode);
+  result.add("base64_encode", &StringFilters::base64_encode);
+  result.add("base64_decode", &StringFilters::base64_decode);
+
+  for (const char* name : { "raw", "safe" })
+  {
+    FilterRegistry::Filter raw = filter_with_optional_arguments(name, [](const liquid::Value& val, FilterArguments) -> liquid::Value {
+      return val;
+    }, FilterRegistry::Any, {}, 0);
+    raw.rawOutput = true;
+    result.add(std::move(raw));
+  }
+
+  result.add(filter_with_optional_arguments("truncate", [](const liquid::Value& str, FilterArguments args) -> liquid::Value {
+    return utf8::Text(str).truncate(args.size() > 0 ? args[0].as<int>() : 50, args.size() > 1 ? args[1].as<std::string>() : "...");
+  }, FilterRegistry::String, { FilterRegistry::Int, FilterRegistry::String }, 0));
+
+  result.add(filter_with_optional_arguments("truncatewords", [](const liquid::Value& str, FilterArguments args) -> liquid::Value {
+    return StringFilters::truncatewords(str.as<std::string>(), args.size() > 0 ? args[0].as<int>() : 15, args.size() > 1 ? args[1].as<std::string>() : "...");
+  }, FilterRegistry::String, { FilterRegistry::Int, FilterRegistry::String }, 0));
+
+  result.add("json", &json::stringify);
+
+  result.add(filter_with_optional_arguments("map_filter", [](const liquid::Value&, FilterArguments) -> liquid::Value {
+    throw EvaluationException{ "Filter 'map_filter' expects the name of a filter as first argument" };
+  }, FilterRegistry::Array, { FilterRegistry::String, FilterRegistry::Any, FilterRegistry::Any, FilterRegistry::Any }, 1));
+
+  result.add(filter_with_optional_arguments("slice", [](const liquid::Value& val, FilterArguments args) -> liquid::Value {
+    const int length = args.size() > 1 ? args[1].as<int>() : 1;
+
+    if (val.isArray())
+      return ArrayFilters::slice(val.toArray(), args[0].as<int>(), length);
+    else if (val.is<std::string>())
+      return utf8::Text(val).slice(args[0].as<int>(), length);
+    else
+      throw EvaluationException{ "Filter 'slice' expects a string or an array as input" };
+  }, FilterRegistry::Any, { FilterRegistry::Int, FilterRegistry::Int }, 1));
+
+  for (const char* name : { "upcase", "downcase", "capitalize", "strip", "lstrip", "rstrip", "replace", "remove", "split", 
+    "truncate", "truncatewords", "prepend", "append", "size", "newline_to_br", "escape", 
+    "escape_once", "url_encode", "url_decode", "base64_encode", "base64_decode", "json" })
+  {
+    result.setPure(name);
+  }
+
+  return result;
+}
+
+/*!
+ * \fn static const FilterRegistry& builtins()
+ * \brief returns the registry of the built-in filters
+ *
+ * This registry is used by default by the parser. 
+ * A copy of it can be used as a starting point for a registry with custom filters.
+ */
+const FilterRegistry& FilterRegistry::builtins()
+{
+  static const FilterRegistry registry = create_builtin_filters();
+  return registry;
+}
+
+/*!
+ * \fn void add(Filter filter)
+ * \brief registers a filter
+ *
+ * If a filter with the same name already exists, it is replaced.
+ * Templates that were parsed before keep using the previous filter.
+ */
+void FilterRegistry::add(Filter filter)
+{
+  std::string name = filter.name;
+  m_filters[name] = std::make_shared<const Filter>(std::move(filter));
+}
+
+/*!
+ * \fn void add(const std::string& name, Function func, Type input, std::vector<Type> args)
+ * \brief registers a filter
+ *
+ * All the arguments are required.
+ */
+void FilterRegistry::add(const std::string& name, Function func, Type input, std::vector<Type> args)
+{
+  Filter filter;
+  filter.name = name;
+  filter.function = std::move(func);
+  filter.inputType = input;
+  filter.argumentTypes = std::move(args);
+  filter.requiredArguments = filter.argumentTypes.size();
+  add(std::move(filter));
+}
+
+/*!
+ * \fn void remove(const std::string& name)
+ * \brief removes a filter
+ */
+void FilterRegistry::remove(const std::string& name)
+{
+  m_filters.erase(name);
+}
+
+/*!
+ * \fn void setPure(const std::string& name, bool pure)
+ * \brief declares whether a filter is pure
+ *
+ * A pure filter has no side effect and can be called concurrently from several threads: 
+ * \c{map_filter} then applies it to the elements of large arrays in parallel.
+ * Templates that were parsed before keep using the previous declaration.
+ */
+void FilterRegistry::setPure(const std::string& name, bool pure)
+{
+  auto it = m_filters.find(name);
+
+  if (it == m_filters.end() || it->second->pure == pure)
+    return;
+
+  Filter filter = *it->second;
+  filter.pure = pure;
+  it->second = std::make_shared<const Filter>(std::move(filter));
+}
+
+/*!
+ * \fn static Filter mapFilter(std::shared_ptr<const Filter> filter)
+ * \brief returns the filter applying \a filter to each element of an array
+ *
+ * This is the filter \c{map_filter: 'name', args...} resolves to when the template 
+ * is parsed: its first argument is the name of the filter and the other ones are 
+ * passed to it.
+ */
+FilterRegistry::Filter FilterRegistry::mapFilter(std::shared_ptr<const Filter> filter)
+{
+  Filter result;
+  result.name = "map_filter";
+  result.inputType = Array;
+  result.argumentTypes.push_back(String);
+  result.argumentTypes.insert(result.argumentTypes.end(), filter->argumentTypes.begin(), filter->argumentTypes.end());
+  result.requiredArguments = filter->requiredArguments + 1;
+  result.pure = filter->pure;
+  result.function = [filter](const liquid::Value& a, FilterArguments args) -> liquid::Value {
+    return ArrayFilters::map_filter(a.toArray(), *filter, FilterArguments(args.begin() + 1, args.size() - 1));
+  };
+  return result;
+}
+
+/*!
+ * \fn std::shared_ptr<const Filter> find(const std::string& name) const
+ * \brief returns the filter with the given name
+ *
+ * Returns nullptr if no such filter exists.
+ */
+std::shared_ptr<const FilterRegistry::Filter> FilterRegistry::find(const std::string& name) const
+{
+  auto it = m_filters.find(name);
+  return it != m_filters.end() ? it->second : nullptr;
+}
+
+/*!
+ * \fn bool contains(const std::string& name) const
+ * \brief returns whether a filter with the given name exists
+ */
+bool FilterRegistry::contains(const std::string& name) const
+{
+  return m_filters.find(name) != m_filters.end();
+}
+
+/*!
+ * \fn size_t size() const
+ * \brief returns the number of registered filters
+ */
+size_t FilterRegistry::size() const
+{
+  return m_filters.size();
+}
 
+/*!
+ * \fn static bool matches(Type type, const liquid::Value& val)
+ * \brief returns whether a value is of the given type
+ */
+bool FilterRegistry::matches(Type type, const liquid::Value& val)
+{
+  switch (type)
+  {
+  case Bool:
+    return val.is<bool>();
+  case Int:
+    return val.is<int>();
+  case Double:
+    return val.is<double>();
+  case String:
+    return val.is<std::string>();
+  case Array:
+    return val.isArray();
+  case Map:
+    return val.isMap();
+  default:
+    return true;
+  }
+}
+
+/*!
+ * \fn static std::string typeName(Type type)
+ * \brief returns a description of a type, to be used in error messages
+ */
+std::string FilterRegistry::typeName(Type type)
+{
+  switch (type)
+  {
+  case Bool:
+    return "a bool";
+  case Int:
+    return "an int";
+  case Double:
+    return "a double";
+  case String:
+    return "a string";
+  case Array:
+    return "an array";
+  case Map:
+    return "an object";
+  default:
+    return "a value";
+  }
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
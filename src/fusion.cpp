@@ -0,0 +1,297 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/fusion_p.h"
+
+#include "liquid/renderer.h"
+#include "liquid/simd_p.h"
+#include "liquid/utf8_p.h"
+
+#include <cstring>
+
+namespace liquid
+{
+
+/*!
+ * \namespace fusion
+ * \brief evaluates some chains of built-in filters in a single pass
+ *
+ * The parser marks the pipes that can be fused with analyze(); the renderer
+ * then evaluates them with eval().
+ * Whenever the values do not have the expected types, eval() applies the filters 
+ * one by one so that errors are reported by the filters themselves.
+ *
+ * Fusion only applies to the filters of \c{FilterRegistry::builtins()}:
+ * a filter that was replaced in the registry is never fused.
+ */
+
+namespace fusion
+{
+
+namespace
+{
+
+enum Stage {
+  NoStage,
+  Strip,
+  LStrip,
+  RStrip,
+  Upcase,
+  Downcase,
+  Truncate,
+};
+
+struct Builtins
+{
+  std::shared_ptr<const FilterRegistry::Filter> map;
+  std::shared_ptr<const FilterRegistry::Filter> join;
+  std::shared_ptr<const FilterRegistry::Filter> stages[Truncate + 1];
+
+  Builtins()
+  {
+    const FilterRegistry& reg = FilterRegistry::builtins();
+    map = reg.find("map");
+    join = reg.find("join");
+    stages[Strip] = reg.find("strip");
+    stages[LStrip] = reg.find("lstrip");
+    stages[RStrip] = reg.find("rstrip");
+    stages[Upcase] = reg.find("upcase");
+    stages[Downcase] = reg.find("downcase");
+    stages[Truncate] = reg.find("truncate");
+  }
+
+  Stage stage(const objects::Pipe& pipe) const
+  {
+    for (int s(Strip); s <= Truncate; ++s)
+    {
+      if (pipe.filter == stages[s])
+        return static_cast<Stage>(s);
+    }
+
+    return NoStage;
+  }
+};
+
+const Builtins& builtins()
+{
+  static const Builtins b;
+  return b;
+}
+
+const objects::Pipe* as_pipe(const std::shared_ptr<Object>& obj)
+{
+  return obj->is<objects::Pipe>() ? &obj->as<objects::Pipe>() : nullptr;
+}
+
+// collects the pipes of a string chain, outermost first;
+// truncate is only accepted as the last filter of the chain
+size_t string_chain(const objects::Pipe& pipe, const objects::Pipe* (&chain)[MaxStringChain])
+{
+  const Builtins& b = builtins();
+  size_t n = 0;
+
+  for (const objects::Pipe* p = &pipe; p && n < MaxStringChain; p = as_pipe(p->object))
+  {
+    Stage s = b.stage(*p);
+
+    if (s == NoStage || (s == Truncate && n > 0))
+      break;
+
+    chain[n++] = p;
+  }
+
+  return n;
+}
+
+// evaluates the arguments of a pipe and applies its filter to an evaluated object
+liquid::Value apply(Renderer& r, const objects::Pipe& pipe, const liquid::Value& obj)
+{
+  const std::vector<liquid::Value> args = r.eval(pipe.arguments);
+  return r.evalFilter(pipe, obj, args);
+}
+
+liquid::Value eval_map_join(Renderer& r, const objects::Pipe& pipe)
+{
+  const objects::Pipe& map = pipe.object->as<objects::Pipe>();
+
+  const liquid::Value source = r.eval(map.object);
+  const liquid::Value field = r.eval(map.arguments.front());
+
+  if (!source.isArray() || !field.is<std::string>())
+    return apply(r, pipe, r.evalFilter(map, source, FilterArguments(&field, 1)));
+
+  liquid::Value sep = pipe.arguments.empty() ? liquid::Value() : r.eval(pipe.arguments.front());
+  const std::string& name = field.as<std::string>();
+  const std::string empty;
+  const std::string& separator = sep.is<std::string>() ? sep.as<std::string>() : empty;
+
+  const liquid::Array a = source.toArray();
+  std::string out;
+  bool first = true;
+
+  for (size_t i(0); i < a.length(); ++i)
+  {
+    liquid::Value elem = a.at(i).property(name);
+
+    if (!elem.is<std::string>())
+      continue;
+
+    if (!first)
+      out += separator;
+
+    out += elem.as<std::string>();
+    first = false;
+  }
+
+  return out;
+}
+
+liquid::Value eval_string_chain(Renderer& r, const objects::Pipe& pipe)
+{
+  const objects::Pipe* chain[MaxStringChain];
+  const size_t n = string_chain(pipe, chain);
+  const Builtins& b = builtins();
+
+  liquid::Value source = r.eval(chain[n - 1]->object);
+
+  if (!source.is<std::string>())
+  {
+    for (size_t i(n); i-- > 0; )
+      source = apply(r, *chain[i], source);
+
+    return source;
+  }
+
+  const simd::Kernels& k = simd::kernels();
+  const std::string& str = source.as<std::string>();
+  const char* data = str.data();
+  size_t begin = 0;
+  size_t end = str.size();
+  Stage casing = NoStage;
+
+  liquid::Value ellipsis;
+
+  for (size_t i(n); i-- > 0; )
+  {
+    switch (b.stage(*chain[i]))
+    {
+    case Strip:
+      begin += k.skip_spaces(data + begin, end - begin);
+      end = begin + k.skip_spaces_backward(data + begin, end - begin);
+      break;
+    case LStrip:
+      begin += k.skip_spaces(data + begin, end - begin);
+      break;
+    case RStrip:
+      end = begin + k.skip_spaces_backward(data + begin, end - begin);
+      break;
+    case Upcase:
+    case Downcase:
+      casing = b.stage(*chain[i]);
+      break;
+    case Truncate:
+    {
+      // same rules as StringFilters::truncate()
+      const auto& args = chain[i]->arguments;
+      liquid::Value length = args.size() > 0 ? r.eval(args.at(0)) : liquid::Value(50);
+      ellipsis = args.size() > 1 ? r.eval(args.at(1)) : liquid::Value("...");
+
+      if (!length.is<int>() || !ellipsis.is<std::string>())
+      {
+        // truncate is the last filter, the ones before it take no argument
+        liquid::Value val = source;
+
+        for (size_t j(n); j-- > 1; )
+          val = r.evalFilter(*chain[j], val, FilterArguments());
+
+        const liquid::Value evaluated[] = { length, ellipsis };
+        return r.evalFilter(*chain[0], val, FilterArguments(evaluated, args.size()));
+      }
+
+      const int len = length.as<int>();
+      const utf8::Text text(data + begin, end - begin);
+
+      if (len < 0 || text.length() <= static_cast<size_t>(len))
+      {
+        ellipsis = liquid::Value();
+        break;
+      }
+
+      const std::string& e = ellipsis.as<std::string>();
+      const size_t suffix = utf8::length(e.data(), e.size());
+      end = begin + text.offset(static_cast<size_t>(len) > suffix ? len - suffix : 0);
+    }
+      break;
+    default:
+      break;
+    }
+  }
+
+  const size_t suffix = ellipsis.is<std::string>() ? ellipsis.as<std::string>().size() : 0;
+  std::string out;
+  out.resize(end - begin + suffix);
+
+  if (casing == Upcase)
+    k.to_upper(data + begin, end - begin, &out[0]);
+  else if (casing == Downcase)
+    k.to_lower(data + begin, end - begin, &out[0]);
+  else if (end > begin)
+    std::memcpy(&out[0], data + begin, end - begin);
+
+  if (suffix > 0)
+    std::memcpy(&out[end - begin], ellipsis.as<std::string>().data(), suffix);
+
+  return out;
+}
+
+} // namespace
+
+/*!
+ * \fn objects::Pipe::Fusion analyze(const objects::Pipe& pipe)
+ * \brief returns how a resolved pipe can be fused with the pipes it reads from
+ *
+ * \c{map: field | join: sep} is fused into a single loop that appends the
+ * selected strings without building the intermediate array.
+ * Chains of at least two of strip, lstrip, rstrip, upcase, downcase,
+ * optionally ending with truncate, are fused into a single allocation.
+ */
+objects::Pipe::Fusion analyze(const objects::Pipe& pipe)
+{
+  if (!pipe.filter)
+    return objects::Pipe::NotFused;
+
+  const Builtins& b = builtins();
+
+  if (pipe.filter == b.join)
+  {
+    const objects::Pipe* inner = as_pipe(pipe.object);
+    return inner && inner->filter == b.map && inner->arguments.size() == 1 ? objects::Pipe::MapJoin : objects::Pipe::NotFused;
+  }
+
+  const objects::Pipe* chain[MaxStringChain];
+  return string_chain(pipe, chain) >= 2 ? objects::Pipe::StringChain : objects::Pipe::NotFused;
+}
+
+/*!
+ * \fn liquid::Value eval(Renderer& r, const objects::Pipe& pipe)
+ * \brief evaluates a fused pipe
+ *
+ * If the values do not have the types the fused evaluation expects, the
+ * filters are applied one by one to the values that were already evaluated.
+ */
+liquid::Value eval(Renderer& r, const objects::Pipe& pipe)
+{
+  if (pipe.fusion == objects::Pipe::MapJoin)
+    return eval_map_join(r, pipe);
+  else
+    return eval_string_chain(r, pipe);
+}
+
+} // namespace fusion
+
+/*!
+ * \endnamespace
+ */
+
+} // namespace liquid
@@ -0,0 +1,567 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/json.h"
+
+#include "liquid/parser.h"
+#include "liquid/simd_p.h"
+#include "liquid/value_p.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+
+/*!
+ * \namespace liquid::json
+ * \brief reading and writing values as JSON
+ */
+
+namespace liquid
+{
+
+namespace json
+{
+
+static void write_escaped(std::string& output, char c)
+{
+  static const char* hex = "0123456789abcdef";
+
+  switch (c)
+  {
+  case '"': output += "\\\""; break;
+  case '\\': output += "\\\\"; break;
+  case '\n': output += "\\n"; break;
+  case '\r': output += "\\r"; break;
+  case '\t': output += "\\t"; break;
+  case '\b': output += "\\b"; break;
+  case '\f': output += "\\f"; break;
+  default:
+    output += "\\u00";
+    output.push_back(hex[(c >> 4) & 0xF]);
+    output.push_back(hex[c & 0xF]);
+    break;
+  }
+}
+
+// runs of characters that need no escaping are found with simd::Kernels::find_json_special()
+static void write_string(std::string& output, const std::string& str)
+{
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+  size_t pos = 0;
+
+  output.reserve(output.size() + n + 2);
+  output.push_back('"');
+
+  while (pos < n)
+  {
+    const size_t next = pos + k.find_json_special(data + pos, n - pos);
+    output.append(data + pos, next - pos);
+
+    if (next == n)
+      break;
+
+    write_escaped(output, data[next]);
+    pos = next + 1;
+  }
+
+  output.push_back('"');
+}
+
+static void write_integer(std::string& output, long long x)
+{
+  char buffer[24];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+  unsigned long long u = x < 0 ? 0ull - static_cast<unsigned long long>(x) : static_cast<unsigned long long>(x);
+
+  do
+  {
+    *--p = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+
+  if (x < 0)
+    *--p = '-';
+
+  output.append(p, end - p);
+}
+
+static void write_number(std::string& output, double x)
+{
+  if (std::isnan(x) || std::isinf(x))
+  {
+    output += "null";
+    return;
+  }
+
+  // integral values are written without going through printf()
+  if (std::abs(x) < 1e15 && x == std::floor(x) && !(x == 0 && std::signbit(x)))
+  {
+    write_integer(output, static_cast<long long>(x));
+    output += ".0";
+    return;
+  }
+
+  // shortest representation that reads back as the same value
+  char buffer[32];
+  int n = 0;
+
+  for (int precision(15); precision <= 17; ++precision)
+  {
+    n = std::snprintf(buffer, sizeof(buffer), "%.*g", precision, x);
+
+    if (std::strtod(buffer, nullptr) == x)
+      break;
+  }
+
+  output.append(buffer, static_cast<size_t>(n));
+
+  // ensures the number is read back as a double
+  if (output.find_first_of(".eE", output.size() - n) == std::string::npos)
+    output += ".0";
+}
+
+template<typename T>
+static void write_numbers(std::string& output, const std::vector<T>& values)
+{
+  output.push_back('[');
+
+  for (size_t i(0); i < values.size(); ++i)
+  {
+    if (i > 0)
+      output.push_back(',');
+
+    if (std::is_same<T, int>::value)
+      write_integer(output, static_cast<long long>(values[i]));
+    else
+      write_number(output, static_cast<double>(values[i]));
+  }
+
+  output.push_back(']');
+}
+
+/*!
+ * \fn void write(std::string& output, const liquid::Value& val)
+ * \brief appends the JSON representation of a value to a string
+ *
+ * Values that have no JSON representation (e.g. a custom IValue that is
+ * neither an array nor a map) are written as \c{null}.
+ *
+ * Everything is appended to \a output directly: the arrays and maps built 
+ * by the library are read without copying their elements or property names.
+ */
+void write(std::string& output, const liquid::Value& val)
+{
+  const std::type_index type = val.impl()->type_index();
+
+  if (val.is<std::string>())
+  {
+    write_string(output, val.as<std::string>());
+  }
+  else if (val.is<int>())
+  {
+    write_integer(output, val.as<int>());
+  }
+  else if (val.is<double>())
+  {
+    write_number(output, val.as<double>());
+  }
+  else if (val.is<bool>())
+  {
+    output += val.as<bool>() ? "true" : "false";
+  }
+  else if (type == std::type_index(typeid(std::vector<int>)))
+  {
+    write_numbers(output, *static_cast<const std::vector<int>*>(val.impl()->data()));
+  }
+  else if (type == std::type_index(typeid(std::vector<double>)))
+  {
+    write_numbers(output, *static_cast<const std::vector<double>*>(val.impl()->data()));
+  }
+  else if (type == std::type_index(typeid(std::vector<liquid::Value>)))
+  {
+    const auto& values = static_cast<const VectorValue&>(*val.impl()).values;
+    output.push_back('[');
+
+    for (size_t i(0); i < values.size(); ++i)
+    {
+      if (i > 0)
+        output.push_back(',');
+
+      write(output, values[i]);
+    }
+
+    output.push_back(']');
+  }
+  else if (val.isArray())
+  {
+    output.push_back('[');
+
+    for (size_t i(0); i < val.length(); ++i)
+    {
+      if (i > 0)
+        output.push_back(',');
+
+      write(output, val.at(i));
+    }
+
+    output.push_back(']');
+  }
+  else if (type == std::type_index(typeid(std::map<std::string, liquid::Value>)))
+  {
+    const auto& dict = static_cast<const MapValue&>(*val.impl()).dict;
+    output.push_back('{');
+
+    for (auto it = dict.begin(); it != dict.end(); ++it)
+    {
+      if (it != dict.begin())
+        output.push_back(',');
+
+      write_string(output, it->first);
+      output.push_back(':');
+      write(output, it->second);
+    }
+
+    output.push_back('}');
+  }
+  else if (val.isMap())
+  {
+    output.push_back('{');
+
+    bool first = true;
+
+    for (const std::string& name : val.propertyNames())
+    {
+      if (!first)
+        output.push_back(',');
+
+      write_string(output, name);
+      output.push_back(':');
+      write(output, val.property(name));
+      first = false;
+    }
+
+    output.push_back('}');
+  }
+  else
+  {
+    output += "null";
+  }
+}
+
+/*!
+ * \fn std::string stringify(const liquid::Value& val)
+ * \brief returns the JSON representation of a value
+ */
+std::string stringify(const liquid::Value& val)
+{
+  std::string result;
+  write(result, val);
+  return result;
+}
+
+namespace
+{
+
+class JsonReader
+{
+public:
+  const std::string& text;
+  size_t pos = 0;
+
+  explicit JsonReader(const std::string& str)
+    : text(str)
+  {
+
+  }
+
+  [[noreturn]] void error(const std::string& mssg) const
+  {
+    throw ParserException{ pos, "JSON: " + mssg };
+  }
+
+  void skipSpaces()
+  {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+      ++pos;
+  }
+
+  char peek()
+  {
+    skipSpaces();
+
+    if (pos == text.size())
+      error("unexpected end of input");
+
+    return text[pos];
+  }
+
+  void expect(char c)
+  {
+    if (peek() != c)
+      error(std::string("expected '") + c + "'");
+
+    ++pos;
+  }
+
+  void expectWord(const char* word)
+  {
+    for (; *word; ++word, ++pos)
+    {
+      if (pos == text.size() || text[pos] != *word)
+        error("invalid literal");
+    }
+  }
+
+  liquid::Value readValue()
+  {
+    char c = peek();
+
+    switch (c)
+    {
+    case '{':
+      return readObject();
+    case '[':
+      return readArray();
+    case '"':
+      return readString();
+    case 't':
+      return expectWord("true"), liquid::Value(true);
+    case 'f':
+      return expectWord("false"), liquid::Value(false);
+    case 'n':
+      return expectWord("null"), liquid::Value();
+    default:
+      if (c == '-' || (c >= '0' && c <= '9'))
+        return readNumber();
+      error(std::string("unexpected character '") + c + "'");
+    }
+  }
+
+  liquid::Value readObject()
+  {
+    expect('{');
+
+    std::map<std::string, liquid::Value> dict;
+
+    if (peek() == '}')
+      return ++pos, liquid::Value(std::move(dict));
+
+    for (;;)
+    {
+      if (peek() != '"')
+        error("expected property name");
+
+      std::string name = readString();
+      expect(':');
+      dict[name] = readValue();
+
+      if (peek() == ',')
+        ++pos;
+      else
+        break;
+    }
+
+    expect('}');
+    return liquid::Value(std::move(dict));
+  }
+
+  liquid::Value readArray()
+  {
+    expect('[');
+
+    std::vector<liquid::Value> values;
+
+    if (peek() == ']')
+      return ++pos, liquid::Value(std::move(values));
+
+    for (;;)
+    {
+      values.push_back(readValue());
+
+      if (peek() == ',')
+        ++pos;
+      else
+        break;
+    }
+
+    expect(']');
+    return liquid::Value(std::move(values));
+  }
+
+  unsigned readHex4()
+  {
+    if (pos + 4 > text.size())
+      error("invalid unicode escape");
+
+    unsigned result = 0;
+
+    for (int i(0); i < 4; ++i)
+    {
+      char c = text[pos++];
+      result <<= 4;
+
+      if (c >= '0' && c <= '9')
+        result |= static_cast<unsigned>(c - '0');
+      else if (c >= 'a' && c <= 'f')
+        result |= static_cast<unsigned>(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        result |= static_cast<unsigned>(c - 'A' + 10);
+      else
+        error("invalid unicode escape");
+    }
+
+    return result;
+  }
+
+  static void appendUtf8(std::string& str, unsigned cp)
+  {
+    if (cp < 0x80)
+    {
+      str.push_back(static_cast<char>(cp));
+    }
+    else if (cp < 0x800)
+    {
+      str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+      str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+      str.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  std::string readString()
+  {
+    expect('"');
+
+    std::string result;
+
+    for (;;)
+    {
+      if (pos == text.size())
+        error("unterminated string");
+
+      char c = text[pos++];
+
+      if (c == '"')
+        break;
+
+      if (c != '\\')
+      {
+        result.push_back(c);
+        continue;
+      }
+
+      if (pos == text.size())
+        error("unterminated string");
+
+      c = text[pos++];
+
+      switch (c)
+      {
+      case '"': result.push_back('"'); break;
+      case '\\': result.push_back('\\'); break;
+      case '/': result.push_back('/'); break;
+      case 'b': result.push_back('\b'); break;
+      case 'f': result.push_back('\f'); break;
+      case 'n': result.push_back('\n'); break;
+      case 'r': result.push_back('\r'); break;
+      case 't': result.push_back('\t'); break;
+      case 'u':
+      {
+        unsigned cp = readHex4();
+
+        if (cp >= 0xD800 && cp < 0xDC00 && pos + 1 < text.size() && text[pos] == '\\' && text[pos + 1] == 'u')
+        {
+          pos += 2;
+          unsigned low = readHex4();
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        appendUtf8(result, cp);
+      }
+      break;
+      default:
+        error("invalid escape sequence");
+      }
+    }
+
+    return result;
+  }
+
+  liquid::Value readNumber()
+  {
+    const size_t start = pos;
+    bool is_integer = true;
+
+    if (text[pos] == '-')
+      ++pos;
+
+    while (pos < text.size())
+    {
+      char c = text[pos];
+
+      if (c >= '0' && c <= '9')
+        ++pos;
+      else if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+        ++pos, is_integer = false;
+      else
+        break;
+    }
+
+    const std::string str = text.substr(start, pos - start);
+
+    if (is_integer)
+    {
+      long long n = std::strtoll(str.c_str(), nullptr, 10);
+
+      if (n >= std::numeric_limits<int>::min() && n <= std::numeric_limits<int>::max())
+        return liquid::Value(static_cast<int>(n));
+    }
+
+    return liquid::Value(std::strtod(str.c_str(), nullptr));
+  }
+};
+
+} // namespace
+
+/*!
+ * \fn liquid::Value parse(const std::string& str)
+ * \brief parses a JSON document
+ *
+ * Numbers without a fractional part or exponent that fit in an int are
+ * returned as int, other numbers are returned as double.
+ *
+ * This function throws ParserException if the document is not valid JSON.
+ */
+liquid::Value parse(const std::string& str)
+{
+  JsonReader reader{ str };
+  liquid::Value result = reader.readValue();
+
+  reader.skipSpaces();
+
+  if (reader.pos != str.size())
+    reader.error("unexpected trailing characters");
+
+  return result;
+}
+
+} // namespace json
+
+} // namespace liquid
@@ -15,6 +15,19 @@ Object::Object(size_t off)
 
 }
 
+/*!
+ * \fn bool acceptCondition(Renderer& renderer)
+ * \brief evaluates the object as the condition of a tag
+ *
+ * The default implementation tests the value returned by accept();
+ * objects whose truthiness can be computed without creating a value
+ * override this function.
+ */
+bool Object::acceptCondition(Renderer& renderer)
+{
+  return Renderer::evalCondition(accept(renderer));
+}
+
 namespace objects
 {
 
@@ -30,6 +43,11 @@ liquid::Value Value::accept(Renderer& r)
   return r.visitObject(*this);
 }
 
+bool Value::acceptCondition(Renderer& r)
+{
+  return r.visitCondition(*this);
+}
+
 Variable::Variable(std::string n, size_t off)
   : Object(off),
     name(std::move(n))
@@ -55,6 +73,88 @@ liquid::Value ArrayAccess::accept(Renderer& r)
   return r.visitObject(*this);
 }
 
+/*!
+ * \class InlineCache
+ *
+ * Each type seen by the member access is stored once, up to MaxEntries types;
+ * a monomorphic access, the common case, finds its slot in the first entry.
+ * Entries are never modified once published, and are only deleted with 
+ * the cache, so that a template can be rendered from several threads.
+ */
+
+InlineCache::~InlineCache()
+{
+  Entry* e = m_head.load();
+
+  while (e)
+  {
+    Entry* next = e->next;
+    delete e;
+    e = next;
+  }
+}
+
+/*!
+ * \fn bool lookup(const IValue& val, int& slot) const
+ * \brief retrieves the slot cached for the type of \a val
+ */
+bool InlineCache::lookup(const IValue& val, int& slot) const
+{
+  const std::type_info& type = typeid(val);
+
+  for (const Entry* e = m_head.load(std::memory_order_acquire); e; e = e->next)
+  {
+    if (*e->type == type)
+    {
+      slot = e->slot;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*!
+ * \fn void store(const IValue& val, int slot)
+ * \brief caches the slot for the type of \a val
+ *
+ * Does nothing if the type is already cached or if the cache is full.
+ */
+void InlineCache::store(const IValue& val, int slot)
+{
+  const std::type_info& type = typeid(val);
+  Entry* head = m_head.load(std::memory_order_acquire);
+  Entry* e = nullptr;
+
+  do
+  {
+    const Entry* it = head;
+
+    while (it && *it->type != type)
+      it = it->next;
+
+    const int depth = head ? head->depth + 1 : 1;
+
+    // the type was stored by another thread, or the access is megamorphic 
+    // and names will be resolved every time
+    if (it || depth > MaxEntries)
+    {
+      delete e;
+      return;
+    }
+
+    if (!e)
+      e = new Entry{ &type, slot, depth, head };
+
+    e->depth = depth;
+    e->next = head;
+  } while (!m_head.compare_exchange_weak(head, e, std::memory_order_acq_rel, std::memory_order_acquire));
+}
+
+/*!
+ * \endclass
+ */
+
 MemberAccess::MemberAccess(const std::shared_ptr<Object>& obj, const std::string& name, size_t off)
   : Object(off),
     object(obj),
@@ -82,6 +182,11 @@ liquid::Value BinOp::accept(Renderer& r)
   return r.visitObject(*this);
 }
 
+bool BinOp::acceptCondition(Renderer& r)
+{
+  return r.visitCondition(*this);
+}
+
 LogicalNot::LogicalNot(const std::shared_ptr<Object>& obj, size_t off)
   : Object(off),
     object(obj)
@@ -94,6 +199,11 @@ liquid::Value LogicalNot::accept(Renderer& r)
   return r.visitObject(*this);
 }
 
+bool LogicalNot::acceptCondition(Renderer& r)
+{
+  return r.visitCondition(*this);
+}
+
 Pipe::Pipe(const std::shared_ptr<Object>& object, const std::string& filtername, const std::vector<std::shared_ptr<Object>>& args, size_t off)
   : Object(off), 
     object(object),
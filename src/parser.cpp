@@ -4,6 +4,7 @@
 
 #include "liquid/parser.h"
 
+#include "liquid/fusion_p.h"
 #include "liquid/tags.h"
 
 #include <algorithm>
@@ -285,9 +286,13 @@ class ObjectParser
 {
 public:
   std::vector<Token>& tokens;
+  const FilterRegistry* filters;
+  bool strictFilters;
 
-  explicit ObjectParser(std::vector<Token>& toks)
-    : tokens(toks)
+  explicit ObjectParser(std::vector<Token>& toks, const FilterRegistry* registry = nullptr, bool strict = false)
+    : tokens(toks),
+      filters(registry),
+      strictFilters(strict)
   {
 
   }
@@ -404,7 +409,7 @@ public:
         if (subtokens.empty())
           throw ParserException{ left_bracket.text.offset_, "Invalid empty index in array access" };
 
-        ObjectParser subobj_parser{ subtokens };
+        ObjectParser subobj_parser{ subtokens, filters, strictFilters };
         std::shared_ptr<liquid::Object> index = subobj_parser.parse();
         obj = std::make_shared<objects::ArrayAccess>(obj, index, tok.text.offset_);
       }
@@ -474,7 +479,10 @@ public:
     auto ret = std::make_shared<objects::Pipe>(obj, name, tok.text.offset_);
 
     if (tokens.empty() || tokens.front().kind == Token::Pipe)
+    {
+      resolveFilter(*ret);
       return ret;
+    }
 
     if (tokens.front().kind != Token::Colon)
       throw ParserException{ tokens.front().text.offset_, "Expected ':' after filter name" };
@@ -495,9 +503,92 @@ public:
       vec::take_first(tokens);
     }
 
+    resolveFilter(*ret);
+
     return ret;
   }
 
+  void resolveFilter(objects::Pipe& pipe)
+  {
+    if (!filters)
+      return;
+
+    pipe.filter = filters->find(pipe.filterName);
+
+    if (!pipe.filter)
+    {
+      if (strictFilters)
+        throw ParserException{ pipe.offset(), "Unknown filter '" + pipe.filterName + "'" };
+
+      // left to Renderer::applyFilter()
+      return;
+    }
+
+    try
+    {
+      checkFilter(pipe);
+    }
+    catch (const ParserException&)
+    {
+      if (strictFilters)
+        throw;
+
+      // Renderer::applyFilter() may implement a filter with the same name,
+      // otherwise the error is reported at render time
+      pipe.filter = nullptr;
+      return;
+    }
+
+    // a renderer overriding applyFilter() takes precedence over the builtins
+    pipe.overridable = !strictFilters && pipe.filter == FilterRegistry::builtins().find(pipe.filterName);
+    pipe.fusion = fusion::analyze(pipe);
+  }
+
+  void checkFilter(objects::Pipe& pipe)
+  {
+    if (pipe.filterName == "map_filter" && pipe.filter == FilterRegistry::builtins().find("map_filter"))
+      resolveMappedFilter(pipe);
+
+    const FilterRegistry::Filter& filter = *pipe.filter;
+
+    if (!filter.acceptsArgumentCount(pipe.arguments.size()))
+    {
+      std::string expected = std::to_string(filter.requiredArguments);
+
+      if (filter.argumentTypes.size() != filter.requiredArguments)
+        expected += " to " + std::to_string(filter.argumentTypes.size());
+
+      throw ParserException{ pipe.offset(), "Filter '" + pipe.filterName + "' expects " + expected + " argument(s)" };
+    }
+
+    // literals can already be type-checked
+    if (pipe.object->is<objects::Value>() && !FilterRegistry::matches(filter.inputType, pipe.object->as<objects::Value>().value))
+      throw ParserException{ pipe.offset(), "Filter '" + pipe.filterName + "' expects " + FilterRegistry::typeName(filter.inputType) + " as input" };
+
+    for (size_t i(0); i < pipe.arguments.size(); ++i)
+    {
+      const auto& arg = pipe.arguments.at(i);
+
+      if (arg->is<objects::Value>() && !FilterRegistry::matches(filter.argumentTypes.at(i), arg->as<objects::Value>().value))
+        throw ParserException{ arg->offset(), "Filter '" + pipe.filterName + "' expects " + FilterRegistry::typeName(filter.argumentTypes.at(i)) + " as argument " + std::to_string(i + 1) };
+    }
+  }
+
+  // binds map_filter to the filter named by its first argument
+  void resolveMappedFilter(objects::Pipe& pipe)
+  {
+    if (pipe.arguments.empty() || !pipe.arguments.front()->is<objects::Value>() || !pipe.arguments.front()->as<objects::Value>().value.is<std::string>())
+      throw ParserException{ pipe.offset(), "Filter 'map_filter' expects the name of a filter as first argument" };
+
+    const std::string& name = pipe.arguments.front()->as<objects::Value>().value.as<std::string>();
+    std::shared_ptr<const FilterRegistry::Filter> mapped = filters->find(name);
+
+    if (!mapped)
+      throw ParserException{ pipe.arguments.front()->offset(), "Unknown filter '" + name + "'" };
+
+    pipe.filter = std::make_shared<const FilterRegistry::Filter>(FilterRegistry::mapFilter(mapped));
+  }
+
   std::shared_ptr<liquid::Object> parseObject()
   {
     assert(!tokens.empty());
@@ -534,7 +625,9 @@ public:
 };
 
 Parser::Parser()
-  : mPosition(0)
+  : mPosition(0),
+    mFilters(&FilterRegistry::builtins()),
+    mStrictFilters(false)
 {
 
 }
@@ -634,8 +727,9 @@ void Parser::dispatchNode(std::shared_ptr<liquid::templates::Node> n)
     const bool is_for = top->is<tags::For>();
     const bool is_if = !is_for && top->is<tags::If>();
     const bool is_capture = !is_for && !is_if && top->is<tags::Capture>();
+    const bool is_case = !is_for && !is_if && !is_capture && top->is<tags::Case>();
 
-    assert(is_for || is_if || is_capture);
+    assert(is_for || is_if || is_capture || is_case);
 
     if (is_for)
       top->as<tags::For>().body.push_back(n);
@@ -643,6 +737,8 @@ void Parser::dispatchNode(std::shared_ptr<liquid::templates::Node> n)
       top->as<tags::If>().blocks.back().body.push_back(n);
     else if (is_capture)
       top->as<tags::Capture>().body.push_back(n);
+    else if (is_case && !top->as<tags::Case>().whens.empty()) // what precedes the first 'when' is ignored
+      top->as<tags::Case>().whens.back().body.push_back(n);
   }
 }
 
@@ -660,6 +756,12 @@ void Parser::processTag(std::vector<Token> & tokens)
     process_tag_else(tok, tokens);
   else if (tok == "endif")
     process_tag_endif(tok, tokens);
+  else if (tok == "case")
+    process_tag_case(tok, tokens);
+  else if (tok == "when")
+    process_tag_when(tok, tokens);
+  else if (tok == "endcase")
+    process_tag_endcase(tok, tokens);
   else if (tok == "for")
     process_tag_for(tok, tokens);
   else if (tok == "break")
@@ -686,9 +788,59 @@ void Parser::processTag(std::vector<Token> & tokens)
     throw ParserException{ tok.text.offset_, "Unknown tag name" };
 }
 
+/*!
+ * \fn const FilterRegistry& filters() const
+ * \brief returns the registry used to resolve filters
+ *
+ * By default, this is \c{FilterRegistry::builtins()}.
+ */
+const FilterRegistry& Parser::filters() const
+{
+  return *mFilters;
+}
+
+/*!
+ * \fn void setFilters(const FilterRegistry& filters)
+ * \brief sets the registry used to resolve filters
+ *
+ * The registry must outlive the calls to \c{parse()}, but not the 
+ * parsed templates.
+ */
+void Parser::setFilters(const FilterRegistry& filters)
+{
+  mFilters = &filters;
+}
+
+/*!
+ * \fn bool strictFilters() const
+ * \brief returns whether unknown filters are reported as errors
+ */
+bool Parser::strictFilters() const
+{
+  return mStrictFilters;
+}
+
+/*!
+ * \fn void setStrictFilters(bool on)
+ * \brief sets whether unknown filters are reported as errors
+ *
+ * In non-strict mode (the default), filters that are not in the registry, 
+ * or that are used with a wrong number or type of arguments, are left unresolved 
+ * and are dispatched at render time through \c{Renderer::applyFilter()}.
+ * Builtin filters are resolved but can still be overridden by a renderer
+ * reimplementing \c{Renderer::applyFilter()}.
+ *
+ * In strict mode, the renderer calls the filters of the registry directly and
+ * invalid filter expressions are reported as errors.
+ */
+void Parser::setStrictFilters(bool on)
+{
+  mStrictFilters = on;
+}
+
 std::shared_ptr<liquid::Object> Parser::parseObject(std::vector<Token> & tokens)
 {
-  ObjectParser parser{ tokens };
+  ObjectParser parser{ tokens, mFilters, mStrictFilters };
   return parser.parse();
 }
 
@@ -757,6 +909,17 @@ void Parser::process_tag_elsif(const Token& keyword, std::vector<Token>& tokens)
 
 void Parser::process_tag_else(const Token& keyword, std::vector<Token>& tokens)
 {
+  if (!stack().empty() && stack().back()->is<tags::Case>())
+  {
+    tags::Case& tag = stack().back()->as<tags::Case>();
+
+    if (tag.hasElse())
+      throw ParserException{ keyword.text.offset_, "Unexpected 'else' tag" };
+
+    tag.whens.push_back(tags::Case::When());
+    return;
+  }
+
   if (stack().empty() || !stack().back()->is<tags::If>())
     throw ParserException{ keyword.text.offset_, "Unexpected 'else' tag" };
 
@@ -776,6 +939,53 @@ void Parser::process_tag_endif(const Token& keyword, std::vector<Token>& tokens)
   dispatchNode(node);
 }
 
+void Parser::process_tag_case(const Token& keyword, std::vector<Token>& tokens)
+{
+  if (tokens.empty())
+    throw ParserException{ keyword.text.offset_, "Expected an expression after 'case'" };
+
+  auto expr = parseObject(tokens);
+  auto tag = std::make_shared<tags::Case>(expr, keyword.text.offset_);
+  mStack.push_back(tag);
+}
+
+void Parser::process_tag_when(const Token& keyword, std::vector<Token>& tokens)
+{
+  if (stack().empty() || !stack().back()->is<tags::Case>() || stack().back()->as<tags::Case>().hasElse())
+    throw ParserException{ keyword.text.offset_, "Unexpected 'when' tag" };
+
+  // values are separated by ',' or 'or'
+  tags::Case::When when;
+  std::vector<Token> buffer;
+
+  for (size_t i(0); i <= tokens.size(); ++i)
+  {
+    if (i < tokens.size() && tokens.at(i) != "," && tokens.at(i) != "or")
+    {
+      buffer.push_back(tokens.at(i));
+      continue;
+    }
+
+    if (buffer.empty())
+      throw ParserException{ keyword.text.offset_, "Expected a value in 'when' tag" };
+
+    when.values.push_back(parseObject(buffer));
+    buffer.clear();
+  }
+
+  stack().back()->as<tags::Case>().whens.push_back(std::move(when));
+}
+
+void Parser::process_tag_endcase(const Token& keyword, std::vector<Token>& tokens)
+{
+  if (stack().empty() || !stack().back()->is<tags::Case>())
+    throw ParserException{ keyword.text.offset_, "Unexpected 'endcase' tag" };
+
+  auto node = vec::take_last(mStack);
+  node->as<tags::Case>().compile();
+  dispatchNode(node);
+}
+
 void Parser::process_tag_for(const Token& keyword, std::vector<Token>& tokens)
 {
   std::string name = vec::take_first(tokens).toString();
@@ -816,9 +1026,12 @@ class IncludeParser
 public:
   tags::Include& result;
   std::vector<Token>& tokens;
+  const FilterRegistry& filters;
+  bool strictFilters;
   size_t index = 0;
 
-  IncludeParser(tags::Include& target, std::vector<Token>& toks) : result(target), tokens(toks)
+  IncludeParser(tags::Include& target, std::vector<Token>& toks, const FilterRegistry& registry, bool strict) 
+    : result(target), tokens(toks), filters(registry), strictFilters(strict)
   {
 
   }
@@ -863,7 +1076,7 @@ public:
         buffer.push_back(tok);
       }
 
-      ObjectParser obj_parser{ buffer };
+      ObjectParser obj_parser{ buffer, &filters, strictFilters };
       auto obj = obj_parser.parse();
       result.objects[name] = obj;
     }
@@ -889,7 +1102,7 @@ void Parser::process_tag_include(const Token& keyword, std::vector<Token>& token
 
     tokens.erase(tokens.begin());
 
-    IncludeParser incparser{ *result, tokens };
+    IncludeParser incparser{ *result, tokens, filters(), strictFilters() };
     incparser.parse();
   }
 
@@ -4,8 +4,16 @@
 
 #include "liquid/renderer.h"
 
+#include "liquid/cache_p.h"
 #include "liquid/context.h"
 #include "liquid/filters.h"
+#include "liquid/fusion_p.h"
+#include "liquid/json.h"
+#include "liquid/simd_p.h"
+#include "liquid/trace_p.h"
+#include "liquid/utf8_p.h"
+
+#include <type_traits>
 
 /*!
  * \namespace liquid
@@ -30,7 +38,11 @@ Renderer::Error::Error(size_t off, std::string mssg)
  * \brief constructs a renderer
  */
 Renderer::Renderer()
-  : m_template(nullptr)
+  : m_template(nullptr),
+    m_cache(std::make_shared<RenderCache>()),
+    m_escaping(NoEscaping),
+    m_stringify_mode(LiquidStringify),
+    m_virtual_filter_dispatch(false)
 {
 
 }
@@ -53,6 +65,7 @@ void Renderer::reset()
   m_result.clear();
   m_errors.clear();
   m_template = nullptr;
+  m_cache->clear();
   context().scopes().clear();
   context().scopes().emplace_back();
   context().flags() = 0;
@@ -96,6 +109,155 @@ const std::vector<Renderer::Error>& Renderer::errors() const
   return m_errors;
 }
 
+/*!
+ * \fn void setEscaping(Escaping mode)
+ * \brief sets how the result of output statements is escaped
+ *
+ * With \c{HtmlEscaping}, the characters <>&"' produced by \c{{{ }}} are replaced 
+ * by HTML entities; text outside of output statements is never escaped.
+ * The result of a statement whose last filter has \c{rawOutput} set (e.g. \c{raw} 
+ * or \c{safe}) is written as is, including when the renderer dispatches builtin 
+ * filters through \c{applyFilter()}.
+ *
+ * Note that the result of a \c{capture} is escaped when it is captured.
+ */
+void Renderer::setEscaping(Escaping mode)
+{
+  m_escaping = mode == CustomEscaping && !m_escape_function ? NoEscaping : mode;
+}
+
+/*!
+ * \fn void setEscaping(EscapeFunction func)
+ * \brief escapes the result of output statements with a custom function
+ */
+void Renderer::setEscaping(EscapeFunction func)
+{
+  m_escape_function = std::move(func);
+  m_escaping = m_escape_function ? CustomEscaping : NoEscaping;
+}
+
+/*!
+ * \fn Escaping escaping() const
+ * \brief returns the escaping policy
+ */
+Renderer::Escaping Renderer::escaping() const
+{
+  return m_escaping;
+}
+
+/*!
+ * \fn void setStringifyMode(StringifyMode mode)
+ * \brief sets how arrays and maps are converted to strings
+ *
+ * With \c{JsonStringify}, arrays and maps produced by output statements are 
+ * written as JSON (see \c{json::write()}); when they are not escaped, they are 
+ * appended to the output directly, without calling \c{stringify()}.
+ * Other values are written as usual.
+ */
+void Renderer::setStringifyMode(StringifyMode mode)
+{
+  m_stringify_mode = mode;
+}
+
+/*!
+ * \fn StringifyMode stringifyMode() const
+ * \brief returns how arrays and maps are converted to strings
+ */
+Renderer::StringifyMode Renderer::stringifyMode() const
+{
+  return m_stringify_mode;
+}
+
+/*!
+ * \fn bool virtualFilterDispatch() const
+ * \brief returns whether builtin filters are dispatched through applyFilter()
+ */
+bool Renderer::virtualFilterDispatch() const
+{
+  return m_virtual_filter_dispatch;
+}
+
+/*!
+ * \fn void setVirtualFilterDispatch(bool on)
+ * \brief sets whether builtin filters are dispatched through applyFilter()
+ *
+ * Templates parsed without a registry resolve the builtin filters, which the
+ * renderer then calls directly. A derived renderer whose reimplementation of
+ * \c{applyFilter()} handles some builtin names must enable this so that these
+ * filters go through it; filters resolved with an explicit registry are
+ * always called directly.
+ *
+ * This disables the fast paths of builtin filters (fusion, memoization).
+ */
+void Renderer::setVirtualFilterDispatch(bool on)
+{
+  m_virtual_filter_dispatch = on;
+}
+
+/*!
+ * \fn void setFilterCache(std::shared_ptr<FilterCache> cache)
+ * \brief sets a cache for the results of pure filters that persists across renders
+ *
+ * Pure filters called several times with the same input and arguments are 
+ * always evaluated once per render; with a FilterCache, which can be shared 
+ * by several renderers, their results are also reused by the next renders.
+ */
+void Renderer::setFilterCache(std::shared_ptr<FilterCache> cache)
+{
+  m_cache->setFilterCache(std::move(cache));
+}
+
+/*!
+ * \fn const std::shared_ptr<FilterCache>& filterCache() const
+ * \brief returns the cache set with \c{setFilterCache()}
+ */
+const std::shared_ptr<FilterCache>& Renderer::filterCache() const
+{
+  return m_cache->filterCache();
+}
+
+/*!
+ * \fn void setRecording(bool on)
+ * \brief enables or disables the recording mode
+ *
+ * While recording, each call to \c{render()} produces a Trace containing 
+ * the template, the included templates and the part of the data that was 
+ * accessed. The trace of the last render is available through \c{trace()}.
+ * 
+ * Note that in recording mode, 'global' assignments are not written 
+ * into the data passed to \c{render()}.
+ */
+void Renderer::setRecording(bool on)
+{
+  if (on && !m_recorder)
+    m_recorder = std::make_shared<TraceRecorder>();
+  else if (!on)
+    m_recorder.reset();
+}
+
+/*!
+ * \fn bool isRecording() const
+ * \brief returns whether the recording mode is enabled
+ */
+bool Renderer::isRecording() const
+{
+  return m_recorder != nullptr;
+}
+
+/*!
+ * \fn const Trace& trace() const
+ * \brief returns the trace of the last render
+ * 
+ * The recording mode must be enabled.
+ */
+const Trace& Renderer::trace() const
+{
+  if (!m_recorder)
+    throw std::runtime_error{ "Renderer is not in recording mode" };
+
+  return m_recorder->trace;
+}
+
 /*!
  * \fn const Template& model() const
  * \brief returns the template that is currently used
@@ -125,12 +287,16 @@ std::string Renderer::render(const Template& t, const liquid::Map& data)
 {
   reset();
 
-  context().currentScope().data = data;
+  if (m_recorder)
+    context().currentScope().data = m_recorder->start(t, data);
+  else
+    context().currentScope().data = data;
 
   m_template = &t;
 
   try
   {
+    RenderCache::Scope cache_scope{ *m_cache };
     Context::Scope template_scope{ context(), t };
 
     for (auto n : t.nodes())
@@ -147,6 +313,7 @@ std::string Renderer::render(const Template& t, const liquid::Map& data)
   }
 
   m_template = nullptr;
+  m_cache->clear();
 
   if (context().flags() & Context::Eject)
   {
@@ -159,6 +326,27 @@ std::string Renderer::render(const Template& t, const liquid::Map& data)
   return m_result;
 }
 
+// returns whether the filter resolved at parse time can be called directly
+static bool is_bound(const Renderer& r, const objects::Pipe& pipe)
+{
+  return pipe.filter && (!pipe.overridable || !r.virtualFilterDispatch());
+}
+
+// a builtin dispatched through applyFilter() keeps its raw output
+static bool has_raw_output(const Object& obj)
+{
+  const objects::Pipe* pipe = dynamic_cast<const objects::Pipe*>(&obj);
+  return pipe && pipe->filter && pipe->filter->rawOutput;
+}
+
+// returns the pipe if the object is a call to the built-in json filter
+static const objects::Pipe* json_pipe(const Renderer& r, const Object& obj)
+{
+  static const std::shared_ptr<const FilterRegistry::Filter> json_filter = FilterRegistry::builtins().find("json");
+  const objects::Pipe* pipe = dynamic_cast<const objects::Pipe*>(&obj);
+  return pipe && pipe->filter == json_filter && is_bound(r, *pipe) ? pipe : nullptr;
+}
+
 void Renderer::process(const std::shared_ptr<Template::Node>& n)
 {
   if (n->isText())
@@ -167,7 +355,28 @@ void Renderer::process(const std::shared_ptr<Template::Node>& n)
   }
   else if (n->isObject())
   {
-    write(stringify(eval(std::static_pointer_cast<Object>(n))));
+    std::shared_ptr<Object> obj = std::static_pointer_cast<Object>(n);
+
+    if (m_escaping == NoEscaping || has_raw_output(*obj))
+    {
+      // JSON is written directly into the output
+      if (const objects::Pipe* pipe = json_pipe(*this, *obj))
+      {
+        json::write(m_result, eval(pipe->object));
+        return;
+      }
+
+      liquid::Value val = eval(obj);
+
+      if (m_stringify_mode == JsonStringify && (val.isArray() || val.isMap()))
+        json::write(m_result, val);
+      else
+        write(stringify(val));
+    }
+    else
+    {
+      writeEscaped(stringify(eval(obj)));
+    }
   }
   else if (n->isTag())
   {
@@ -264,6 +473,9 @@ std::string Renderer::defaultStringify(const liquid::Value& val)
 
 std::string Renderer::stringify(const liquid::Value& val)
 {
+  if (m_stringify_mode == JsonStringify && (val.isArray() || val.isMap()))
+    return json::stringify(val);
+
   return defaultStringify(val);
 }
 
@@ -272,6 +484,26 @@ void Renderer::write(const std::string& str)
   m_result += str;
 }
 
+/*!
+ * \fn void writeEscaped(const std::string& str)
+ * \brief writes a string to the output according to the escaping policy
+ */
+void Renderer::writeEscaped(const std::string& str)
+{
+  switch (m_escaping)
+  {
+  case HtmlEscaping:
+    simd::escape_html(str.data(), str.size(), m_result);
+    break;
+  case CustomEscaping:
+    m_result += m_escape_function(str);
+    break;
+  default:
+    m_result += str;
+    break;
+  }
+}
+
 void Renderer::record(const EvaluationException& ex)
 {
   m_errors.emplace_back(ex.offset_, ex.message_);
@@ -324,6 +556,18 @@ bool Renderer::evalCondition(const liquid::Value& val)
     (val.is<int>() ? val.as<int>() != 0 : !val.isNull());
 }
 
+/*!
+ * \fn bool evalBool(const std::shared_ptr<Object>& obj)
+ * \brief evaluates an object as a condition
+ *
+ * Returns the same result as \c{evalCondition(eval(obj))}, but comparisons
+ * and logical operators are evaluated without creating boolean values.
+ */
+bool Renderer::evalBool(const std::shared_ptr<Object>& obj)
+{
+  return obj->acceptCondition(*this);
+}
+
 liquid::Value Renderer::eval(const std::shared_ptr<Object>& obj)
 {
   return obj->accept(*this);
@@ -373,12 +617,21 @@ liquid::Value Renderer::eval_memberaccess(const objects::MemberAccess& ma)
   }
   else if (obj.isMap())
   {
-    return obj.property(ma.name);
+    const IValue& impl = *obj.impl();
+    int slot;
+
+    if (!ma.cache.lookup(impl, slot))
+    {
+      slot = impl.resolve(ma.name);
+      ma.cache.store(impl, slot);
+    }
+
+    return slot < 0 ? obj.property(ma.name) : impl.get(slot);
   }
   else if (obj.is<std::string>())
   {
     if (ma.name == "size" || ma.name == "length")
-      return static_cast<int>(obj.as<std::string>().size());
+      return static_cast<int>(utf8::Text(obj).length());
     else
       return nullptr;
   }
@@ -393,7 +646,12 @@ liquid::Value Renderer::eval_arrayaccess(const objects::ArrayAccess & aa)
   const liquid::Value obj = eval(aa.object);
   const liquid::Value index = eval(aa.index);
 
-  if (index.is<int>())
+  if (index.is<int>() && obj.isMap())
+  {
+    // objects built with index_by or group_by are indexed by stringified values
+    return obj.property(StringBackend::from_integer(index.as<int>()));
+  }
+  else if (index.is<int>())
   {
     if (!obj.isArray())
       throw EvaluationException{ "Value is not an array", context().currentTemplate(),  aa.object->offset() };
@@ -417,14 +675,13 @@ liquid::Value Renderer::eval_binop(const objects::BinOp & binop)
 {
   switch (binop.operation)
   {
-  case objects::BinOp::Or:
-    return evalCondition(eval(binop.lhs)) || evalCondition(eval(binop.rhs));
-  case objects::BinOp::And:
-    return evalCondition(eval(binop.lhs)) && evalCondition(eval(binop.rhs));
-  case objects::BinOp::Xor:
-    return evalCondition(eval(binop.lhs)) ^ evalCondition(eval(binop.rhs));
-  default:
+  case objects::BinOp::Add:
+  case objects::BinOp::Sub:
+  case objects::BinOp::Mul:
+  case objects::BinOp::Div:
     break;
+  default:
+    return visitCondition(binop);
   }
 
   const liquid::Value lhs = eval(binop.lhs);
@@ -432,18 +689,6 @@ liquid::Value Renderer::eval_binop(const objects::BinOp & binop)
 
   switch (binop.operation)
   {
-  case objects::BinOp::Equal:
-    return liquid::compare(lhs, rhs) == 0;
-  case objects::BinOp::Inequal:
-    return liquid::compare(lhs, rhs) != 0;
-  case objects::BinOp::Less:
-    return liquid::compare(lhs, rhs) < 0;
-  case objects::BinOp::Leq:
-    return liquid::compare(lhs, rhs) <= 0;
-  case objects::BinOp::Greater:
-    return liquid::compare(lhs, rhs) > 0;
-  case objects::BinOp::Geq:
-    return liquid::compare(lhs, rhs) >= 0;
   case objects::BinOp::Add:
     return value_add(lhs, rhs);
   case objects::BinOp::Sub:
@@ -462,14 +707,93 @@ liquid::Value Renderer::eval_binop(const objects::BinOp & binop)
 
 liquid::Value Renderer::eval_logicalnot(const objects::LogicalNot& op)
 {
-  return !evalCondition(eval(op.object));
+  return visitCondition(op);
+}
+
+namespace
+{
+
+/*
+ * A small buffer of values on the stack, used to pass the arguments
+ * of a filter without allocating.
+ */
+template<size_t N>
+class LocalValues
+{
+public:
+  LocalValues() = default;
+  LocalValues(const LocalValues&) = delete;
+
+  ~LocalValues()
+  {
+    for (size_t i(0); i < m_size; ++i)
+      data()[i].~Value();
+  }
+
+  template<typename F>
+  void append(F&& produce)
+  {
+    assert(m_size < N);
+    new (data() + m_size) liquid::Value(produce());
+    ++m_size;
+  }
+
+  FilterArguments view() { return FilterArguments(data(), m_size); }
+
+  LocalValues& operator=(const LocalValues&) = delete;
+
+private:
+  liquid::Value* data() { return reinterpret_cast<liquid::Value*>(&m_storage); }
+
+private:
+  typename std::aligned_storage<N * sizeof(liquid::Value), alignof(liquid::Value)>::type m_storage;
+  size_t m_size = 0;
+};
+
+} // namespace
+
+/*!
+ * \fn liquid::Value evalFilter(const objects::Pipe& pipe, const liquid::Value& object, FilterArguments args)
+ * \brief calls the filter a pipe was resolved to with evaluated values
+ */
+liquid::Value Renderer::evalFilter(const objects::Pipe& pipe, const liquid::Value& object, FilterArguments args)
+{
+  try
+  {
+    RenderCache* cache = pipe.filter->pure ? RenderCache::current() : nullptr;
+    return cache ? cache->call(pipe.filter, object, args) : (*pipe.filter)(object, args);
+  }
+  catch (EvaluationException& ex)
+  {
+    ex.offset_ = pipe.offset();
+    throw;
+  }
 }
 
 liquid::Value Renderer::eval_pipe(const objects::Pipe & pipe)
 {
+  const bool bound = is_bound(*this, pipe);
+
+  if (bound && pipe.fusion != objects::Pipe::NotFused)
+    return fusion::eval(*this, pipe);
+
   liquid::Value obj = eval(pipe.object);
+
+  if (bound && pipe.arguments.size() <= 4)
+  {
+    LocalValues<4> args;
+
+    for (const auto& a : pipe.arguments)
+      args.append([&]() { return eval(a); });
+
+    return evalFilter(pipe, obj, args.view());
+  }
+
   std::vector<liquid::Value> args = eval(pipe.arguments);
 
+  if (bound)
+    return evalFilter(pipe, obj, args);
+
   try
   {
     return applyFilter(pipe.filterName, obj, args);
@@ -571,6 +895,16 @@ liquid::Value Renderer::value_div(const liquid::Value& lhs, const liquid::Value&
   throw EvaluationException{ "operator / cannot proceed with given operands" };
 }
 
+/*!
+ * \fn virtual liquid::Value applyFilter(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args)
+ * \brief applies a filter that was not resolved when the template was parsed
+ *
+ * Filters found in the registry of a strict parse are called directly and 
+ * do not go through this function.
+ * Templates parsed without a registry resolve the builtin filters; they are 
+ * only dispatched through this function if \c{setVirtualFilterDispatch()} was 
+ * called, so that its reimplementations take precedence.
+ */
 liquid::Value Renderer::applyFilter(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args)
 {
   return BuiltinFilters::apply(name, object, args);
@@ -654,7 +988,7 @@ void Renderer::visitTag(const tags::If & tag)
   {
     const auto& b = tag.blocks.at(i);
 
-    if (evalCondition(eval(b.condition)))
+    if (evalBool(b.condition))
     {
       process(b.body);
       return;
@@ -662,6 +996,54 @@ void Renderer::visitTag(const tags::If & tag)
   }
 }
 
+void Renderer::visitTag(const tags::Case& tag)
+{
+  const liquid::Value val = eval(tag.object);
+  const size_t nwhens = tag.whens.size() - (tag.hasElse() ? 1 : 0);
+  bool matched = false;
+
+  // every matching block is rendered, in order
+  if (tag.hashed)
+  {
+    auto it = tag.dispatch.find(val);
+
+    if (it != tag.dispatch.end())
+    {
+      for (size_t i : it->second)
+      {
+        process(tag.whens.at(i).body);
+        matched = true;
+
+        if (context().flags())
+          return;
+      }
+    }
+  }
+  else
+  {
+    for (size_t i(0); i < nwhens; ++i)
+    {
+      const tags::Case::When& when = tag.whens.at(i);
+
+      for (const std::shared_ptr<Object>& candidate : when.values)
+      {
+        if (liquid::compare(val, eval(candidate)) == 0)
+        {
+          process(when.body);
+          matched = true;
+          break;
+        }
+      }
+
+      if (matched && context().flags())
+        return;
+    }
+  }
+
+  if (!matched && tag.hasElse())
+    process(tag.whens.back().body);
+}
+
 void Renderer::visitTag(const tags::Break & tag)
 {
   context().flags() |= Context::Break;
@@ -693,6 +1075,9 @@ void Renderer::visitTag(const tags::Include& tag)
 
   const Template& tmplt = it->second;
 
+  if (m_recorder)
+    m_recorder->recordPartial(tag.name, tmplt);
+
   Context::Scope include_scope{ context(), tmplt };
   include_scope["include"] = liquid::Map();
   include_scope["include"].toMap()["__"] = true;
@@ -747,6 +1132,77 @@ liquid::Value Renderer::visitObject(const objects::Pipe& pipe)
   return eval_pipe(pipe);
 }
 
+bool Renderer::visitCondition(const objects::Value& val)
+{
+  return evalCondition(val.value);
+}
+
+bool Renderer::visitCondition(const objects::BinOp& binop)
+{
+  switch (binop.operation)
+  {
+  case objects::BinOp::Or:
+    return evalBool(binop.lhs) || evalBool(binop.rhs);
+  case objects::BinOp::And:
+    return evalBool(binop.lhs) && evalBool(binop.rhs);
+  case objects::BinOp::Xor:
+    return evalBool(binop.lhs) != evalBool(binop.rhs);
+  case objects::BinOp::Add:
+  case objects::BinOp::Sub:
+  case objects::BinOp::Mul:
+  case objects::BinOp::Div:
+    return evalCondition(eval_binop(binop));
+  default:
+    break;
+  }
+
+  const liquid::Value lhs = eval(binop.lhs);
+  const liquid::Value rhs = eval(binop.rhs);
+  int c;
+
+  // the most frequent comparisons do not go through liquid::compare()
+  if (lhs.is<int>() && rhs.is<int>())
+  {
+    const int a = lhs.as<int>();
+    const int b = rhs.as<int>();
+    c = (a > b) - (a < b);
+  }
+  else if (lhs.is<std::string>() && rhs.is<std::string>())
+  {
+    c = lhs.as<std::string>().compare(rhs.as<std::string>());
+  }
+  else
+  {
+    c = liquid::compare(lhs, rhs);
+  }
+
+  switch (binop.operation)
+  {
+  case objects::BinOp::Equal:
+    return c == 0;
+  case objects::BinOp::Inequal:
+    return c != 0;
+  case objects::BinOp::Less:
+    return c < 0;
+  case objects::BinOp::Leq:
+    return c <= 0;
+  case objects::BinOp::Greater:
+    return c > 0;
+  case objects::BinOp::Geq:
+    return c >= 0;
+  default:
+    break;
+  }
+
+  assert(false);
+  return false;
+}
+
+bool Renderer::visitCondition(const objects::LogicalNot& op)
+{
+  return !evalBool(op.object);
+}
+
 /*!
  * \endclass
  */
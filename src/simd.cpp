@@ -0,0 +1,1492 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/simd_p.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if !defined(LIQUID_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define LIQUID_SIMD_SSE2
+#  include <emmintrin.h>
+#  if defined(__GNUC__) || defined(__clang__)
+#    define LIQUID_SIMD_AVX2
+#    define LIQUID_TARGET_AVX2 __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  elif defined(_MSC_VER)
+#    define LIQUID_SIMD_AVX2
+#    define LIQUID_TARGET_AVX2
+#    include <immintrin.h>
+#    include <intrin.h>
+#  endif
+#endif
+
+/*!
+ * \namespace liquid::simd
+ * \brief vectorized string primitives
+ *
+ * Every primitive has a scalar implementation and, on x86, SSE2 and AVX2 ones.
+ * The best implementation supported by the CPU is selected once at runtime;
+ * the library can be built with LIQUID_NO_SIMD to only use the scalar code.
+ */
+
+namespace liquid
+{
+
+namespace simd
+{
+
+namespace scalar
+{
+
+static void to_upper(const char* src, size_t n, char* dst)
+{
+  for (size_t i(0); i < n; ++i)
+    dst[i] = (src[i] >= 'a' && src[i] <= 'z') ? static_cast<char>(src[i] - 0x20) : src[i];
+}
+
+static void to_lower(const char* src, size_t n, char* dst)
+{
+  for (size_t i(0); i < n; ++i)
+    dst[i] = (src[i] >= 'A' && src[i] <= 'Z') ? static_cast<char>(src[i] + 0x20) : src[i];
+}
+
+static size_t skip_spaces(const char* str, size_t n)
+{
+  size_t i = 0;
+
+  while (i < n && is_space(str[i]))
+    ++i;
+
+  return i;
+}
+
+static size_t skip_spaces_backward(const char* str, size_t n)
+{
+  while (n > 0 && is_space(str[n - 1]))
+    --n;
+
+  return n;
+}
+
+static size_t find_char(const char* str, size_t n, char c)
+{
+  const void* p = std::memchr(str, c, n);
+  return p ? static_cast<size_t>(static_cast<const char*>(p) - str) : n;
+}
+
+static size_t find(const char* str, size_t n, const char* needle, size_t m)
+{
+  if (m == 0)
+    return 0;
+
+  if (m > n)
+    return n;
+
+  const char first = needle[0];
+
+  for (size_t i(0); i <= n - m; ++i)
+  {
+    if (str[i] == first && std::memcmp(str + i + 1, needle + 1, m - 1) == 0)
+      return i;
+  }
+
+  return n;
+}
+
+static inline bool is_html_special(char c)
+{
+  return c == '<' || c == '>' || c == '&' || c == '"' || c == '\'';
+}
+
+static size_t find_html_special(const char* str, size_t n)
+{
+  for (size_t i(0); i < n; ++i)
+  {
+    if (is_html_special(str[i]))
+      return i;
+  }
+
+  return n;
+}
+
+static inline bool is_json_special(char c)
+{
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+static size_t find_json_special(const char* str, size_t n)
+{
+  for (size_t i(0); i < n; ++i)
+  {
+    if (is_json_special(str[i]))
+      return i;
+  }
+
+  return n;
+}
+
+static inline bool is_url_unreserved(char c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+    || c == '*' || c == '-' || c == '.' || c == '_';
+}
+
+static size_t find_url_reserved(const char* str, size_t n)
+{
+  for (size_t i(0); i < n; ++i)
+  {
+    if (!is_url_unreserved(str[i]))
+      return i;
+  }
+
+  return n;
+}
+
+static size_t count_url_reserved(const char* str, size_t n)
+{
+  size_t count = 0;
+
+  for (size_t i(0); i < n; ++i)
+    count += !is_url_unreserved(str[i]) && str[i] != ' ';
+
+  return count;
+}
+
+static size_t find_url_escape(const char* str, size_t n)
+{
+  for (size_t i(0); i < n; ++i)
+  {
+    if (str[i] == '%' || str[i] == '+')
+      return i;
+  }
+
+  return n;
+}
+
+// returns the length of the UTF-8 sequence starting with the non-ASCII byte s[0],
+// or 0 if it is invalid (overlong encodings and surrogates are rejected)
+static size_t utf8_sequence(const unsigned char* s, size_t n)
+{
+  const unsigned char c = s[0];
+
+  if (c < 0xC2)
+    return 0;
+
+  if (c < 0xE0)
+    return n >= 2 && (s[1] & 0xC0) == 0x80 ? 2 : 0;
+
+  if (c < 0xF0)
+  {
+    if (n < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80)
+      return 0;
+    else if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] > 0x9F))
+      return 0;
+    else
+      return 3;
+  }
+
+  if (c < 0xF5)
+  {
+    if (n < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80)
+      return 0;
+    else if ((c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] > 0x8F))
+      return 0;
+    else
+      return 4;
+  }
+
+  return 0;
+}
+
+static bool utf8_validate(const char* str, size_t n)
+{
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(str);
+  size_t i = 0;
+
+  while (i < n)
+  {
+    if (s[i] < 0x80)
+    {
+      ++i;
+      continue;
+    }
+
+    const size_t len = utf8_sequence(s + i, n - i);
+
+    if (len == 0)
+      return false;
+
+    i += len;
+  }
+
+  return true;
+}
+
+static size_t utf8_count(const char* str, size_t n)
+{
+  size_t count = 0;
+
+  for (size_t i(0); i < n; ++i)
+    count += (static_cast<unsigned char>(str[i]) & 0xC0) != 0x80;
+
+  return count;
+}
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void base64_encode(const char* src, size_t n, char* dst)
+{
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+  size_t i = 0;
+
+  for (; i + 3 <= n; i += 3)
+  {
+    const uint32_t v = (uint32_t(s[i]) << 16) | (uint32_t(s[i + 1]) << 8) | s[i + 2];
+    *dst++ = base64_alphabet[v >> 18];
+    *dst++ = base64_alphabet[(v >> 12) & 0x3F];
+    *dst++ = base64_alphabet[(v >> 6) & 0x3F];
+    *dst++ = base64_alphabet[v & 0x3F];
+  }
+
+  if (i < n)
+  {
+    const uint32_t v = (uint32_t(s[i]) << 16) | (i + 1 < n ? uint32_t(s[i + 1]) << 8 : 0);
+    *dst++ = base64_alphabet[v >> 18];
+    *dst++ = base64_alphabet[(v >> 12) & 0x3F];
+    *dst++ = i + 1 < n ? base64_alphabet[(v >> 6) & 0x3F] : '=';
+    *dst++ = '=';
+  }
+}
+
+static int64_t sum_int(const int* values, size_t n)
+{
+  int64_t result = 0;
+
+  for (size_t i(0); i < n; ++i)
+    result += values[i];
+
+  return result;
+}
+
+static double sum_double(const double* values, size_t n)
+{
+  double result = 0;
+
+  for (size_t i(0); i < n; ++i)
+    result += values[i];
+
+  return result;
+}
+
+template<typename T>
+static void minmax(const T* values, size_t n, T* min, T* max)
+{
+  T lo = values[0];
+  T hi = values[0];
+
+  for (size_t i(1); i < n; ++i)
+  {
+    lo = values[i] < lo ? values[i] : lo;
+    hi = values[i] > hi ? values[i] : hi;
+  }
+
+  *min = lo;
+  *max = hi;
+}
+
+static void minmax_int(const int* values, size_t n, int* min, int* max)
+{
+  minmax(values, n, min, max);
+}
+
+static void minmax_double(const double* values, size_t n, double* min, double* max)
+{
+  minmax(values, n, min, max);
+}
+
+static const Kernels kernels = {
+  Scalar,
+  to_upper,
+  to_lower,
+  skip_spaces,
+  skip_spaces_backward,
+  find_char,
+  find,
+  find_html_special,
+  find_json_special,
+  find_url_reserved,
+  count_url_reserved,
+  find_url_escape,
+  utf8_validate,
+  utf8_count,
+  base64_encode,
+  sum_int,
+  sum_double,
+  minmax_int,
+  minmax_double,
+};
+
+} // namespace scalar
+
+#if defined(LIQUID_SIMD_SSE2) || defined(LIQUID_SIMD_AVX2)
+
+static inline int ctz32(uint32_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long r;
+  _BitScanForward(&r, x);
+  return static_cast<int>(r);
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+static inline int clz32(uint32_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long r;
+  _BitScanReverse(&r, x);
+  return 31 - static_cast<int>(r);
+#else
+  return __builtin_clz(x);
+#endif
+}
+
+static inline int popcount32(uint32_t x)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  return static_cast<int>((((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#else
+  return __builtin_popcount(x);
+#endif
+}
+
+#endif
+
+#if defined(LIQUID_SIMD_SSE2)
+
+namespace sse2
+{
+
+// bytes in [lo, lo + len] are selected with a single unsigned comparison
+static inline __m128i in_range(__m128i v, char lo, char len)
+{
+  const __m128i x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(len)), x);
+}
+
+static inline __m128i is_space(__m128i v)
+{
+  return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r' - '\t'));
+}
+
+template<char Lo, int Delta>
+static void change_case(const char* src, size_t n, char* dst)
+{
+  const __m128i bit = _mm_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i mask = in_range(v, Lo, 25);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(v, _mm_and_si128(mask, bit)));
+  }
+
+  if (Delta < 0)
+    scalar::to_upper(src + i, n - i, dst + i);
+  else
+    scalar::to_lower(src + i, n - i, dst + i);
+}
+
+static void to_upper(const char* src, size_t n, char* dst)
+{
+  change_case<'a', -0x20>(src, n, dst);
+}
+
+static void to_lower(const char* src, size_t n, char* dst)
+{
+  change_case<'A', 0x20>(src, n, dst);
+}
+
+static size_t skip_spaces(const char* str, size_t n)
+{
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(is_space(v))) ^ 0xFFFF;
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::skip_spaces(str + i, n - i);
+}
+
+static size_t skip_spaces_backward(const char* str, size_t n)
+{
+  while (n >= 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + n - 16));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(is_space(v))) ^ 0xFFFF;
+
+    if (mask)
+      return n - 16 + (32 - clz32(mask));
+
+    n -= 16;
+  }
+
+  return scalar::skip_spaces_backward(str, n);
+}
+
+static size_t find_char(const char* str, size_t n, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::find_char(str + i, n - i, c);
+}
+
+// compares the first and last characters of the needle at 16 positions at once,
+// candidates are then checked with memcmp()
+static size_t find(const char* str, size_t n, const char* needle, size_t m)
+{
+  if (m <= 1)
+    return m == 0 ? 0 : find_char(str, n, needle[0]);
+
+  if (m > n)
+    return n;
+
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+
+  for (; i + m - 1 + 16 <= n; i += 16)
+  {
+    const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+
+    while (mask)
+    {
+      const size_t pos = i + ctz32(mask);
+
+      if (std::memcmp(str + pos + 1, needle + 1, m - 2) == 0)
+        return pos;
+
+      mask &= mask - 1;
+    }
+  }
+
+  return i + scalar::find(str + i, n - i, needle, m);
+}
+
+static size_t find_html_special(const char* str, size_t n)
+{
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i quot = _mm_set1_epi8('"');
+  const __m128i apos = _mm_set1_epi8('\'');
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt));
+    eq = _mm_or_si128(eq, _mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, quot)));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, apos));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::find_html_special(str + i, n - i);
+}
+
+static size_t find_json_special(const char* str, size_t n)
+{
+  const __m128i quot = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, quot), _mm_cmpeq_epi8(v, backslash));
+    eq = _mm_or_si128(eq, _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::find_json_special(str + i, n - i);
+}
+
+static inline __m128i is_url_unreserved(__m128i v)
+{
+  __m128i r = _mm_or_si128(in_range(v, '0', 9), in_range(v, 'A', 25));
+  r = _mm_or_si128(r, in_range(v, 'a', 25));
+  r = _mm_or_si128(r, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')), _mm_cmpeq_epi8(v, _mm_set1_epi8('-'))));
+  return _mm_or_si128(r, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+}
+
+static size_t find_url_reserved(const char* str, size_t n)
+{
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(is_url_unreserved(v))) & 0xFFFF;
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::find_url_reserved(str + i, n - i);
+}
+
+static size_t count_url_reserved(const char* str, size_t n)
+{
+  const __m128i space = _mm_set1_epi8(' ');
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const __m128i kept = _mm_or_si128(is_url_unreserved(v), _mm_cmpeq_epi8(v, space));
+    count += popcount32(~static_cast<uint32_t>(_mm_movemask_epi8(kept)) & 0xFFFF);
+  }
+
+  return count + scalar::count_url_reserved(str + i, n - i);
+}
+
+static size_t find_url_escape(const char* str, size_t n)
+{
+  const __m128i percent = _mm_set1_epi8('%');
+  const __m128i plus = _mm_set1_epi8('+');
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, plus))));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + scalar::find_url_escape(str + i, n - i);
+}
+
+// ASCII blocks are skipped, the other sequences are checked one at a time
+static bool utf8_validate(const char* str, size_t n)
+{
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(str);
+  size_t i = 0;
+
+  while (i + 16 <= n)
+  {
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i))));
+
+    if (!mask)
+    {
+      i += 16;
+      continue;
+    }
+
+    i += ctz32(mask);
+
+    while (i < n && s[i] >= 0x80)
+    {
+      const size_t len = scalar::utf8_sequence(s + i, n - i);
+
+      if (len == 0)
+        return false;
+
+      i += len;
+    }
+  }
+
+  return scalar::utf8_validate(str + i, n - i);
+}
+
+static size_t utf8_count(const char* str, size_t n)
+{
+  // continuation bytes are the signed bytes in [-128, -65]
+  const __m128i limit = _mm_set1_epi8(-65);
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    count += popcount32(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, limit))));
+  }
+
+  return count + scalar::utf8_count(str + i, n - i);
+}
+
+// ints are sign-extended to 64 bits before being added
+static int64_t sum_int(const int* values, size_t n)
+{
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    const __m128i sign = _mm_srai_epi32(v, 31);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+  }
+
+  int64_t lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  return lanes[0] + lanes[1] + scalar::sum_int(values + i, n - i);
+}
+
+static double sum_double(const double* values, size_t n)
+{
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+  }
+
+  acc0 = _mm_add_pd(acc0, acc1);
+  acc0 = _mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0));
+  return _mm_cvtsd_f64(acc0) + scalar::sum_double(values + i, n - i);
+}
+
+// SSE2 has no min/max for 32-bit ints
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void minmax_int(const int* values, size_t n, int* min, int* max)
+{
+  if (n < 8)
+    return scalar::minmax_int(values, n, min, max);
+
+  __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+  __m128i hi = lo;
+  size_t i = 4;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    lo = select(_mm_cmplt_epi32(v, lo), v, lo);
+    hi = select(_mm_cmpgt_epi32(v, hi), v, hi);
+  }
+
+  int lanes[8];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), lo);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 4), hi);
+
+  scalar::minmax_int(lanes, 4, min, max);
+  int unused;
+  scalar::minmax_int(lanes + 4, 4, &unused, max);
+
+  for (; i < n; ++i)
+  {
+    *min = values[i] < *min ? values[i] : *min;
+    *max = values[i] > *max ? values[i] : *max;
+  }
+}
+
+static void minmax_double(const double* values, size_t n, double* min, double* max)
+{
+  if (n < 4)
+    return scalar::minmax_double(values, n, min, max);
+
+  __m128d lo = _mm_loadu_pd(values);
+  __m128d hi = lo;
+  size_t i = 2;
+
+  for (; i + 2 <= n; i += 2)
+  {
+    const __m128d v = _mm_loadu_pd(values + i);
+    lo = _mm_min_pd(v, lo);
+    hi = _mm_max_pd(v, hi);
+  }
+
+  double lanes[4];
+  _mm_storeu_pd(lanes, lo);
+  _mm_storeu_pd(lanes + 2, hi);
+
+  *min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+  *max = lanes[2] > lanes[3] ? lanes[2] : lanes[3];
+
+  for (; i < n; ++i)
+  {
+    *min = values[i] < *min ? values[i] : *min;
+    *max = values[i] > *max ? values[i] : *max;
+  }
+}
+
+static const Kernels kernels = {
+  SSE2,
+  to_upper,
+  to_lower,
+  skip_spaces,
+  skip_spaces_backward,
+  find_char,
+  find,
+  find_html_special,
+  find_json_special,
+  find_url_reserved,
+  count_url_reserved,
+  find_url_escape,
+  utf8_validate,
+  utf8_count,
+  scalar::base64_encode, // needs a byte shuffle
+  sum_int,
+  sum_double,
+  minmax_int,
+  minmax_double,
+};
+
+} // namespace sse2
+
+#endif // defined(LIQUID_SIMD_SSE2)
+
+#if defined(LIQUID_SIMD_AVX2)
+
+namespace avx2
+{
+
+LIQUID_TARGET_AVX2 static inline __m256i in_range(__m256i v, char lo, char len)
+{
+  const __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(len)), x);
+}
+
+LIQUID_TARGET_AVX2 static inline __m256i is_space(__m256i v)
+{
+  return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), in_range(v, '\t', '\r' - '\t'));
+}
+
+LIQUID_TARGET_AVX2 static void change_case(const char* src, size_t n, char* dst, char lo)
+{
+  const __m256i bit = _mm256_set1_epi8(0x20);
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i mask = in_range(v, lo, 25);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(v, _mm256_and_si256(mask, bit)));
+  }
+
+  if (lo == 'a')
+    sse2::to_upper(src + i, n - i, dst + i);
+  else
+    sse2::to_lower(src + i, n - i, dst + i);
+}
+
+static void to_upper(const char* src, size_t n, char* dst)
+{
+  change_case(src, n, dst, 'a');
+}
+
+static void to_lower(const char* src, size_t n, char* dst)
+{
+  change_case(src, n, dst, 'A');
+}
+
+LIQUID_TARGET_AVX2 static size_t skip_spaces(const char* str, size_t n)
+{
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(is_space(v)));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::skip_spaces(str + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static size_t skip_spaces_backward(const char* str, size_t n)
+{
+  while (n >= 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + n - 32));
+    const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(is_space(v)));
+
+    if (mask)
+      return n - 32 + (32 - clz32(mask));
+
+    n -= 32;
+  }
+
+  return sse2::skip_spaces_backward(str, n);
+}
+
+LIQUID_TARGET_AVX2 static size_t find_char(const char* str, size_t n, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::find_char(str + i, n - i, c);
+}
+
+LIQUID_TARGET_AVX2 static size_t find(const char* str, size_t n, const char* needle, size_t m)
+{
+  if (m <= 1)
+    return m == 0 ? 0 : find_char(str, n, needle[0]);
+
+  if (m > n)
+    return n;
+
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+  size_t i = 0;
+
+  for (; i + m - 1 + 32 <= n; i += 32)
+  {
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i + m - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+
+    while (mask)
+    {
+      const size_t pos = i + ctz32(mask);
+
+      if (std::memcmp(str + pos + 1, needle + 1, m - 2) == 0)
+        return pos;
+
+      mask &= mask - 1;
+    }
+  }
+
+  return i + sse2::find(str + i, n - i, needle, m);
+}
+
+LIQUID_TARGET_AVX2 static size_t find_html_special(const char* str, size_t n)
+{
+  const __m256i lt = _mm256_set1_epi8('<');
+  const __m256i gt = _mm256_set1_epi8('>');
+  const __m256i amp = _mm256_set1_epi8('&');
+  const __m256i quot = _mm256_set1_epi8('"');
+  const __m256i apos = _mm256_set1_epi8('\'');
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt));
+    eq = _mm256_or_si256(eq, _mm256_or_si256(_mm256_cmpeq_epi8(v, amp), _mm256_cmpeq_epi8(v, quot)));
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(v, apos));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::find_html_special(str + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static size_t find_json_special(const char* str, size_t n)
+{
+  const __m256i quot = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i control = _mm256_set1_epi8(0x1F);
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(v, quot), _mm256_cmpeq_epi8(v, backslash));
+    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::find_json_special(str + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static inline __m256i is_url_unreserved(__m256i v)
+{
+  __m256i r = _mm256_or_si256(in_range(v, '0', 9), in_range(v, 'A', 25));
+  r = _mm256_or_si256(r, in_range(v, 'a', 25));
+  r = _mm256_or_si256(r, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-'))));
+  return _mm256_or_si256(r, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))));
+}
+
+LIQUID_TARGET_AVX2 static size_t find_url_reserved(const char* str, size_t n)
+{
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(is_url_unreserved(v)));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::find_url_reserved(str + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static size_t count_url_reserved(const char* str, size_t n)
+{
+  const __m256i space = _mm256_set1_epi8(' ');
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const __m256i kept = _mm256_or_si256(is_url_unreserved(v), _mm256_cmpeq_epi8(v, space));
+    count += popcount32(~static_cast<uint32_t>(_mm256_movemask_epi8(kept)));
+  }
+
+  return count + sse2::count_url_reserved(str + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static size_t find_url_escape(const char* str, size_t n)
+{
+  const __m256i percent = _mm256_set1_epi8('%');
+  const __m256i plus = _mm256_set1_epi8('+');
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, percent), _mm256_cmpeq_epi8(v, plus))));
+
+    if (mask)
+      return i + ctz32(mask);
+  }
+
+  return i + sse2::find_url_escape(str + i, n - i);
+}
+
+template<int N>
+LIQUID_TARGET_AVX2 static inline __m256i prev_bytes(__m256i input, __m256i previous)
+{
+  return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+LIQUID_TARGET_AVX2 static inline __m256i high_nibbles(__m256i v)
+{
+  return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+// Validates 32 bytes at a time with the lookup algorithm of Keiser & Lemire
+// ("Validating UTF-8 In Less Than One Instruction Per Byte"): three nibble
+// lookups classify each pair of consecutive bytes, and the expected
+// continuation bytes of 3 and 4 byte sequences are checked separately.
+// ASCII blocks only need to check that no sequence was left incomplete.
+LIQUID_TARGET_AVX2 static bool utf8_validate(const char* str, size_t n)
+{
+  enum {
+    TooShort = 1 << 0,      // 11______ 0_______ or 11______ 11______
+    TooLong = 1 << 1,       // 0_______ 10______
+    Overlong3 = 1 << 2,     // 11100000 100_____
+    TooLarge = 1 << 3,      // 11110100 1001____ and above
+    Surrogate = 1 << 4,     // 11101101 101_____
+    Overlong2 = 1 << 5,     // 1100000_ 10______
+    TooLarge1000 = 1 << 6,  // 11110101 1000____ and above
+    Overlong4 = 1 << 6,     // 11110000 1000____
+    TwoConts = 1 << 7,      // 10______ 10______
+    Carry = TooShort | TooLong | TwoConts,
+  };
+
+  const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+    TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,
+    TwoConts, TwoConts, TwoConts, TwoConts,
+    TooShort | Overlong2,
+    TooShort,
+    TooShort | Overlong3 | Surrogate,
+    TooShort | TooLarge | TooLarge1000 | Overlong4));
+
+  const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+    Carry | Overlong3 | Overlong2 | Overlong4,
+    Carry | Overlong2,
+    Carry,
+    Carry,
+    Carry | TooLarge,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000 | Surrogate,
+    Carry | TooLarge | TooLarge1000,
+    Carry | TooLarge | TooLarge1000));
+
+  const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+    TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,
+    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,
+    TooShort, TooShort, TooShort, TooShort));
+
+  // a lead byte in one of the last 3 positions starts a sequence that continues in the next block
+  const __m256i incomplete_limit = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1);
+
+  const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+  __m256i error = _mm256_setzero_si256();
+  __m256i previous = _mm256_setzero_si256();
+  __m256i incomplete = _mm256_setzero_si256();
+  char tail[32];
+
+  for (size_t i(0); i < n; i += 32)
+  {
+    __m256i input;
+
+    if (i + 32 <= n)
+    {
+      input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    }
+    else
+    {
+      // the last block is padded with ASCII zeros
+      std::memset(tail, 0, sizeof(tail));
+      std::memcpy(tail, str + i, n - i);
+      input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail));
+    }
+
+    if (_mm256_movemask_epi8(input) == 0)
+    {
+      error = _mm256_or_si256(error, incomplete);
+    }
+    else
+    {
+      const __m256i prev1 = prev_bytes<1>(input, previous);
+      __m256i special = _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, high_nibbles(prev1)),
+        _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, low_nibble)));
+      special = _mm256_and_si256(special, _mm256_shuffle_epi8(byte_2_high, high_nibbles(input)));
+
+      // bytes that follow a 3 or 4 byte lead by two (resp. three) positions must be continuations
+      const __m256i third = _mm256_subs_epu8(prev_bytes<2>(input, previous), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+      const __m256i fourth = _mm256_subs_epu8(prev_bytes<3>(input, previous), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+      const __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+      error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special));
+      incomplete = _mm256_subs_epu8(input, incomplete_limit);
+    }
+
+    previous = input;
+  }
+
+  error = _mm256_or_si256(error, incomplete);
+  return _mm256_testz_si256(error, error) != 0;
+}
+
+LIQUID_TARGET_AVX2 static size_t utf8_count(const char* str, size_t n)
+{
+  const __m256i limit = _mm256_set1_epi8(-65);
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    count += popcount32(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, limit))));
+  }
+
+  return count + sse2::utf8_count(str + i, n - i);
+}
+
+// Each 128-bit lane converts 12 bytes into 16 characters: the bytes are
+// spread over 32-bit words, the four 6-bit indices of each word are isolated
+// with two multiplications and mapped to the alphabet by adding an offset
+// that depends on the range of the index (see Muła & Lemire, "Faster Base64
+// Encoding and Decoding using AVX2 Instructions").
+LIQUID_TARGET_AVX2 static void base64_encode(const char* src, size_t n, char* dst)
+{
+  const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                          1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  size_t i = 0;
+
+  // the second lane reads 16 bytes at offset 12
+  for (; i + 28 <= n; i += 24, dst += 32)
+  {
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    in = _mm256_shuffle_epi8(in, spread);
+
+    const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(t0, t1);
+
+    // 0..25 -> 13, 26..51 -> 0, 52..63 -> 1..12
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+
+    const __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), chars);
+  }
+
+  scalar::base64_encode(src + i, n - i, dst);
+}
+
+LIQUID_TARGET_AVX2 static int64_t sum_int(const int* values, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i))));
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 4))));
+  }
+
+  int64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sse2::sum_int(values + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static double sum_double(const double* values, size_t n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(values + i + 4));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sse2::sum_double(values + i, n - i);
+}
+
+LIQUID_TARGET_AVX2 static void minmax_int(const int* values, size_t n, int* min, int* max)
+{
+  if (n < 16)
+    return sse2::minmax_int(values, n, min, max);
+
+  __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+  __m256i hi = lo;
+  size_t i = 8;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    lo = _mm256_min_epi32(v, lo);
+    hi = _mm256_max_epi32(v, hi);
+  }
+
+  int lanes[16];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), lo);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 8), hi);
+
+  int unused;
+  scalar::minmax_int(lanes, 8, min, &unused);
+  scalar::minmax_int(lanes + 8, 8, &unused, max);
+
+  for (; i < n; ++i)
+  {
+    *min = values[i] < *min ? values[i] : *min;
+    *max = values[i] > *max ? values[i] : *max;
+  }
+}
+
+LIQUID_TARGET_AVX2 static void minmax_double(const double* values, size_t n, double* min, double* max)
+{
+  if (n < 8)
+    return sse2::minmax_double(values, n, min, max);
+
+  __m256d lo = _mm256_loadu_pd(values);
+  __m256d hi = lo;
+  size_t i = 4;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m256d v = _mm256_loadu_pd(values + i);
+    lo = _mm256_min_pd(v, lo);
+    hi = _mm256_max_pd(v, hi);
+  }
+
+  double lanes[8];
+  _mm256_storeu_pd(lanes, lo);
+  _mm256_storeu_pd(lanes + 4, hi);
+
+  double unused;
+  scalar::minmax_double(lanes, 4, min, &unused);
+  scalar::minmax_double(lanes + 4, 4, &unused, max);
+
+  for (; i < n; ++i)
+  {
+    *min = values[i] < *min ? values[i] : *min;
+    *max = values[i] > *max ? values[i] : *max;
+  }
+}
+
+static bool supported()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+
+  if (info[0] < 7)
+    return false;
+
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const Kernels kernels = {
+  AVX2,
+  to_upper,
+  to_lower,
+  skip_spaces,
+  skip_spaces_backward,
+  find_char,
+  find,
+  find_html_special,
+  find_json_special,
+  find_url_reserved,
+  count_url_reserved,
+  find_url_escape,
+  utf8_validate,
+  utf8_count,
+  base64_encode,
+  sum_int,
+  sum_double,
+  minmax_int,
+  minmax_double,
+};
+
+} // namespace avx2
+
+#endif // defined(LIQUID_SIMD_AVX2)
+
+/*!
+ * \fn const Kernels* kernels(Level level)
+ * \brief returns the implementation of the primitives for a given instruction set
+ *
+ * Returns nullptr if the instruction set is not supported by the CPU
+ * or if the library was built without it.
+ */
+const Kernels* kernels(Level level)
+{
+  switch (level)
+  {
+  case Scalar:
+    return &scalar::kernels;
+#if defined(LIQUID_SIMD_SSE2)
+  case SSE2:
+    return &sse2::kernels;
+#endif
+#if defined(LIQUID_SIMD_AVX2)
+  case AVX2:
+  {
+    static const bool avx2_supported = avx2::supported();
+    return avx2_supported ? &avx2::kernels : nullptr;
+  }
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+static const Kernels& select_kernels()
+{
+  for (Level l : { AVX2, SSE2 })
+  {
+    if (const Kernels* k = kernels(l))
+      return *k;
+  }
+
+  return scalar::kernels;
+}
+
+/*!
+ * \fn const Kernels& kernels()
+ * \brief returns the best implementation supported by the CPU
+ */
+const Kernels& kernels()
+{
+  static const Kernels& result = select_kernels();
+  return result;
+}
+
+/*!
+ * \fn const char* levelName(Level level)
+ * \brief returns the name of an instruction set
+ */
+const char* levelName(Level level)
+{
+  switch (level)
+  {
+  case SSE2:
+    return "sse2";
+  case AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+static const char* html_entity(char c)
+{
+  switch (c)
+  {
+  case '<':
+    return "&lt;";
+  case '>':
+    return "&gt;";
+  case '&':
+    return "&amp;";
+  case '"':
+    return "&quot;";
+  default:
+    return "&#39;";
+  }
+}
+
+/*!
+ * \fn void escape_html(const char* str, size_t n, std::string& out)
+ * \brief appends a string to \a out, replacing the characters <>&"' by HTML entities
+ *
+ * Runs of characters that need no escaping are copied at once.
+ */
+void escape_html(const char* str, size_t n, std::string& out)
+{
+  const Kernels& k = kernels();
+  size_t pos = 0;
+
+  while (pos < n)
+  {
+    const size_t next = pos + k.find_html_special(str + pos, n - pos);
+    out.append(str + pos, next - pos);
+
+    if (next == n)
+      break;
+
+    out.append(html_entity(str[next]));
+    pos = next + 1;
+  }
+}
+
+// returns true if the '&' at str[0] starts an entity: &name; or &#digits;
+static bool starts_entity(const char* str, size_t n)
+{
+  size_t i = 1;
+
+  if (i < n && str[i] == '#')
+  {
+    ++i;
+
+    while (i < n && str[i] >= '0' && str[i] <= '9')
+      ++i;
+
+    return i > 2 && i < n && str[i] == ';';
+  }
+
+  while (i < n && ((str[i] >= 'a' && str[i] <= 'z') || (str[i] >= 'A' && str[i] <= 'Z')))
+    ++i;
+
+  return i > 1 && i < n && str[i] == ';';
+}
+
+/*!
+ * \fn void escape_html_once(const char* str, size_t n, std::string& out)
+ * \brief same as escape_html() but leaves the existing entities unchanged
+ *
+ * The size of the result is computed in a first pass so that \a out grows
+ * only once.
+ */
+void escape_html_once(const char* str, size_t n, std::string& out)
+{
+  const Kernels& k = kernels();
+  size_t size = n;
+
+  for (size_t pos = k.find_html_special(str, n); pos < n; pos += 1 + k.find_html_special(str + pos + 1, n - pos - 1))
+  {
+    if (str[pos] != '&' || !starts_entity(str + pos, n - pos))
+      size += std::strlen(html_entity(str[pos])) - 1;
+  }
+
+  out.reserve(out.size() + size);
+  size_t pos = 0;
+
+  while (pos < n)
+  {
+    const size_t next = pos + k.find_html_special(str + pos, n - pos);
+    out.append(str + pos, next - pos);
+
+    if (next == n)
+      break;
+
+    if (str[next] == '&' && starts_entity(str + next, n - next))
+      out.push_back('&');
+    else
+      out.append(html_entity(str[next]));
+
+    pos = next + 1;
+  }
+}
+
+} // namespace simd
+
+} // namespace liquid
@@ -0,0 +1,535 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/filters.h"
+
+#include "liquid/errors.h"
+#include "liquid/renderer.h"
+#include "liquid/simd_p.h"
+#include "liquid/utf8_p.h"
+
+#include <algorithm>
+
+namespace liquid
+{
+
+/*!
+ * \class StringFilters
+ * \brief implements the built-in string filters
+ *
+ * Case mapping, trimming and substring search use the vectorized
+ * primitives of \c{simd::kernels()}; the result of each filter is allocated
+ * once, with its final size.
+ */
+
+/*!
+ * \fn static std::string upcase(const std::string& str)
+ * \brief converts the ASCII letters of a string to upper case
+ */
+std::string StringFilters::upcase(const std::string& str)
+{
+  std::string result(str.size(), '\0');
+  simd::kernels().to_upper(str.data(), str.size(), &result[0]);
+  return result;
+}
+
+/*!
+ * \fn static std::string downcase(const std::string& str)
+ * \brief converts the ASCII letters of a string to lower case
+ */
+std::string StringFilters::downcase(const std::string& str)
+{
+  std::string result(str.size(), '\0');
+  simd::kernels().to_lower(str.data(), str.size(), &result[0]);
+  return result;
+}
+
+/*!
+ * \fn static std::string capitalize(const std::string& str)
+ * \brief converts the first character of a string to upper case and the others to lower case
+ */
+std::string StringFilters::capitalize(const std::string& str)
+{
+  if (str.empty())
+    return str;
+
+  std::string result(str.size(), '\0');
+  const simd::Kernels& k = simd::kernels();
+  k.to_upper(str.data(), 1, &result[0]);
+  k.to_lower(str.data() + 1, str.size() - 1, &result[1]);
+  return result;
+}
+
+/*!
+ * \fn static std::string strip(const std::string& str)
+ * \brief removes the whitespaces at both ends of a string
+ */
+std::string StringFilters::strip(const std::string& str)
+{
+  const simd::Kernels& k = simd::kernels();
+  const size_t begin = k.skip_spaces(str.data(), str.size());
+  const size_t end = k.skip_spaces_backward(str.data() + begin, str.size() - begin);
+  return str.substr(begin, end);
+}
+
+/*!
+ * \fn static std::string lstrip(const std::string& str)
+ * \brief removes the whitespaces at the beginning of a string
+ */
+std::string StringFilters::lstrip(const std::string& str)
+{
+  return str.substr(simd::kernels().skip_spaces(str.data(), str.size()));
+}
+
+/*!
+ * \fn static std::string rstrip(const std::string& str)
+ * \brief removes the whitespaces at the end of a string
+ */
+std::string StringFilters::rstrip(const std::string& str)
+{
+  return str.substr(0, simd::kernels().skip_spaces_backward(str.data(), str.size()));
+}
+
+/*!
+ * \fn static std::string replace(const std::string& str, const std::string& search, const std::string& replacement)
+ * \brief replaces every occurrence of a substring
+ *
+ * The occurrences are counted first so that the result is allocated only once.
+ */
+std::string StringFilters::replace(const std::string& str, const std::string& search, const std::string& replacement)
+{
+  if (search.empty())
+    return str;
+
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+
+  size_t count = 0;
+
+  for (size_t pos = k.find(data, n, search.data(), search.size()); pos < n; )
+  {
+    ++count;
+    pos += search.size();
+    pos += k.find(data + pos, n - pos, search.data(), search.size());
+  }
+
+  if (count == 0)
+    return str;
+
+  std::string result;
+  result.reserve(n - count * search.size() + count * replacement.size());
+
+  size_t start = 0;
+
+  while (start < n)
+  {
+    const size_t pos = start + k.find(data + start, n - start, search.data(), search.size());
+    result.append(data + start, pos - start);
+
+    if (pos == n)
+      break;
+
+    result.append(replacement);
+    start = pos + search.size();
+  }
+
+  return result;
+}
+
+/*!
+ * \fn static std::string remove(const std::string& str, const std::string& search)
+ * \brief removes every occurrence of a substring
+ */
+std::string StringFilters::remove(const std::string& str, const std::string& search)
+{
+  return replace(str, search, std::string());
+}
+
+/*!
+ * \fn static liquid::Array split(const std::string& str, const std::string& sep)
+ * \brief splits a string into an array of substrings
+ *
+ * If the separator is empty, the string is split into single characters.
+ * Trailing empty substrings are dropped.
+ */
+liquid::Array StringFilters::split(const std::string& str, const std::string& sep)
+{
+  std::vector<liquid::Value> parts;
+
+  if (sep.empty())
+  {
+    parts.reserve(str.size());
+
+    for (char c : str)
+      parts.push_back(std::string(1, c));
+
+    return liquid::Array(std::move(parts));
+  }
+
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+  size_t start = 0;
+
+  while (start <= n)
+  {
+    const size_t pos = start + k.find(data + start, n - start, sep.data(), sep.size());
+    parts.push_back(std::string(data + start, pos - start));
+    start = pos + sep.size();
+  }
+
+  while (!parts.empty() && parts.back().as<std::string>().empty())
+    parts.pop_back();
+
+  return liquid::Array(std::move(parts));
+}
+
+/*!
+ * \fn static std::string truncate(const std::string& str, int length, const std::string& ellipsis)
+ * \brief shortens a string to a given number of characters
+ *
+ * The ellipsis is counted in \a length. Characters are UTF-8 code points 
+ * (or bytes if the string is not valid UTF-8).
+ */
+std::string StringFilters::truncate(const std::string& str, int length, const std::string& ellipsis)
+{
+  return utf8::Text(str.data(), str.size()).truncate(length, ellipsis);
+}
+
+/*!
+ * \fn static std::string truncatewords(const std::string& str, int words, const std::string& ellipsis)
+ * \brief shortens a string to a given number of words
+ *
+ * Words of the result are separated by a single space.
+ */
+std::string StringFilters::truncatewords(const std::string& str, int words, const std::string& ellipsis)
+{
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+  const size_t max_words = words > 1 ? static_cast<size_t>(words) : 1;
+
+  std::vector<std::pair<size_t, size_t>> ranges;
+  size_t pos = k.skip_spaces(data, n);
+
+  while (pos < n && ranges.size() <= max_words)
+  {
+    size_t end = pos;
+
+    while (end < n && !simd::is_space(data[end]))
+      ++end;
+
+    ranges.emplace_back(pos, end);
+    pos = end + k.skip_spaces(data + end, n - end);
+  }
+
+  if (ranges.size() <= max_words)
+    return str;
+
+  size_t size = ellipsis.size() + max_words - 1;
+
+  for (size_t i(0); i < max_words; ++i)
+    size += ranges[i].second - ranges[i].first;
+
+  std::string result;
+  result.reserve(size);
+
+  for (size_t i(0); i < max_words; ++i)
+  {
+    if (i > 0)
+      result.push_back(' ');
+
+    result.append(data + ranges[i].first, ranges[i].second - ranges[i].first);
+  }
+
+  result.append(ellipsis);
+  return result;
+}
+
+/*!
+ * \fn static std::string slice(const std::string& str, int start, int length)
+ * \brief returns a substring
+ *
+ * A negative \a start is counted from the end of the string.
+ * \a start and \a length are counted in UTF-8 code points.
+ */
+std::string StringFilters::slice(const std::string& str, int start, int length)
+{
+  return utf8::Text(str.data(), str.size()).slice(start, length);
+}
+
+/*!
+ * \fn static std::string prepend(const liquid::Value& val, const liquid::Value& str)
+ * \brief adds a string at the beginning of a value
+ */
+std::string StringFilters::prepend(const liquid::Value& val, const liquid::Value& str)
+{
+  return Renderer::defaultStringify(str) + Renderer::defaultStringify(val);
+}
+
+/*!
+ * \fn static std::string append(const liquid::Value& val, const liquid::Value& str)
+ * \brief adds a string at the end of a value
+ */
+std::string StringFilters::append(const liquid::Value& val, const liquid::Value& str)
+{
+  std::string result = Renderer::defaultStringify(val);
+  result += Renderer::defaultStringify(str);
+  return result;
+}
+
+/*!
+ * \fn static int size(const liquid::Value& val)
+ * \brief returns the length of a string or an array, or the number of properties of an object
+ *
+ * The length of a string is its number of UTF-8 code points.
+ */
+int StringFilters::size(const liquid::Value& val)
+{
+  if (val.is<std::string>())
+    return static_cast<int>(utf8::Text(val).length());
+  else if (val.isArray())
+    return static_cast<int>(val.length());
+  else if (val.isMap())
+    return static_cast<int>(val.propertyNames().size());
+  else
+    return 0;
+}
+
+/*!
+ * \fn static std::string newline_to_br(const std::string& str)
+ * \brief inserts an HTML line break before each newline
+ */
+std::string StringFilters::newline_to_br(const std::string& str)
+{
+  return replace(str, "\n", "<br />\n");
+}
+
+/*!
+ * \fn static std::string escape(const std::string& str)
+ * \brief replaces the characters <>&"' by HTML entities
+ */
+std::string StringFilters::escape(const std::string& str)
+{
+  std::string result;
+  simd::escape_html(str.data(), str.size(), result);
+  return result;
+}
+
+/*!
+ * \fn static std::string escape_once(const std::string& str)
+ * \brief same as escape() but leaves the existing HTML entities unchanged
+ */
+std::string StringFilters::escape_once(const std::string& str)
+{
+  std::string result;
+  simd::escape_html_once(str.data(), str.size(), result);
+  return result;
+}
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  else if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  else if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  else
+    return -1;
+}
+
+/*!
+ * \fn static std::string url_encode(const std::string& str)
+ * \brief percent-encodes a string for use in a URL
+ *
+ * ASCII letters, digits and the characters *-._ are kept, spaces are
+ * converted to '+' and every other byte is encoded as %XX.
+ */
+std::string StringFilters::url_encode(const std::string& str)
+{
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+
+  std::string result(n + 2 * k.count_url_reserved(data, n), '\0');
+  char* out = &result[0];
+  size_t pos = 0;
+
+  while (pos < n)
+  {
+    const size_t next = pos + k.find_url_reserved(data + pos, n - pos);
+    std::copy(data + pos, data + next, out);
+    out += next - pos;
+
+    if (next == n)
+      break;
+
+    const unsigned char c = static_cast<unsigned char>(data[next]);
+
+    if (c == ' ')
+    {
+      *out++ = '+';
+    }
+    else
+    {
+      *out++ = '%';
+      *out++ = hex_digits[c >> 4];
+      *out++ = hex_digits[c & 0xF];
+    }
+
+    pos = next + 1;
+  }
+
+  return result;
+}
+
+/*!
+ * \fn static std::string url_decode(const std::string& str)
+ * \brief decodes a percent-encoded string
+ *
+ * '+' is converted to a space; a '%' that is not followed by two hexadecimal
+ * digits is kept as is.
+ */
+std::string StringFilters::url_decode(const std::string& str)
+{
+  const simd::Kernels& k = simd::kernels();
+  const char* data = str.data();
+  const size_t n = str.size();
+
+  std::string result;
+  result.reserve(n);
+  size_t pos = 0;
+
+  while (pos < n)
+  {
+    const size_t next = pos + k.find_url_escape(data + pos, n - pos);
+    result.append(data + pos, next - pos);
+
+    if (next == n)
+      break;
+
+    pos = next + 1;
+
+    if (data[next] == '+')
+    {
+      result.push_back(' ');
+    }
+    else if (next + 2 < n && hex_value(data[next + 1]) >= 0 && hex_value(data[next + 2]) >= 0)
+    {
+      result.push_back(static_cast<char>(hex_value(data[next + 1]) * 16 + hex_value(data[next + 2])));
+      pos += 2;
+    }
+    else
+    {
+      result.push_back('%');
+    }
+  }
+
+  return result;
+}
+
+/*!
+ * \fn static std::string base64_encode(const std::string& str)
+ * \brief encodes a string in base64
+ */
+std::string StringFilters::base64_encode(const std::string& str)
+{
+  std::string result(4 * ((str.size() + 2) / 3), '\0');
+
+  if (!str.empty())
+    simd::kernels().base64_encode(str.data(), str.size(), &result[0]);
+
+  return result;
+}
+
+namespace
+{
+
+struct Base64Values
+{
+  signed char values[256];
+
+  Base64Values()
+  {
+    std::fill(values, values + 256, -1);
+
+    for (int i(0); i < 26; ++i)
+    {
+      values['A' + i] = static_cast<signed char>(i);
+      values['a' + i] = static_cast<signed char>(26 + i);
+    }
+
+    for (int i(0); i < 10; ++i)
+      values['0' + i] = static_cast<signed char>(52 + i);
+
+    values['+'] = 62;
+    values['/'] = 63;
+  }
+};
+
+const Base64Values base64_values;
+
+} // namespace
+
+/*!
+ * \fn static std::string base64_decode(const std::string& str)
+ * \brief decodes a base64 string
+ *
+ * Throws an EvaluationException if the input is not valid base64
+ * (including its '=' padding).
+ */
+std::string StringFilters::base64_decode(const std::string& str)
+{
+  const size_t n = str.size();
+
+  if (n % 4 != 0)
+    throw EvaluationException{ "Invalid base64 provided to base64_decode" };
+
+  const size_t padding = n > 0 && str[n - 1] == '=' ? (str[n - 2] == '=' ? 2 : 1) : 0;
+  const size_t full = padding > 0 ? n - 4 : n;
+
+  std::string result(n / 4 * 3 - padding, '\0');
+  const unsigned char* s = reinterpret_cast<const unsigned char*>(str.data());
+  const signed char* values = base64_values.values;
+  char* out = &result[0];
+
+  for (size_t i(0); i < n; i += 4)
+  {
+    // the padding characters of the last group are decoded as zeros
+    const bool last = i == full;
+    const int a = values[s[i]];
+    const int b = values[s[i + 1]];
+    const int c = last && padding == 2 ? 0 : values[s[i + 2]];
+    const int d = last ? 0 : values[s[i + 3]];
+
+    if ((a | b | c | d) < 0)
+      throw EvaluationException{ "Invalid base64 provided to base64_decode" };
+
+    const uint32_t v = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | uint32_t(d);
+    *out++ = static_cast<char>(v >> 16);
+
+    if (last)
+    {
+      if (padding == 1)
+        *out++ = static_cast<char>((v >> 8) & 0xFF);
+
+      break;
+    }
+
+    *out++ = static_cast<char>((v >> 8) & 0xFF);
+    *out++ = static_cast<char>(v & 0xFF);
+  }
+
+  return result;
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
@@ -4,6 +4,7 @@
 
 #include "liquid/tags.h"
 
+#include "liquid/objects.h"
 #include "liquid/renderer.h"
 
 namespace liquid
@@ -103,6 +104,70 @@ void If::accept(Renderer& r)
   r.visitTag(*this);
 }
 
+/*!
+ * \class Case
+ * \brief implements the case/when/else tag
+ *
+ * The 'else' block, if any, is the last element of \c{whens}.
+ * When every 'when' value is a literal, \c{compile()} builds a hash table 
+ * from each value to the blocks it selects, so that the tag is rendered with a
+ * single evaluation of its object and a single lookup.
+ */
+
+Case::Case(std::shared_ptr<Object> expr, size_t off)
+  : Tag(off),
+    object(std::move(expr))
+{
+
+}
+
+void Case::accept(Renderer& r)
+{
+  r.visitTag(*this);
+}
+
+/*!
+ * \fn bool hasElse() const
+ * \brief returns whether the tag has an 'else' block
+ */
+bool Case::hasElse() const
+{
+  return !whens.empty() && whens.back().values.empty();
+}
+
+/*!
+ * \fn void compile()
+ * \brief builds the dispatch table if all the 'when' values are literals
+ *
+ * The blocks selected by a value are stored in order; a block that lists 
+ * the same value twice is only selected once.
+ */
+void Case::compile()
+{
+  DispatchTable table;
+
+  for (size_t i(0); i < whens.size(); ++i)
+  {
+    for (const std::shared_ptr<Object>& val : whens.at(i).values)
+    {
+      if (!val->is<objects::Value>())
+        return;
+
+      std::vector<size_t>& blocks = table[val->as<objects::Value>().value];
+
+      if (blocks.empty() || blocks.back() != i)
+        blocks.push_back(i);
+    }
+  }
+
+  dispatch = std::move(table);
+  hashed = true;
+}
+
+/*!
+ * \endclass
+ */
+
 Eject::Eject()
 {
 
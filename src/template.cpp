@@ -230,6 +230,13 @@ static void strip_whitespaces_at_tag(const std::vector<std::shared_ptr<templates
       {
         strip_whitespaces_at_tag(n->as<tags::For>().body, true, true);
       }
+      else if (n->is<tags::Case>())
+      {
+        for (tags::Case::When& when : n->as<tags::Case>().whens)
+        {
+          strip_whitespaces_at_tag(when.body, true, true);
+        }
+      }
 
       prev_was_tag = true;
       prev_was_text = false;
@@ -288,6 +295,13 @@ static void skip_whitespaces_at_tag(const std::vector<std::shared_ptr<templates:
       {
         skip_whitespaces_at_tag(n->as<tags::For>().body, true);
       }
+      else if (n->is<tags::Case>())
+      {
+        for (tags::Case::When& when : n->as<tags::Case>().whens)
+        {
+          skip_whitespaces_at_tag(when.body, true);
+        }
+      }
 
       prev_was_tag = true;
     }
@@ -328,6 +342,26 @@ Template parse(const std::string& str, std::string filepath)
   return Template{ str, lp.parse(str), filepath };
 }
 
+/*!
+ * \fn Template parse(const std::string& str, const FilterRegistry& filters, std::string filepath = {})
+ * \param template source
+ * \param registry used to resolve the filters
+ * \param optional filepath from which the source was read
+ * \brief parse a template
+ * \relates Template
+ *
+ * Unlike the other overload, filters that are not in the registry are 
+ * reported as errors.
+ * This function throws ParserException if parsing fails.
+ */
+Template parse(const std::string& str, const FilterRegistry& filters, std::string filepath)
+{
+  liquid::Parser lp;
+  lp.setFilters(filters);
+  lp.setStrictFilters(true);
+  return Template{ str, lp.parse(str), filepath };
+}
+
 /*!
  * \fn Template parseFile(std::string filepath)
  * \param filepath of the template to parse
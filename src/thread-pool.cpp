@@ -0,0 +1,175 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/thread-pool_p.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace liquid
+{
+
+/*!
+ * \class ThreadPool
+ *
+ * The thread calling \c{parallelFor()} processes chunks too and only waits 
+ * for the chunks that were started by a worker, so that a \c{parallelFor()} 
+ * nested in a task cannot wait for tasks queued behind it.
+ */
+
+ThreadPool::ThreadPool(size_t nthreads)
+{
+  for (size_t i(0); i < nthreads; ++i)
+    m_threads.emplace_back([this]() { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_stop = true;
+  }
+
+  m_condition.notify_all();
+
+  for (std::thread& t : m_threads)
+    t.join();
+}
+
+/*!
+ * \fn static ThreadPool& global()
+ * \brief returns the pool shared by the library
+ *
+ * Together with the calling thread, its workers use all the hardware threads.
+ */
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool{ std::max(2u, std::thread::hardware_concurrency()) - 1 };
+  return pool;
+}
+
+/*!
+ * \fn size_t size() const
+ * \brief returns the number of worker threads
+ */
+size_t ThreadPool::size() const
+{
+  return m_threads.size();
+}
+
+namespace
+{
+
+struct ParallelFor
+{
+  std::function<void(size_t, size_t)> func;
+  size_t n;
+  size_t chunks;
+  std::atomic<size_t> next{ 0 };
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t done = 0;
+  size_t error_chunk = 0;
+  std::exception_ptr error;
+
+  // processes chunks until there is none left
+  void run()
+  {
+    for (size_t c = next++; c < chunks; c = next++)
+    {
+      std::exception_ptr ex;
+
+      try
+      {
+        func(n * c / chunks, n * (c + 1) / chunks);
+      }
+      catch (...)
+      {
+        ex = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock{ mutex };
+
+      if (ex && (!error || c < error_chunk))
+        error = ex, error_chunk = c;
+
+      if (++done == chunks)
+        condition.notify_all();
+    }
+  }
+};
+
+} // namespace
+
+/*!
+ * \fn void parallelFor(size_t n, size_t chunks, const std::function<void(size_t, size_t)>& func)
+ * \brief calls \a func on \a chunks consecutive ranges covering [0, n)
+ *
+ * The ranges are processed concurrently by the calling thread and the workers.
+ * If \a func throws, the exception thrown for the first range is rethrown once 
+ * all the ranges have been processed.
+ */
+void ThreadPool::parallelFor(size_t n, size_t chunks, const std::function<void(size_t, size_t)>& func)
+{
+  chunks = std::min(chunks, n);
+
+  if (chunks == 0)
+    return;
+
+  auto job = std::make_shared<ParallelFor>();
+  job->func = func;
+  job->n = n;
+  job->chunks = chunks;
+
+  for (size_t i(1); i < std::min(chunks, size() + 1); ++i)
+    post([job]() { job->run(); });
+
+  job->run();
+
+  std::unique_lock<std::mutex> lock{ job->mutex };
+  job->condition.wait(lock, [&job]() { return job->done == job->chunks; });
+
+  if (job->error)
+    std::rethrow_exception(job->error);
+}
+
+void ThreadPool::post(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_tasks.push_back(std::move(task));
+  }
+
+  m_condition.notify_one();
+}
+
+void ThreadPool::work()
+{
+  for (;;)
+  {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock{ m_mutex };
+      m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+      if (m_stop && m_tasks.empty())
+        return;
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
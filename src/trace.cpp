@@ -0,0 +1,374 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/trace.h"
+#include "liquid/trace_p.h"
+
+#include "liquid/json.h"
+#include "liquid/parser.h"
+#include "liquid/template.h"
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace liquid
+{
+
+RecordingValue::RecordingValue(liquid::Value src, liquid::Value shdw)
+  : source(std::move(src)),
+    shadow(std::move(shdw))
+{
+
+}
+
+/*!
+ * \fn static liquid::Value wrap(const liquid::Value& src, liquid::Value& shadow_slot)
+ * \brief records a value into a shadow slot
+ *
+ * Simple values are copied into the slot and returned as is.
+ * Arrays and maps get a shadow container (reused if the slot already has one)
+ * and are returned wrapped in a RecordingValue.
+ */
+liquid::Value RecordingValue::wrap(const liquid::Value& src, liquid::Value& shadow_slot)
+{
+  if (src.isArray())
+  {
+    if (!shadow_slot.isArray())
+      shadow_slot = liquid::Array(std::vector<liquid::Value>(src.length()));
+
+    return liquid::Value(std::make_shared<RecordingValue>(src, shadow_slot));
+  }
+  else if (src.isMap())
+  {
+    if (!shadow_slot.isMap())
+      shadow_slot = liquid::Map();
+
+    return liquid::Value(std::make_shared<RecordingValue>(src, shadow_slot));
+  }
+  else
+  {
+    shadow_slot = src;
+    return src;
+  }
+}
+
+bool RecordingValue::is_array() const
+{
+  return source.isArray();
+}
+
+bool RecordingValue::is_map() const
+{
+  return source.isMap();
+}
+
+std::type_index RecordingValue::type_index() const
+{
+  return std::type_index(typeid(RecordingValue));
+}
+
+void* RecordingValue::data()
+{
+  return source.data();
+}
+
+size_t RecordingValue::length() const
+{
+  return source.length();
+}
+
+Value RecordingValue::at(size_t index) const
+{
+  liquid::Value elem = source.at(index);
+
+  if (index >= source.length())
+    return elem;
+
+  liquid::Array shadow_array = shadow.toArray();
+  return wrap(elem, shadow_array[index]);
+}
+
+std::set<std::string> RecordingValue::propertyNames() const
+{
+  std::set<std::string> names = source.propertyNames();
+
+  // the shadow must report the same names
+  for (const std::string& n : names)
+    property(n);
+
+  return names;
+}
+
+Value RecordingValue::property(const std::string& name) const
+{
+  liquid::Value val = source.property(name);
+
+  if (val.isNull())
+    return val;
+
+  liquid::Map shadow_map = shadow.toMap();
+  return wrap(val, shadow_map[name]);
+}
+
+RecordingRootValue::RecordingRootValue(liquid::Map src, liquid::Map shdw)
+  : source(std::move(src)),
+    shadow(std::move(shdw))
+{
+
+}
+
+std::set<std::string> RecordingRootValue::propertyNames() const
+{
+  std::set<std::string> names = source.propertyNames();
+
+  for (const std::string& n : names)
+    property(n);
+
+  for (const auto& e : dict)
+    names.insert(e.first);
+
+  return names;
+}
+
+Value RecordingRootValue::property(const std::string& name) const
+{
+  auto it = dict.find(name);
+
+  if (it != dict.end())
+    return it->second;
+
+  liquid::Value val = source.property(name);
+
+  if (val.isNull())
+    return val;
+
+  liquid::Map shadow_map = shadow;
+  return RecordingValue::wrap(val, shadow_map[name]);
+}
+
+/*!
+ * \fn liquid::Map start(const Template& tmplt, const liquid::Map& data)
+ * \brief starts recording the render of a template
+ *
+ * Returns the map that must be used as root data for the render.
+ */
+liquid::Map TraceRecorder::start(const Template& tmplt, const liquid::Map& data)
+{
+  trace = Trace();
+  trace.filePath = tmplt.filePath();
+  trace.source = tmplt.source();
+
+  return liquid::Map(std::make_shared<RecordingRootValue>(data, trace.data));
+}
+
+void TraceRecorder::recordPartial(const std::string& name, const Template& tmplt)
+{
+  trace.partials[name] = tmplt.source();
+}
+
+/*!
+ * \class Trace
+ */
+
+Trace::Trace()
+{
+
+}
+
+static void collect_string_literals(const std::string& src, std::set<std::string>& literals)
+{
+  for (size_t i(0); i < src.size(); ++i)
+  {
+    if (src[i] != '\'' && src[i] != '"')
+      continue;
+
+    size_t end = src.find(src[i], i + 1);
+
+    if (end == std::string::npos)
+      break;
+
+    literals.insert(src.substr(i + 1, end - i - 1));
+    i = end;
+  }
+}
+
+static std::string scramble(const std::string& str)
+{
+  std::string result = str;
+  uint32_t h = 2166136261u;
+
+  for (char c : str)
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+
+  for (char& c : result)
+  {
+    h = h * 1103515245u + 12345u;
+    const uint32_t r = h >> 16;
+
+    if (c >= 'a' && c <= 'z')
+      c = static_cast<char>('a' + r % 26);
+    else if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>('A' + r % 26);
+    else if (c >= '0' && c <= '9')
+      c = static_cast<char>('0' + r % 10);
+    else if (static_cast<unsigned char>(c) >= 0x80)
+      c = static_cast<char>('a' + r % 26);
+  }
+
+  return result;
+}
+
+static liquid::Value anonymize_value(const liquid::Value& val, const std::set<std::string>& keep)
+{
+  if (val.is<std::string>())
+  {
+    const std::string& str = val.as<std::string>();
+    return keep.find(str) != keep.end() ? val : liquid::Value(scramble(str));
+  }
+  else if (val.isArray())
+  {
+    std::vector<liquid::Value> values;
+    values.reserve(val.length());
+
+    for (size_t i(0); i < val.length(); ++i)
+      values.push_back(anonymize_value(val.at(i), keep));
+
+    return liquid::Value(std::move(values));
+  }
+  else if (val.isMap())
+  {
+    std::map<std::string, liquid::Value> dict;
+
+    for (const std::string& name : val.propertyNames())
+      dict[name] = anonymize_value(val.property(name), keep);
+
+    return liquid::Value(std::move(dict));
+  }
+  else
+  {
+    return val;
+  }
+}
+
+/*!
+ * \fn void anonymize()
+ * \brief replaces the content of the strings in the recorded data
+ *
+ * Letters and digits are replaced by pseudo-random ones (non-ASCII characters
+ * are replaced by ASCII letters), preserving the length in bytes, whitespaces
+ * and punctuation. Property names, numbers and booleans are kept.
+ * Strings that appear as a string literal in one of the templates are also
+ * kept so that comparisons in the templates still evaluate the same way.
+ */
+void Trace::anonymize()
+{
+  std::set<std::string> literals;
+  collect_string_literals(source, literals);
+
+  for (const auto& p : partials)
+    collect_string_literals(p.second, literals);
+
+  data = anonymize_value(data, literals).toMap();
+}
+
+/*!
+ * \fn std::string toJson() const
+ * \brief returns the JSON representation of the trace
+ */
+std::string Trace::toJson() const
+{
+  liquid::Map tmplt;
+  tmplt["path"] = filePath;
+  tmplt["source"] = source;
+
+  liquid::Map parts;
+
+  for (const auto& p : partials)
+    parts[p.first] = p.second;
+
+  liquid::Map bundle;
+  bundle["version"] = 1;
+  bundle["template"] = tmplt;
+  bundle["partials"] = parts;
+  bundle["data"] = data;
+
+  return json::stringify(bundle);
+}
+
+/*!
+ * \fn static Trace fromJson(const std::string& str)
+ * \brief reads a trace from its JSON representation
+ *
+ * Throws ParserException if the input is not a valid trace.
+ */
+Trace Trace::fromJson(const std::string& str)
+{
+  liquid::Value bundle = json::parse(str);
+
+  if (!bundle.isMap() || !bundle.property("template").isMap() || !bundle.property("template").property("source").is<std::string>())
+    throw ParserException{ 0, "invalid trace: missing template source" };
+
+  Trace result;
+
+  liquid::Value tmplt = bundle.property("template");
+  result.source = tmplt.property("source").as<std::string>();
+
+  if (tmplt.property("path").is<std::string>())
+    result.filePath = tmplt.property("path").as<std::string>();
+
+  liquid::Value parts = bundle.property("partials");
+
+  for (const std::string& name : parts.propertyNames())
+  {
+    liquid::Value p = parts.property(name);
+
+    if (!p.is<std::string>())
+      throw ParserException{ 0, "invalid trace: partial '" + name + "' is not a string" };
+
+    result.partials[name] = p.as<std::string>();
+  }
+
+  if (bundle.property("data").isMap())
+    result.data = bundle.property("data").toMap();
+
+  return result;
+}
+
+/*!
+ * \fn void save(const std::string& filepath) const
+ * \brief writes the trace as JSON in a file
+ */
+void Trace::save(const std::string& filepath) const
+{
+  std::ofstream file{ filepath, std::ios::binary };
+
+  if (!file)
+    throw std::runtime_error{ "could not open '" + filepath + "' for writing" };
+
+  file << toJson();
+}
+
+/*!
+ * \fn static Trace load(const std::string& filepath)
+ * \brief reads a trace from a file
+ */
+Trace Trace::load(const std::string& filepath)
+{
+  std::ifstream file{ filepath, std::ios::binary };
+
+  if (!file)
+    throw std::runtime_error{ "could not open '" + filepath + "'" };
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return fromJson(buffer.str());
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace liquid
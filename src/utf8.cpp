@@ -0,0 +1,253 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/utf8_p.h"
+
+#include "liquid/cache_p.h"
+#include "liquid/simd_p.h"
+
+#include <algorithm>
+
+namespace liquid
+{
+
+/*!
+ * \namespace utf8
+ * \brief character-level access to UTF-8 strings
+ *
+ * A character is a code point of a valid UTF-8 string; strings that are not
+ * valid UTF-8 are treated as one character per byte.
+ * ASCII strings are detected by counting the characters, which is done with
+ * SIMD instructions, and are never validated nor indexed.
+ */
+
+namespace utf8
+{
+
+static inline bool is_continuation(char c)
+{
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// returns the offset of the count-th character after the one starting at pos
+static size_t advance(const char* str, size_t n, size_t pos, size_t count)
+{
+  while (count > 0 && pos < n)
+  {
+    ++pos;
+
+    while (pos < n && is_continuation(str[pos]))
+      ++pos;
+
+    --count;
+  }
+
+  return pos;
+}
+
+/*!
+ * \fn bool valid(const char* str, size_t n)
+ * \brief returns whether a string is valid UTF-8
+ */
+bool valid(const char* str, size_t n)
+{
+  return simd::kernels().utf8_validate(str, n);
+}
+
+/*!
+ * \fn size_t length(const char* str, size_t n)
+ * \brief returns the number of characters of a string
+ */
+size_t length(const char* str, size_t n)
+{
+  const simd::Kernels& k = simd::kernels();
+  const size_t count = k.utf8_count(str, n);
+  return count == n || !k.utf8_validate(str, n) ? n : count;
+}
+
+/*!
+ * \fn size_t offset(const char* str, size_t n, size_t index)
+ * \brief returns the offset of the \a index-th character of a valid UTF-8 string
+ *
+ * Returns \a n if the string has less than \a index characters.
+ */
+size_t offset(const char* str, size_t n, size_t index)
+{
+  return index == 0 ? 0 : advance(str, n, 0, index);
+}
+
+/*!
+ * \class Index
+ *
+ * Finding the offset of a character scans at most Stride characters
+ * from the closest indexed one.
+ */
+
+Index::Index(const char* str, size_t n)
+  : m_data(str),
+    m_size(n),
+    m_length(utf8::length(str, n))
+{
+  if (m_length == m_size)
+    return;
+
+  m_points.reserve(m_length / Stride + 1);
+  size_t count = 0;
+
+  for (size_t i(0); i < n; ++i)
+  {
+    if (is_continuation(str[i]))
+      continue;
+
+    if (count % Stride == 0)
+      m_points.push_back(i);
+
+    ++count;
+  }
+}
+
+/*!
+ * \fn size_t length() const
+ * \brief returns the number of characters of the string
+ */
+size_t Index::length() const
+{
+  return m_length;
+}
+
+/*!
+ * \fn size_t offset(size_t index) const
+ * \brief returns the offset of a character, or the size of the string if \a index is too large
+ */
+size_t Index::offset(size_t index) const
+{
+  if (index >= m_length)
+    return m_size;
+  else if (m_points.empty())
+    return index;
+  else
+    return advance(m_data, m_size, m_points[index / Stride], index % Stride);
+}
+
+/*!
+ * \endclass
+ */
+
+/*!
+ * \class Text
+ *
+ * Strings of at least IndexThreshold bytes are indexed once per render
+ * (see \c{RenderCache::utf8Index()}) so that repeatedly accessing their
+ * characters does not rescan them. The string must outlive the Text.
+ */
+
+Text::Text(const char* str, size_t n)
+  : m_data(str),
+    m_size(n),
+    m_length(utf8::length(str, n))
+{
+
+}
+
+Text::Text(const liquid::Value& str)
+  : m_data(str.as<std::string>().data()),
+    m_size(str.as<std::string>().size())
+{
+  if (m_size >= IndexThreshold)
+  {
+    m_index = RenderCache::utf8Index(str);
+    m_length = m_index->length();
+  }
+  else
+  {
+    m_length = utf8::length(m_data, m_size);
+  }
+}
+
+/*!
+ * \fn size_t length() const
+ * \brief returns the number of characters
+ */
+size_t Text::length() const
+{
+  return m_length;
+}
+
+/*!
+ * \fn size_t offset(size_t index) const
+ * \brief returns the offset of a character, or the size of the string if \a index is too large
+ */
+size_t Text::offset(size_t index) const
+{
+  if (m_length == m_size)
+    return std::min(index, m_size);
+  else if (m_index)
+    return m_index->offset(index);
+  else
+    return index >= m_length ? m_size : utf8::offset(m_data, m_size, index);
+}
+
+/*!
+ * \fn std::string substr(size_t index, size_t count) const
+ * \brief returns at most \a count characters starting at \a index
+ */
+std::string Text::substr(size_t index, size_t count) const
+{
+  if (index >= m_length)
+    return std::string();
+
+  const size_t begin = offset(index);
+  const size_t end = count >= m_length - index ? m_size : offset(index + count);
+  return std::string(m_data + begin, end - begin);
+}
+
+/*!
+ * \fn std::string slice(int start, int length) const
+ * \brief implements the slice filter, a negative \a start is counted from the end
+ */
+std::string Text::slice(int start, int length) const
+{
+  const long long n = static_cast<long long>(m_length);
+  long long first = start;
+
+  if (first < 0)
+    first += n;
+
+  if (first < 0 || first >= n || length <= 0)
+    return std::string();
+
+  return substr(static_cast<size_t>(first), static_cast<size_t>(length));
+}
+
+/*!
+ * \fn std::string truncate(int length, const std::string& ellipsis) const
+ * \brief implements the truncate filter, the ellipsis is counted in \a length
+ */
+std::string Text::truncate(int length, const std::string& ellipsis) const
+{
+  if (length < 0 || m_length <= static_cast<size_t>(length))
+    return std::string(m_data, m_size);
+
+  const size_t suffix = utf8::length(ellipsis.data(), ellipsis.size());
+  const size_t kept = static_cast<size_t>(length) > suffix ? length - suffix : 0;
+
+  std::string result;
+  const size_t end = offset(kept);
+  result.reserve(end + ellipsis.size());
+  result.append(m_data, end);
+  result.append(ellipsis);
+  return result;
+}
+
+/*!
+ * \endclass
+ */
+
+} // namespace utf8
+
+/*!
+ * \endnamespace
+ */
+
+} // namespace liquid
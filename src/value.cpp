@@ -5,7 +5,9 @@
 #include "liquid/value.h"
 #include "liquid/value_p.h"
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <stdexcept>
 
 /*!
@@ -71,6 +73,374 @@ Value VectorValue::at(size_t index) const
 }
 
 
+ArrayViewValue::ArrayViewValue(Array src, size_t off, size_t n, bool rev)
+  : source(std::move(src)),
+    offset(off),
+    count(n),
+    reversed(rev)
+{
+
+}
+
+/*!
+ * \fn static Array slice(const Array& a, size_t off, size_t n)
+ * \brief returns a view over \a n elements of \a a starting at \a off
+ *
+ * The range must be valid. Slicing a view creates a view over the same source.
+ */
+Array ArrayViewValue::slice(const Array& a, size_t off, size_t n)
+{
+  if (a.impl()->type_index() == std::type_index(typeid(ArrayViewValue)))
+  {
+    const auto& view = static_cast<const ArrayViewValue&>(*a.impl());
+
+    if (view.reversed)
+      return Array(std::make_shared<ArrayViewValue>(view.source, view.offset + view.count - off - n, n, true));
+    else
+      return Array(std::make_shared<ArrayViewValue>(view.source, view.offset + off, n, false));
+  }
+
+  return Array(std::make_shared<ArrayViewValue>(a, off, n, false));
+}
+
+/*!
+ * \fn static Array reverse(const Array& a)
+ * \brief returns a view over the elements of \a a in reverse order
+ */
+Array ArrayViewValue::reverse(const Array& a)
+{
+  if (a.impl()->type_index() == std::type_index(typeid(ArrayViewValue)))
+  {
+    const auto& view = static_cast<const ArrayViewValue&>(*a.impl());
+    return Array(std::make_shared<ArrayViewValue>(view.source, view.offset, view.count, !view.reversed));
+  }
+
+  return Array(std::make_shared<ArrayViewValue>(a, 0, a.length(), true));
+}
+
+bool ArrayViewValue::is_array() const
+{
+  return true;
+}
+
+std::type_index ArrayViewValue::type_index() const
+{
+  return std::type_index(typeid(ArrayViewValue));
+}
+
+size_t ArrayViewValue::length() const
+{
+  return count;
+}
+
+Value ArrayViewValue::at(size_t index) const
+{
+  if (index >= count)
+    throw std::out_of_range("ArrayViewValue::at()");
+
+  return source.at(reversed ? offset + count - 1 - index : offset + index);
+}
+
+
+ConcatArrayValue::ConcatArrayValue()
+{
+
+}
+
+/*!
+ * \fn static Array concat(const Array& a, const Array& b)
+ * \brief returns a view over the elements of \a a followed by those of \a b
+ *
+ * Concatenations are flattened: the view refers to the arrays that are not 
+ * themselves concatenations, so that \c{at()} is a binary search over the sources.
+ */
+Array ConcatArrayValue::concat(const Array& a, const Array& b)
+{
+  auto result = std::make_shared<ConcatArrayValue>();
+  result->add(a);
+  result->add(b);
+  return Array(result);
+}
+
+void ConcatArrayValue::add(const Array& a)
+{
+  if (a.impl()->type_index() == std::type_index(typeid(ConcatArrayValue)))
+  {
+    for (const Array& src : static_cast<const ConcatArrayValue&>(*a.impl()).sources)
+      add(src);
+  }
+  else if (a.length() > 0)
+  {
+    ends.push_back(length() + a.length());
+    sources.push_back(a);
+  }
+}
+
+bool ConcatArrayValue::is_array() const
+{
+  return true;
+}
+
+std::type_index ConcatArrayValue::type_index() const
+{
+  return std::type_index(typeid(ConcatArrayValue));
+}
+
+size_t ConcatArrayValue::length() const
+{
+  return ends.empty() ? 0 : ends.back();
+}
+
+Value ConcatArrayValue::at(size_t index) const
+{
+  const size_t i = std::upper_bound(ends.begin(), ends.end(), index) - ends.begin();
+
+  if (i == ends.size())
+    throw std::out_of_range("ConcatArrayValue::at()");
+
+  return sources[i].at(i == 0 ? index : index - ends[i - 1]);
+}
+
+
+PersistentVectorValue::PersistentVectorValue(Array pre)
+  : prefix(std::move(pre)),
+    count(0),
+    shift(Bits),
+    root(std::make_shared<const Node>()),
+    tail(std::make_shared<const std::vector<Value>>())
+{
+
+}
+
+static std::shared_ptr<const PersistentVectorValue::Node> new_path(size_t level, std::shared_ptr<const PersistentVectorValue::Node> node)
+{
+  if (level == 0)
+    return node;
+
+  auto result = std::make_shared<PersistentVectorValue::Node>();
+  result->children.push_back(new_path(level - PersistentVectorValue::Bits, std::move(node)));
+  return result;
+}
+
+/*!
+ * \fn static Array push(const Array& a, const Value& elem)
+ * \brief returns an array made of the elements of \a a followed by \a elem
+ *
+ * If \a a is not a persistent vector, it becomes the prefix of a new one.
+ */
+Array PersistentVectorValue::push(const Array& a, const Value& elem)
+{
+  if (a.impl()->type_index() != std::type_index(typeid(PersistentVectorValue)))
+    return push(Array(std::make_shared<PersistentVectorValue>(a)), elem);
+
+  const auto& self = static_cast<const PersistentVectorValue&>(*a.impl());
+  auto result = std::make_shared<PersistentVectorValue>(self);
+
+  if (self.count - self.tailOffset() < Width)
+  {
+    auto newtail = std::make_shared<std::vector<Value>>();
+    newtail->reserve(self.tail->size() + 1);
+    newtail->insert(newtail->end(), self.tail->begin(), self.tail->end());
+    newtail->push_back(elem);
+    result->tail = newtail;
+    result->count += 1;
+    return Array(result);
+  }
+
+  // the tail is full, it is moved into the trie
+  auto tailnode = std::make_shared<Node>();
+  tailnode->values = *self.tail;
+
+  if ((self.count >> Bits) > (size_t(1) << self.shift))
+  {
+    auto newroot = std::make_shared<Node>();
+    newroot->children.push_back(self.root);
+    newroot->children.push_back(new_path(self.shift, tailnode));
+    result->root = newroot;
+    result->shift += Bits;
+  }
+  else
+  {
+    result->root = self.pushTail(self.shift, *self.root, tailnode);
+  }
+
+  result->tail = std::make_shared<const std::vector<Value>>(1, elem);
+  result->count += 1;
+  return Array(result);
+}
+
+/*!
+ * \fn static Array pop(const Array& a)
+ * \brief returns an array made of the elements of \a a but the last one
+ */
+Array PersistentVectorValue::pop(const Array& a)
+{
+  if (a.impl()->type_index() != std::type_index(typeid(PersistentVectorValue)))
+    return ArrayViewValue::slice(a, 0, a.length() > 0 ? a.length() - 1 : 0);
+
+  const auto& self = static_cast<const PersistentVectorValue&>(*a.impl());
+
+  if (self.count == 0)
+    return pop(self.prefix);
+  else if (self.count == 1)
+    return ArrayViewValue::slice(self.prefix, 0, self.prefix.length());
+
+  auto result = std::make_shared<PersistentVectorValue>(self);
+  result->count -= 1;
+
+  if (self.count - self.tailOffset() > 1)
+  {
+    result->tail = std::make_shared<const std::vector<Value>>(self.tail->begin(), self.tail->end() - 1);
+    return Array(result);
+  }
+
+  // the tail becomes the last leaf of the trie
+  result->tail = std::make_shared<const std::vector<Value>>(self.leaf(self.count - 2));
+  std::shared_ptr<const Node> newroot = self.popTail(self.shift, *self.root);
+
+  if (!newroot)
+    newroot = std::make_shared<const Node>();
+
+  if (self.shift > Bits && newroot->children.size() == 1)
+  {
+    newroot = newroot->children.front();
+    result->shift -= Bits;
+  }
+
+  result->root = newroot;
+  return Array(result);
+}
+
+bool PersistentVectorValue::is_array() const
+{
+  return true;
+}
+
+std::type_index PersistentVectorValue::type_index() const
+{
+  return std::type_index(typeid(PersistentVectorValue));
+}
+
+size_t PersistentVectorValue::length() const
+{
+  return prefix.length() + count;
+}
+
+Value PersistentVectorValue::at(size_t index) const
+{
+  const size_t n = prefix.length();
+
+  if (index < n)
+    return prefix.at(index);
+
+  index -= n;
+
+  if (index >= count)
+    throw std::out_of_range("PersistentVectorValue::at()");
+
+  return leaf(index)[index & (Width - 1)];
+}
+
+// index of the first element of the tail
+size_t PersistentVectorValue::tailOffset() const
+{
+  return count < Width ? 0 : ((count - 1) >> Bits) << Bits;
+}
+
+// returns the leaf holding the element at the given index (not counting the prefix)
+const std::vector<Value>& PersistentVectorValue::leaf(size_t index) const
+{
+  if (index >= tailOffset())
+    return *tail;
+
+  const Node* node = root.get();
+
+  for (size_t level = shift; level > 0; level -= Bits)
+    node = node->children[(index >> level) & (Width - 1)].get();
+
+  return node->values;
+}
+
+std::shared_ptr<const PersistentVectorValue::Node> PersistentVectorValue::pushTail(size_t level, const Node& parent, std::shared_ptr<const Node> tailnode) const
+{
+  const size_t subidx = ((count - 1) >> level) & (Width - 1);
+  auto result = std::make_shared<Node>(parent);
+  std::shared_ptr<const Node> inserted;
+
+  if (level == Bits)
+    inserted = std::move(tailnode);
+  else if (subidx < parent.children.size())
+    inserted = pushTail(level - Bits, *parent.children[subidx], std::move(tailnode));
+  else
+    inserted = new_path(level - Bits, std::move(tailnode));
+
+  if (subidx < result->children.size())
+    result->children[subidx] = inserted;
+  else
+    result->children.push_back(inserted);
+
+  return result;
+}
+
+std::shared_ptr<const PersistentVectorValue::Node> PersistentVectorValue::popTail(size_t level, const Node& node) const
+{
+  const size_t subidx = ((count - 2) >> level) & (Width - 1);
+
+  if (level > Bits)
+  {
+    std::shared_ptr<const Node> child = popTail(level - Bits, *node.children[subidx]);
+
+    if (!child && subidx == 0)
+      return nullptr;
+
+    auto result = std::make_shared<Node>(node);
+
+    if (child)
+      result->children[subidx] = child;
+    else
+      result->children.pop_back();
+
+    return result;
+  }
+  else if (subidx == 0)
+  {
+    return nullptr;
+  }
+
+  auto result = std::make_shared<Node>(node);
+  result->children.pop_back();
+  return result;
+}
+
+
+MappedArrayValue::MappedArrayValue(Array src, std::string f)
+  : source(std::move(src)),
+    field(std::move(f))
+{
+
+}
+
+bool MappedArrayValue::is_array() const
+{
+  return true;
+}
+
+std::type_index MappedArrayValue::type_index() const
+{
+  return std::type_index(typeid(MappedArrayValue));
+}
+
+size_t MappedArrayValue::length() const
+{
+  return source.length();
+}
+
+Value MappedArrayValue::at(size_t index) const
+{
+  return source.at(index).property(field);
+}
+
+
 MapValue::MapValue()
 {
 
@@ -230,6 +600,33 @@ Value IValue::property(const std::string& /* name */) const
   return Value();
 }
 
+/*!
+ * \fn virtual int resolve(const std::string& name) const
+ * \brief returns the slot of a property, or -1
+ *
+ * The default implementation returns -1, in which case properties are 
+ * accessed with \c{property()}.
+ *
+ * A slot must only depend on the name and on the concrete type of the IValue:
+ * the renderer caches the slot of each member access of a template and reuses it, 
+ * through \c{get()}, for all the values of the same type.
+ */
+int IValue::resolve(const std::string& /* name */) const
+{
+  return -1;
+}
+
+/*!
+ * \fn virtual Value get(int slot) const
+ * \brief returns the property whose slot was returned by \c{resolve()}
+ *
+ * The default implementation returns a null value.
+ */
+Value IValue::get(int /* slot */) const
+{
+  return Value();
+}
+
 /*!
  * \endclass
  */
@@ -529,6 +926,28 @@ Array::Array(std::shared_ptr<IValue> impl)
     d = std::make_shared<VectorValue>();
 }
 
+/*!
+ * \fn static Array fromInts(std::vector<int> vals)
+ * \brief constructs a read-only array of ints
+ *
+ * The ints are stored contiguously, which makes numeric filters such as \c{sum} faster.
+ */
+Array Array::fromInts(std::vector<int> vals)
+{
+  return Array(std::make_shared<NumberArrayValue<int>>(std::move(vals)));
+}
+
+/*!
+ * \fn static Array fromDoubles(std::vector<double> vals)
+ * \brief constructs a read-only array of doubles
+ *
+ * See \c{fromInts()}.
+ */
+Array Array::fromDoubles(std::vector<double> vals)
+{
+  return Array(std::make_shared<NumberArrayValue<double>>(std::move(vals)));
+}
+
 /*!
  * \fn size_t length() const
  * \brief returns the length of the array
@@ -556,6 +975,8 @@ Value Array::at(size_t index) const
  * 
  * Arrays constructed using the default constructor, or the vector constructor 
  * of this class are writable.
+ * Other arrays, such as the views returned by the array filters, are copied 
+ * into a writable array the first time they are modified.
  */
 bool Array::isWritable() const
 {
@@ -566,14 +987,11 @@ bool Array::isWritable() const
  * \fn void push(Value val)
  * \brief adds a value to the array
  *
- * The array must be writable.
+ * If the array is not writable, its elements are first copied into a writable array.
  */
 void Array::push(Value val)
 {
-  assert(isWritable());
-
-  if (!isWritable())
-    throw std::runtime_error{ "Array is not writable" };
+  detach();
 
   auto* vec = static_cast<VectorValue*>(d.get());
   vec->values.push_back(val);
@@ -588,10 +1006,27 @@ void Array::push(Value val)
  */
 Value& Array::operator[](size_t index)
 {
+  detach();
+
   auto* self = static_cast<VectorValue*>(d.get());
   return self->values[index];
 }
 
+// replaces a read-only implementation by a writable copy
+void Array::detach()
+{
+  if (isWritable())
+    return;
+
+  std::vector<Value> values;
+  values.reserve(d->length());
+
+  for (size_t i(0); i < d->length(); ++i)
+    values.push_back(d->at(i));
+
+  d = std::make_shared<VectorValue>(std::move(values));
+}
+
 /*!
  * \fn operator Value() const
  * \brief converts the array to a value
@@ -747,6 +1182,11 @@ inline int sign(int diff)
   return (0 < diff) - (diff < 0);
 }
 
+inline int sign(double diff)
+{
+  return (0 < diff) - (diff < 0);
+}
+
 template<typename T>
 int number_compare(const T* lhs_node, const T* rhs_node)
 {
@@ -831,7 +1271,7 @@ inline int comp(double a, int b)
 
 inline int comp(const std::string& a, const std::string& b)
 {
-  return std::strcmp(a.data(), b.data());
+  return sign(a.compare(b));
 }
 
 int compare(const Value& lhs, const Value& rhs)
@@ -839,6 +1279,12 @@ int compare(const Value& lhs, const Value& rhs)
   std::type_index lhs_type = lhs.typeIndex();
   std::type_index rhs_type = rhs.typeIndex();
 
+  // arrays and maps are compared structurally, whatever their implementation
+  if (lhs.isArray() && rhs.isArray())
+    return array_compare(lhs, rhs);
+  else if (lhs.isMap() && rhs.isMap())
+    return object_compare(lhs, rhs);
+
   if (lhs_type != rhs_type)
   {
     if (lhs.is<int>() && rhs.is<double>())
@@ -852,11 +1298,7 @@ int compare(const Value& lhs, const Value& rhs)
       return 1;
   }
     
-  if (lhs.isArray())
-    return array_compare(lhs, rhs);
-  else if (lhs.isMap())
-    return object_compare(lhs, rhs);
-  else if (lhs.isNull())
+  if (lhs.isNull())
     return 0;
   else if (lhs.is<bool>())
     return comp(lhs.as<bool>(), rhs.as<bool>());
@@ -871,6 +1313,66 @@ int compare(const Value& lhs, const Value& rhs)
   throw std::runtime_error{ "liquid::compare() : values are not comparable" };
 }
 
+inline size_t hash_combine(size_t seed, size_t h)
+{
+  return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/*!
+ * \fn size_t hash(const Value& val)
+ * \brief computes a hash of a value
+ *
+ * Arrays and maps are hashed structurally: values for which \c{compare()} 
+ * returns 0 have the same hash.
+ */
+size_t hash(const Value& val)
+{
+  if (val.isArray())
+  {
+    size_t h = val.length();
+
+    for (size_t i(0); i < val.length(); ++i)
+      h = hash_combine(h, hash(val.at(i)));
+
+    return h;
+  }
+  else if (val.isMap())
+  {
+    size_t h = 0;
+
+    for (const std::string& name : val.propertyNames())
+    {
+      h = hash_combine(h, std::hash<std::string>()(name));
+      h = hash_combine(h, hash(val.property(name)));
+    }
+
+    return h;
+  }
+  else if (val.isNull())
+  {
+    return 0;
+  }
+  else if (val.is<bool>())
+  {
+    return val.as<bool>() ? 1 : 2;
+  }
+  else if (val.is<int>())
+  {
+    // ints and doubles with the same value compare equal
+    return std::hash<double>()(static_cast<double>(val.as<int>()));
+  }
+  else if (val.is<double>())
+  {
+    return std::hash<double>()(val.as<double>());
+  }
+  else if (val.is<std::string>())
+  {
+    return std::hash<std::string>()(val.as<std::string>());
+  }
+
+  return std::hash<std::type_index>()(val.typeIndex());
+}
+
 /*!
  * \endnamespace
  */
@@ -0,0 +1,132 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "allocation-counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace allocation_counter
+{
+
+namespace
+{
+
+thread_local size_t g_allocations = 0;
+thread_local size_t g_deallocations = 0;
+thread_local size_t g_bytes = 0;
+
+void* allocate(size_t size)
+{
+  ++g_allocations;
+  g_bytes += size;
+
+  void* ptr = std::malloc(size != 0 ? size : 1);
+
+  if (!ptr)
+    throw std::bad_alloc();
+
+  return ptr;
+}
+
+void deallocate(void* ptr) noexcept
+{
+  if (!ptr)
+    return;
+
+  ++g_deallocations;
+  std::free(ptr);
+}
+
+} // namespace
+
+Stats current()
+{
+  Stats result;
+  result.allocations = g_allocations;
+  result.deallocations = g_deallocations;
+  result.bytes = g_bytes;
+  return result;
+}
+
+Scope::Scope()
+  : m_start(current())
+{
+
+}
+
+Stats Scope::stats() const
+{
+  Stats now = current();
+  now.allocations -= m_start.allocations;
+  now.deallocations -= m_start.deallocations;
+  now.bytes -= m_start.bytes;
+  return now;
+}
+
+} // namespace allocation_counter
+
+void* operator new(size_t size)
+{
+  return allocation_counter::allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+  return allocation_counter::allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return allocation_counter::allocate(size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  try
+  {
+    return allocation_counter::allocate(size);
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+}
+
+void operator delete(void* ptr) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  allocation_counter::deallocate(ptr);
+}
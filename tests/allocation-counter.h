@@ -0,0 +1,50 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_ALLOCATION_COUNTER_H
+#define LIQUID_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+/*!
+ * \namespace allocation_counter
+ * \brief counts the calls to the global operator new and delete
+ *
+ * When allocation-counter.cpp is linked into an executable, the global
+ * allocation functions are replaced by versions that count the number of
+ * allocations and the number of bytes allocated.
+ * Counters are per thread so that a measurement is not affected by
+ * allocations performed concurrently by other threads.
+ */
+
+namespace allocation_counter
+{
+
+struct Stats
+{
+  size_t allocations = 0;
+  size_t deallocations = 0;
+  size_t bytes = 0;
+};
+
+Stats current();
+
+/*!
+ * \class Scope
+ * \brief measures the allocations performed by the current thread during its lifetime
+ */
+class Scope
+{
+public:
+  Scope();
+
+  Stats stats() const;
+
+private:
+  Stats m_start;
+};
+
+} // namespace allocation_counter
+
+#endif // LIQUID_ALLOCATION_COUNTER_H
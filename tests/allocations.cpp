@@ -0,0 +1,101 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "allocation-counter.h"
+
+#include "liquid/liquid.h"
+
+#include "liquid/renderer.h"
+
+#include <gtest/gtest.h>
+
+// These tests put an upper bound on the number of allocations performed 
+// while parsing and rendering representative templates.
+// If one of these tests fails after a change, either the change introduced 
+// unwanted allocations or the bound should be lowered to lock in an improvement.
+
+static allocation_counter::Stats count_parse(const std::string& str)
+{
+  allocation_counter::Scope scope;
+  liquid::Template tmplt = liquid::parse(str);
+  return scope.stats();
+}
+
+static allocation_counter::Stats count_render(liquid::Renderer& renderer, const liquid::Template& tmplt, const liquid::Map& data)
+{
+  // first render warms up internal buffers
+  renderer.render(tmplt, data);
+
+  allocation_counter::Scope scope;
+  std::string result = renderer.render(tmplt, data);
+  return scope.stats();
+}
+
+static liquid::Map make_data()
+{
+  liquid::Array products;
+
+  for (int i(0); i < 10; ++i)
+  {
+    liquid::Map p;
+    p["title"] = "Product #" + std::to_string(i);
+    p["price"] = 10 * i;
+    p["available"] = (i % 2 == 0);
+    products.push(p);
+  }
+
+  liquid::Map data;
+  data["name"] = "Alice";
+  data["products"] = products;
+  return data;
+}
+
+static const char* hello_template = "Hello {{ name }}!";
+
+static const char* loop_template =
+  "{% for p in products %}"
+  "{{ p.title }}{% if p.available %} {{ p.price }}{% endif %}\n"
+  "{% endfor %}";
+
+static const char* filter_template =
+  "{{ products | map: 'title' | join: ', ' }}";
+
+static const char* logic_template =
+  "{% for p in products %}"
+  "{% if p.price > 20 and p.available or p.price == 0 %}x{% endif %}"
+  "{% endfor %}";
+
+#define EXPECT_ALLOCATIONS_LE(stats, n) \
+  EXPECT_LE(stats.allocations, size_t(n)) << "bytes: " << stats.bytes
+
+TEST(Allocations, parse) {
+
+  EXPECT_ALLOCATIONS_LE(count_parse(hello_template), 24);
+  EXPECT_ALLOCATIONS_LE(count_parse(loop_template), 60);
+  EXPECT_ALLOCATIONS_LE(count_parse(filter_template), 40);
+  EXPECT_ALLOCATIONS_LE(count_parse(logic_template), 85);
+}
+
+TEST(Allocations, render) {
+
+  liquid::Renderer renderer;
+  liquid::Map data = make_data();
+
+  EXPECT_ALLOCATIONS_LE(count_render(renderer, liquid::parse(hello_template), data), 4);
+  EXPECT_ALLOCATIONS_LE(count_render(renderer, liquid::parse(loop_template), data), 50);
+  EXPECT_ALLOCATIONS_LE(count_render(renderer, liquid::parse(filter_template), data), 10);
+  EXPECT_ALLOCATIONS_LE(count_render(renderer, liquid::parse(logic_template), data), 42);
+}
+
+TEST(Allocations, counter) {
+
+  allocation_counter::Scope scope;
+  // called directly so that the pair cannot be elided by the optimizer
+  void* ptr = ::operator new(sizeof(int));
+  ::operator delete(ptr);
+
+  ASSERT_EQ(scope.stats().allocations, size_t(1));
+  ASSERT_EQ(scope.stats().deallocations, size_t(1));
+  ASSERT_EQ(scope.stats().bytes, sizeof(int));
+}
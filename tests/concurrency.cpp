@@ -0,0 +1,80 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "liquid/liquid.h"
+
+#include "liquid/renderer.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+// Rendering is expected to be safe when several renderers share the same
+// Template and the same data, as long as the template does not write into
+// the data (e.g. with a 'global' assign).
+// Build with LIQUID_ENABLE_THREAD_SANITIZER to check for data races.
+
+TEST(Concurrency, shared_template_and_data) {
+
+  std::string str =
+    "{% for p in products %}"
+    "{{ forloop.index }}: {{ p.name }}"
+    "{% if p.price > 10 and p.available %} ({{ p.price }}){% endif %}"
+    "{% assign tags = p.tags | push: 'x' %}{{ tags | join: ',' }}\n"
+    "{% endfor %}"
+    "{{ products | map: 'name' | join: ', ' }}"
+    "{% include footer with text = owner.name %}";
+
+  liquid::Template tmplt = liquid::parse(str);
+  liquid::Template footer = liquid::parse("-- {{ include.text }}");
+
+  liquid::Array products;
+
+  for (int i(0); i < 20; ++i)
+  {
+    liquid::Map p;
+    p["name"] = "product" + std::to_string(i);
+    p["price"] = i * 3;
+    p["available"] = (i % 3 != 0);
+    p["tags"] = liquid::Array({ liquid::Value("a"), liquid::Value("b") });
+    products.push(p);
+  }
+
+  liquid::Map data;
+  data["products"] = products;
+  data["owner"] = liquid::Map{ { "name", "Alice" } };
+
+  std::string expected;
+
+  {
+    liquid::Renderer renderer;
+    renderer.templates()["footer"] = footer;
+    expected = renderer.render(tmplt, data);
+    ASSERT_TRUE(renderer.errors().empty());
+  }
+
+  const int nb_threads = 8;
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(nb_threads, 0);
+
+  for (int i(0); i < nb_threads; ++i)
+  {
+    threads.emplace_back([&, i]() {
+      liquid::Renderer renderer;
+      renderer.templates()["footer"] = footer;
+
+      for (int j(0); j < 50; ++j)
+      {
+        if (renderer.render(tmplt, data) != expected)
+          ++mismatches[i];
+      }
+    });
+  }
+
+  for (std::thread& t : threads)
+    t.join();
+
+  for (int n : mismatches)
+    ASSERT_EQ(n, 0);
+}
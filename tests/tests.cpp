@@ -240,12 +240,14 @@ TEST(Liquid, discard) {
 
 #include "liquid/renderer.h"
 #include "liquid/filter.h"
+#include "liquid/parser.h"
 
 #include <cctype>
 
 class CustomRenderer : public liquid::Renderer
 {
 public:
+  CustomRenderer() { setVirtualFilterDispatch(); }
 
   liquid::Value applyFilter(const std::string& name, const liquid::Value& object, const std::vector<liquid::Value>& args) override;
 };
@@ -276,6 +278,10 @@ liquid::Value CustomRenderer::applyFilter(const std::string& name, const liquid:
     return liquid::filters::apply(filter_mul, object, args);
   else if (name == "substr")
     return liquid::filters::apply(filter_substr, object, args);
+  else if (name == "upcase")
+    return "<" + filter_uppercase(object.as<std::string>()) + ">";
+  else if (name == "truncate")
+    return "truncate/" + std::to_string(args.size());
 
   return Renderer::applyFilter(name, object, args);
 }
@@ -291,6 +297,119 @@ TEST(Liquid, filters) {
   std::string result = tmplt.render<CustomRenderer>(data);
 
   ASSERT_EQ(result, "Hello BOB, your account now contains 10 dollars.");
+
+  // filters with a builtin name are dispatched to the renderer
+  tmplt = liquid::parse("{{ 'abc' | upcase }} {{ 'abc' | truncate: 1, '', 2 }}");
+  ASSERT_EQ(tmplt.render<CustomRenderer>(data), "<ABC> truncate/3");
+  ASSERT_EQ(liquid::parse("{{ 'abc' | upcase }}").render(data), "ABC");
+
+  // builtins dispatched through applyFilter() keep their raw output
+  data["html"] = "<i>";
+  tmplt = liquid::parse("{{ html | raw }}{{ html | json }}");
+  CustomRenderer custom;
+  custom.setEscaping(liquid::Renderer::HtmlEscaping);
+  ASSERT_EQ(custom.render(tmplt, data), "<i>&quot;&lt;i&gt;&quot;");
+
+  // derived renderers that do not dispatch filters keep the fast paths
+  class DerivedRenderer : public liquid::Renderer { };
+  DerivedRenderer derived;
+  ASSERT_FALSE(derived.virtualFilterDispatch());
+  derived.setEscaping(liquid::Renderer::HtmlEscaping);
+  ASSERT_EQ(derived.render(tmplt, data), "<i>&quot;&lt;i&gt;&quot;");
+  ASSERT_EQ(derived.render(liquid::parse("{{ 'abc' | upcase }}"), data), "ABC");
+}
+
+TEST(Liquid, filter_registry) {
+
+  liquid::FilterRegistry filters = liquid::FilterRegistry::builtins();
+  filters.add("uppercase", filter_uppercase);
+  filters.add("mul", filter_mul);
+  filters.add("substr", filter_substr);
+
+  liquid::Template tmplt = liquid::parse("{{ 'Bob2' | substr: 0, 3 | uppercase }}{{ money | mul: 2 }}{{ names | join: '-' }}", filters);
+
+  liquid::Map data = {};
+  data["money"] = 5;
+  data["names"] = liquid::Array({ liquid::Value("a"), liquid::Value("b") });
+  std::string result = tmplt.render(data);
+
+  ASSERT_EQ(result, "BOB10a-b");
+
+  ASSERT_THROW(liquid::parse("{{ name | lowercase }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ money | mul }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ names | join: ',', ';' }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ money | mul: 'two' }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ 'abc' | first }}", filters), liquid::ParserException);
+
+  // unknown filters and invalid filter expressions are only reported in strict mode
+  ASSERT_NO_THROW(liquid::parse("{{ name | lowercase }}"));
+  ASSERT_NO_THROW(liquid::parse("{{ names | join: ',', ';' }}"));
+  ASSERT_NO_THROW(liquid::parse("{{ 'abc' | first }}"));
+  liquid::Renderer renderer;
+  renderer.render(liquid::parse("{{ names | join: ',', ';' }}"), data);
+  ASSERT_EQ(renderer.errors().size(), 1);
+
+  data["money"] = "5";
+  result = tmplt.render(data);
+  ASSERT_EQ(result, "BOB{! Filter 'mul' expects an int as input !}");
+}
+
+static std::string filter_surround(const std::string& str, const std::string& left, int count, const std::string& right)
+{
+  std::string result;
+
+  for (int i(0); i < count; ++i)
+    result += left;
+
+  result += str;
+
+  for (int i(0); i < count; ++i)
+    result += right;
+
+  return result;
+}
+
+static int filter_count(const liquid::Array& list, const liquid::Value& val)
+{
+  int n = 0;
+
+  for (size_t i(0); i < list.length(); ++i)
+    n += liquid::compare(list.at(i), val) == 0 ? 1 : 0;
+
+  return n;
+}
+
+TEST(Liquid, filter_apply) {
+
+  std::vector<liquid::Value> args{ liquid::Value("<"), liquid::Value(2), liquid::Value(">") };
+  liquid::Value result = liquid::filters::apply(filter_surround, liquid::Value("a"), args);
+  ASSERT_EQ(result.as<std::string>(), "<<a>>");
+
+  liquid::Value list = liquid::Array({ liquid::Value(1), liquid::Value(2), liquid::Value(1) });
+  std::vector<liquid::Value> one{ liquid::Value(1) };
+  ASSERT_EQ(liquid::filters::apply(filter_count, list, one).as<int>(), 2);
+
+  ASSERT_THROW(liquid::filters::apply(filter_count, list, {}), liquid::EvaluationException);
+  ASSERT_THROW(liquid::filters::apply(filter_count, liquid::Value(1), one), liquid::EvaluationException);
+  ASSERT_THROW(liquid::filters::apply(filter_surround, liquid::Value("a"), one), liquid::EvaluationException);
+
+  liquid::FilterRegistry filters;
+  filters.add("surround", filter_surround);
+  filters.add("count", filter_count);
+
+  auto surround = filters.find("surround");
+  ASSERT_EQ(surround->inputType, liquid::FilterRegistry::String);
+  ASSERT_EQ(surround->argumentTypes.size(), 3);
+  ASSERT_EQ(surround->argumentTypes.at(1), liquid::FilterRegistry::Int);
+  ASSERT_EQ(filters.find("count")->inputType, liquid::FilterRegistry::Array);
+
+  liquid::Template tmplt = liquid::parse("{{ name | surround: '[', 3, ']' }} {{ numbers | count: 1 }}", filters);
+
+  liquid::Map data = {};
+  data["name"] = "Bob";
+  data["numbers"] = list;
+
+  ASSERT_EQ(tmplt.render(data), "[[[Bob]]] 2");
 }
 
 TEST(Liquid, array_push_pop) {
@@ -472,3 +591,1036 @@ TEST(Liquid, error) {
 
   ASSERT_EQ(tmplt.getLine(renderer.errors().front().offset), "{% assign age = 20 %}{{ age.bad_property }}");
 }
+
+#include "liquid/trace.h"
+
+TEST(Liquid, trace) {
+
+  liquid::Renderer renderer;
+  renderer.templates()["card"] = liquid::parse("[{{ include.p.title }}]");
+
+  liquid::Template tmplt = liquid::parse("{% for p in products %}{% if p.vendor == 'Acme' %}{% include card with p = p %}{% endif %}{% endfor %}", "page");
+
+  liquid::Array products;
+  products.push(liquid::Map{ {"title", "Rocket"}, {"vendor", "Acme"}, {"price", 10} });
+  products.push(liquid::Map{ {"title", "Anvil"}, {"vendor", "Other"}, {"price", 20} });
+
+  liquid::Map data;
+  data["products"] = products;
+  data["secret"] = "not used";
+
+  renderer.setRecording(true);
+  std::string result = renderer.render(tmplt, data);
+  ASSERT_EQ(result, "[Rocket]");
+
+  liquid::Trace trace = liquid::Trace::fromJson(renderer.trace().toJson());
+
+  ASSERT_EQ(trace.filePath, "page");
+  ASSERT_EQ(trace.partials.size(), 1);
+  ASSERT_TRUE(trace.data["secret"].isNull());
+  ASSERT_TRUE(trace.data["products"].at(0).property("price").isNull());
+  ASSERT_EQ(trace.data["products"].at(1).property("vendor").as<std::string>(), "Other");
+
+  liquid::Renderer replay;
+
+  for (const auto& p : trace.partials)
+    replay.templates()[p.first] = liquid::parse(p.second, p.first);
+
+  ASSERT_EQ(replay.render(liquid::parse(trace.source, trace.filePath), trace.data), result);
+
+  trace.anonymize();
+  ASSERT_EQ(trace.data["products"].at(0).property("vendor").as<std::string>(), "Acme");
+  ASSERT_NE(trace.data["products"].at(0).property("title").as<std::string>(), "Rocket");
+  ASSERT_EQ(trace.data["products"].at(0).property("title").as<std::string>().size(), 6);
+}
+
+#include "liquid/filters.h"
+#include "liquid/cache_p.h"
+#include "liquid/simd_p.h"
+#include "liquid/thread-pool_p.h"
+#include "liquid/utf8_p.h"
+
+TEST(Liquid, string_filters) {
+
+  auto render = [](const std::string& str) -> std::string {
+    liquid::Map data;
+    data["text"] = "  Hello World\n";
+    data["items"] = liquid::Array(std::vector<liquid::Value>{ 1, 2, 3 });
+    data["offset"] = -3;
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{{ 'Hello' | upcase }}{{ 'Hello' | downcase }}{{ 'hELLO' | capitalize }}"), "HELLOhelloHello");
+  ASSERT_EQ(render("[{{ text | strip }}][{{ text | lstrip }}][{{ text | rstrip }}]"), "[Hello World][Hello World\n][  Hello World]");
+  ASSERT_EQ(render("{{ 'a-b-c' | replace: '-', '--' }} {{ 'a-b-c' | remove: '-' }}"), "a--b--c abc");
+  ASSERT_EQ(render("{{ 'a,b,,c,,' | split: ',' | join: '|' }} {{ 'abc' | split: '' | join: '.' }}"), "a|b||c a.b.c");
+  ASSERT_EQ(render("{{ 'Hello World' | truncate: 8 }} {{ 'Hello' | truncate: 8 }} {{ 'Hello World' | truncate: 5, '' }}"), "Hello... Hello Hello");
+  ASSERT_EQ(render("{{ 'one  two three' | truncatewords: 2 }} {{ 'one two' | truncatewords: 2, '!' }}"), "one two... one two");
+  ASSERT_EQ(render("{{ 'Liquid' | slice: 0 }} {{ 'Liquid' | slice: 2, 3 }} {{ 'Liquid' | slice: offset, 2 }}"), "L qui ui");
+  ASSERT_EQ(render("{{ 'b' | prepend: 'a' | append: 'c' }} {{ 1 | append: 2 }}"), "abc 12");
+  ASSERT_EQ(render("{{ 'Hello' | size }} {{ items | size }}"), "5 3");
+  ASSERT_EQ(render("{{ text | newline_to_br }}"), "  Hello World<br />\n");
+
+  ASSERT_THROW(liquid::parse("{{ 'a' | slice }}", liquid::FilterRegistry::builtins()), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ 'a' | truncate: 1, '', 2 }}", liquid::FilterRegistry::builtins()), liquid::ParserException);
+}
+
+TEST(Liquid, simd_kernels) {
+
+  const liquid::simd::Kernels& scalar = *liquid::simd::kernels(liquid::simd::Scalar);
+
+  std::string input;
+
+  for (int i(0); i < 1000; ++i)
+    input.push_back(" \tab\nAZ-z{@`\r\x80\xff"[(i * 7 + i / 13) % 15]);
+
+  input[600] = '<';
+  input[700] = '\'';
+
+  for (liquid::simd::Level level : { liquid::simd::SSE2, liquid::simd::AVX2 })
+  {
+    const liquid::simd::Kernels* k = liquid::simd::kernels(level);
+
+    if (!k)
+      continue;
+
+    for (size_t offset : { 0, 1, 7, 33 })
+    {
+      for (size_t n : { 0, 1, 15, 16, 17, 31, 32, 33, 64, 100, 900 })
+      {
+        const char* str = input.data() + offset;
+
+        std::string expected(n, '\0'), actual(n, '\0');
+        scalar.to_upper(str, n, &expected[0]);
+        k->to_upper(str, n, &actual[0]);
+        ASSERT_EQ(actual, expected);
+        scalar.to_lower(str, n, &expected[0]);
+        k->to_lower(str, n, &actual[0]);
+        ASSERT_EQ(actual, expected);
+
+        ASSERT_EQ(k->skip_spaces(str, n), scalar.skip_spaces(str, n));
+        ASSERT_EQ(k->skip_spaces_backward(str, n), scalar.skip_spaces_backward(str, n));
+        ASSERT_EQ(k->find_char(str, n, '@'), scalar.find_char(str, n, '@'));
+        ASSERT_EQ(k->find_char(str, n, '!'), scalar.find_char(str, n, '!'));
+        ASSERT_EQ(k->find_html_special(str, n), scalar.find_html_special(str, n));
+        ASSERT_EQ(k->find_json_special(str, n), scalar.find_json_special(str, n));
+        ASSERT_EQ(k->find_url_reserved(str, n), scalar.find_url_reserved(str, n));
+        ASSERT_EQ(k->count_url_reserved(str, n), scalar.count_url_reserved(str, n));
+        ASSERT_EQ(k->find_url_escape(str, n), scalar.find_url_escape(str, n));
+
+        ASSERT_EQ(k->utf8_validate(str, n), scalar.utf8_validate(str, n));
+        ASSERT_EQ(k->utf8_count(str, n), scalar.utf8_count(str, n));
+
+        std::string expected64(4 * ((n + 2) / 3), '\0'), actual64(expected64.size(), '\0');
+        scalar.base64_encode(str, n, &expected64[0]);
+        k->base64_encode(str, n, &actual64[0]);
+        ASSERT_EQ(actual64, expected64);
+
+        for (const std::string& needle : { std::string("AZ"), std::string("b\nA"), input.substr(500, 20), std::string("zz") })
+          ASSERT_EQ(k->find(str, n, needle.data(), needle.size()), scalar.find(str, n, needle.data(), needle.size()));
+      }
+    }
+
+    std::string spaces(100, ' ');
+    ASSERT_EQ(k->skip_spaces(spaces.data(), spaces.size()), 100);
+    ASSERT_EQ(k->skip_spaces_backward(spaces.data(), spaces.size()), 0);
+
+    std::string text(100, '\x7f');
+    text[70] = '\x1f';
+    ASSERT_EQ(k->find_json_special(text.data(), text.size()), 70);
+    text[40] = '\\';
+    ASSERT_EQ(k->find_json_special(text.data(), text.size()), 40);
+
+    std::string url(100, 'a');
+    url[20] = '*';
+    url[30] = '_';
+    url[50] = ' ';
+    url[80] = '/';
+    ASSERT_EQ(k->find_url_reserved(url.data(), url.size()), 50);
+    ASSERT_EQ(k->count_url_reserved(url.data(), url.size()), 1);
+    url[60] = '+';
+    ASSERT_EQ(k->find_url_escape(url.data(), url.size()), 60);
+
+    // every lead byte followed by every second byte, with the sequence
+    // starting before, on and after a block boundary
+    for (size_t pos : { 13, 30, 31, 62 })
+    {
+      for (int lead(0x80); lead < 0x100; ++lead)
+      {
+        for (int second(0); second < 0x100; second += (second < 0x78 ? 0x3C : 1))
+        {
+          std::string seq(70, 'a');
+          seq[pos] = static_cast<char>(lead);
+          seq[pos + 1] = static_cast<char>(second);
+          seq[pos + 2] = '\x80';
+          seq[pos + 3] = '\xBF';
+          ASSERT_EQ(k->utf8_validate(seq.data(), seq.size()), scalar.utf8_validate(seq.data(), seq.size()));
+          ASSERT_EQ(k->utf8_validate(seq.data(), pos + 2), scalar.utf8_validate(seq.data(), pos + 2));
+          ASSERT_EQ(k->utf8_validate(seq.data(), pos + 3), scalar.utf8_validate(seq.data(), pos + 3));
+        }
+      }
+    }
+
+    const std::string multilingual = "d\xC3\xA9j\xC3\xA0 \xE6\x97\xA5\xE6\x9C\xAC \xF0\x9F\x98\x80 ";
+
+    for (size_t n(0); n < 200; ++n)
+    {
+      std::string text;
+
+      while (text.size() < n)
+        text += multilingual;
+
+      ASSERT_TRUE(k->utf8_validate(text.data(), text.size()));
+      ASSERT_EQ(k->utf8_validate(text.data(), n), scalar.utf8_validate(text.data(), n));
+    }
+  }
+}
+
+TEST(Liquid, encoding_filters) {
+
+  using liquid::StringFilters;
+
+  ASSERT_EQ(StringFilters::url_encode("john@liquid.com"), "john%40liquid.com");
+  ASSERT_EQ(StringFilters::url_encode("Tetsuro Takara"), "Tetsuro+Takara");
+  ASSERT_EQ(StringFilters::url_encode("a-b_c.d*e~\xC3\xA9"), "a-b_c.d*e%7E%C3%A9");
+  ASSERT_EQ(StringFilters::url_decode("%27Stop%21%27+said+Fred"), "'Stop!' said Fred");
+  ASSERT_EQ(StringFilters::url_decode("100% %4"), "100% %4");
+  ASSERT_EQ(StringFilters::url_decode("%c3%A9"), "\xC3\xA9");
+
+  ASSERT_EQ(StringFilters::escape_once("1 < 2 &amp; 3 &#39; &lt;"), "1 &lt; 2 &amp; 3 &#39; &lt;");
+  ASSERT_EQ(StringFilters::escape_once("& &; &#; &x"), "&amp; &amp;; &amp;#; &amp;x");
+
+  ASSERT_EQ(StringFilters::base64_encode(""), "");
+  ASSERT_EQ(StringFilters::base64_encode("f"), "Zg==");
+  ASSERT_EQ(StringFilters::base64_encode("fo"), "Zm8=");
+  ASSERT_EQ(StringFilters::base64_encode("foo"), "Zm9v");
+  ASSERT_EQ(StringFilters::base64_encode("one two three"), "b25lIHR3byB0aHJlZQ==");
+  ASSERT_EQ(StringFilters::base64_decode("b25lIHR3byB0aHJlZQ=="), "one two three");
+  ASSERT_EQ(StringFilters::base64_decode("Zm8="), "fo");
+  ASSERT_THROW(StringFilters::base64_decode("Zm8"), liquid::EvaluationException);
+  ASSERT_THROW(StringFilters::base64_decode("Zm=v"), liquid::EvaluationException);
+  ASSERT_THROW(StringFilters::base64_decode("Zm8!"), liquid::EvaluationException);
+
+  std::string bytes;
+
+  for (int i(0); i < 1000; ++i)
+  {
+    bytes.push_back(static_cast<char>(i * 37 + i / 256));
+    ASSERT_EQ(StringFilters::base64_decode(StringFilters::base64_encode(bytes)), bytes);
+    ASSERT_EQ(StringFilters::url_decode(StringFilters::url_encode(bytes)), bytes);
+  }
+
+  liquid::Template tmplt = liquid::parse("<a href=\"/search?q={{ q | url_encode }}\">{{ q | base64_encode }}</a>");
+  liquid::Map data;
+  data["q"] = "a&b c";
+  ASSERT_EQ(tmplt.render(data), "<a href=\"/search?q=a%26b+c\">YSZiIGM=</a>");
+}
+
+TEST(Liquid, utf8_strings) {
+
+  using liquid::StringFilters;
+
+  const std::string word = "h\xC3\xA9llo \xE4\xB8\x96\xE7\x95\x8C";
+
+  ASSERT_EQ(liquid::utf8::length(word.data(), word.size()), 8);
+  ASSERT_TRUE(liquid::utf8::valid(word.data(), word.size()));
+  ASSERT_FALSE(liquid::utf8::valid(word.data(), word.size() - 1));
+  ASSERT_EQ(StringFilters::size(word), 8);
+  ASSERT_EQ(StringFilters::slice(word, 1, 1), "\xC3\xA9");
+  ASSERT_EQ(StringFilters::slice(word, -2, 5), "\xE4\xB8\x96\xE7\x95\x8C");
+  ASSERT_EQ(StringFilters::truncate(word, 7, "."), "h\xC3\xA9llo .");
+  ASSERT_EQ(StringFilters::truncate(word, 7, "\xE2\x80\xA6"), "h\xC3\xA9llo \xE2\x80\xA6");
+  ASSERT_EQ(StringFilters::truncate(word, 8, "."), word);
+
+  // not valid UTF-8: one character per byte
+  const std::string latin1 = "caf\xE9 cr\xE8me";
+  ASSERT_EQ(StringFilters::size(latin1), 10);
+  ASSERT_EQ(StringFilters::slice(latin1, 3, 1), "\xE9");
+
+  // long strings are indexed
+  std::string description;
+
+  for (int i(0); i < 100; ++i)
+    description += word;
+
+  liquid::utf8::Index index{ description.data(), description.size() };
+  ASSERT_EQ(index.length(), 800);
+
+  for (size_t i(0); i <= 800; ++i)
+    ASSERT_EQ(index.offset(i), liquid::utf8::offset(description.data(), description.size(), i));
+
+  liquid::Template tmplt = liquid::parse("{{ text.size }} {{ text | size }} {% for i in positions %}{{ text | slice: i }}{% endfor %} {{ text | strip | truncate: 5, '' }}");
+  liquid::Map data;
+  data["text"] = description;
+  data["positions"] = liquid::Array::fromInts({ 1, 6, 7, 791 });
+  ASSERT_EQ(tmplt.render(data), "800 800 \xC3\xA9\xE4\xB8\x96\xE7\x95\x8C\xE7\x95\x8C h\xC3\xA9llo");
+}
+
+TEST(Liquid, escaping) {
+
+  liquid::Template tmplt = liquid::parse("<p>{{ text }}</p>{{ text | raw }}{{ text | safe | upcase }}{{ quotes }}");
+
+  liquid::Map data;
+  data["text"] = "<b>Tom & Jerry</b>";
+  data["quotes"] = "'\"&";
+
+  liquid::Renderer renderer;
+  ASSERT_EQ(renderer.render(tmplt, data), "<p><b>Tom & Jerry</b></p><b>Tom & Jerry</b><B>TOM & JERRY</B>'\"&");
+
+  renderer.setEscaping(liquid::Renderer::HtmlEscaping);
+  ASSERT_EQ(renderer.render(tmplt, data), "<p>&lt;b&gt;Tom &amp; Jerry&lt;/b&gt;</p><b>Tom & Jerry</b>&lt;B&gt;TOM &amp; JERRY&lt;/B&gt;&#39;&quot;&amp;");
+
+  renderer.setEscaping([](const std::string& str) -> std::string {
+    return "[" + str + "]";
+  });
+  ASSERT_EQ(renderer.escaping(), liquid::Renderer::CustomEscaping);
+  ASSERT_EQ(renderer.render(tmplt, data), "<p>[<b>Tom & Jerry</b>]</p><b>Tom & Jerry</b>[<B>TOM & JERRY</B>]['\"&]");
+
+  ASSERT_EQ(liquid::parse("{{ '1 < 2' | escape }}").render(data), "1 &lt; 2");
+
+  // derived renderers, with or without virtual filter dispatch
+  class EscapingRenderer : public liquid::Renderer { };
+
+  tmplt = liquid::parse("{{ text | raw }}{{ text | json }}{{ text | json | raw }}");
+  const std::string expected = "<b>Tom & Jerry</b>&quot;&lt;b&gt;Tom &amp; Jerry&lt;/b&gt;&quot;\"<b>Tom & Jerry</b>\"";
+  EscapingRenderer derived;
+  CustomRenderer custom;
+  ASSERT_FALSE(derived.virtualFilterDispatch());
+  ASSERT_TRUE(custom.virtualFilterDispatch());
+
+  for (liquid::Renderer* r : std::vector<liquid::Renderer*>{ &renderer, &derived, &custom })
+  {
+    r->setEscaping(liquid::Renderer::HtmlEscaping);
+    ASSERT_EQ(r->render(tmplt, data), expected);
+    r->setEscaping(liquid::Renderer::NoEscaping);
+    ASSERT_EQ(r->render(tmplt, data), "<b>Tom & Jerry</b>\"<b>Tom & Jerry</b>\"\"<b>Tom & Jerry</b>\"");
+  }
+}
+
+TEST(Liquid, collection_filters) {
+
+  liquid::Array products;
+  products.push(liquid::Map{ {"title", "Rocket"}, {"type", "toy"}, {"available", true} });
+  products.push(liquid::Map{ {"title", "Anvil"}, {"type", "tool"}, {"available", false} });
+  products.push(liquid::Map{ {"title", "Kite"}, {"type", "toy"}, {"available", true} });
+
+  liquid::Map data;
+  data["products"] = products;
+  data["numbers"] = liquid::Array(std::vector<liquid::Value>{ 1, 2.0, 2, nullptr, 3, 1, nullptr });
+  data["start"] = -2;
+
+  auto render = [&data](const std::string& str) -> std::string {
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{{ products | where: 'type', 'toy' | map: 'title' | join: ',' }}"), "Rocket,Kite");
+  ASSERT_EQ(render("{{ products | where: 'available' | size }}"), "2");
+  ASSERT_EQ(render("{{ numbers | compact | join: ',' }}"), "");
+  ASSERT_EQ(render("{{ numbers | compact | size }} {{ numbers | uniq | size }}"), "5 4");
+  ASSERT_EQ(render("{{ products | reverse | map: 'title' | join: ',' }}"), "Kite,Anvil,Rocket");
+  ASSERT_EQ(render("{{ products | slice: 1, 5 | map: 'title' | join: ',' }}"), "Anvil,Kite");
+  ASSERT_EQ(render("{{ products | reverse | slice: start, 2 | reverse | map: 'title' | join: ',' }}"), "Rocket,Anvil");
+  ASSERT_EQ(render("{% assign p = products | slice: 0, 2 | reverse | first %}{{ p.title }}{{ products | slice: 5 | first }}"), "Anvil");
+
+  liquid::Array a = liquid::ArrayFilters::uniq(liquid::Array(std::vector<liquid::Value>{ products, liquid::ArrayFilters::slice(products, 0, 3), 1.5, 1.25 }));
+  ASSERT_EQ(a.length(), 3);
+  ASSERT_EQ(liquid::hash(products), liquid::hash(liquid::ArrayFilters::reverse(liquid::ArrayFilters::reverse(products))));
+
+  // strings are compared and hashed up to their last character, null characters included
+  const std::string ab{ "a\0b", 3 }, ac{ "a\0c", 3 };
+  a = liquid::ArrayFilters::uniq(liquid::Array(std::vector<liquid::Value>{ ab, ac, ab, std::string("a") }));
+  ASSERT_EQ(a.length(), 3);
+  ASSERT_LT(liquid::compare(ab, ac), 0);
+  ASSERT_EQ(liquid::hash(ab), liquid::hash(std::string(ab)));
+}
+
+TEST(Liquid, sort_filters) {
+
+  liquid::Array products;
+  products.push(liquid::Map{ {"title", "rocket"}, {"price", 20} });
+  products.push(liquid::Map{ {"title", "Anvil"}, {"price", 10.5} });
+  products.push(liquid::Map{ {"title", "kite"} });
+  products.push(liquid::Map{ {"title", "Bike"}, {"price", 10.5} });
+
+  liquid::Map data;
+  data["products"] = products;
+  data["words"] = liquid::Array(std::vector<liquid::Value>{ "b", "C", "a", "B" });
+
+  auto render = [&data](const std::string& str) -> std::string {
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{{ words | sort | join: ',' }} {{ words | sort_natural | join: ',' }}"), "B,C,a,b a,b,B,C");
+  ASSERT_EQ(render("{{ products | sort: 'price' | map: 'title' | join: ',' }}"), "Anvil,Bike,rocket,kite");
+  ASSERT_EQ(render("{{ products | sort: 'title' | map: 'title' | join: ',' }}"), "Anvil,Bike,kite,rocket");
+  ASSERT_EQ(render("{{ products | sort_natural: 'title' | map: 'title' | join: ',' }}"), "Anvil,Bike,kite,rocket");
+
+  const size_t threshold = liquid::ArrayFilters::parallelSortThreshold();
+  liquid::ArrayFilters::setParallelSortThreshold(16);
+
+  std::vector<liquid::Value> numbers;
+
+  for (int i(0); i < 1000; ++i)
+    numbers.push_back(liquid::Map{ {"key", (i * 7919) % 101}, {"index", i} });
+
+  liquid::Array sorted = liquid::ArrayFilters::sort(liquid::Array(numbers), "key");
+  liquid::ArrayFilters::setParallelSortThreshold(threshold);
+
+  ASSERT_EQ(sorted.length(), numbers.size());
+
+  for (size_t i(1); i < sorted.length(); ++i)
+  {
+    const int prev_key = sorted.at(i - 1).property("key").as<int>();
+    const int key = sorted.at(i).property("key").as<int>();
+    ASSERT_LE(prev_key, key);
+
+    if (prev_key == key)
+    {
+      ASSERT_LT(sorted.at(i - 1).property("index").as<int>(), sorted.at(i).property("index").as<int>());
+    }
+  }
+}
+
+TEST(Liquid, lookup_filters) {
+
+  liquid::Array customers;
+  customers.push(liquid::Map{ {"id", 1}, {"name", "Alice"}, {"city", "Paris"} });
+  customers.push(liquid::Map{ {"id", 2}, {"name", "Bob"}, {"city", "Lyon"} });
+  customers.push(liquid::Map{ {"id", 3}, {"name", "Carol"}, {"city", "Paris"} });
+
+  liquid::Array orders;
+  orders.push(liquid::Map{ {"customer_id", 2}, {"total", 10} });
+  orders.push(liquid::Map{ {"customer_id", 3}, {"total", 5} });
+  orders.push(liquid::Map{ {"customer_id", 4}, {"total", 7} });
+
+  liquid::Map data;
+  data["customers"] = customers;
+  data["orders"] = orders;
+
+  auto render = [&data](const std::string& str) -> std::string {
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{% assign by_id = customers | index_by: 'id' %}{% for o in orders %}{% assign c = by_id[o.customer_id] %}{% if c %}{{ c.name }}{% endif %};{% endfor %}"), "Bob;Carol;;");
+  ASSERT_EQ(render("{% for o in orders %}{% assign c = customers | find: 'id', o.customer_id %}{% if c %}{{ c.name }}{% endif %};{% endfor %}"), "Bob;Carol;;");
+  ASSERT_EQ(render("{% assign by_city = customers | group_by: 'city' %}{{ by_city.Paris | map: 'name' | join: ',' }} {{ by_city.Lyon | size }}"), "Alice,Carol 1");
+
+  std::shared_ptr<liquid::RenderCache::Index> index = liquid::RenderCache::index(customers, "city");
+  ASSERT_EQ(index->keys.size(), 2);
+  ASSERT_NE(liquid::RenderCache::index(customers, "city"), index);
+
+  liquid::RenderCache cache;
+
+  {
+    liquid::RenderCache::Scope scope{ cache };
+    index = liquid::RenderCache::index(customers, "city");
+    ASSERT_EQ(liquid::RenderCache::index(customers, "city"), index);
+    ASSERT_NE(liquid::RenderCache::index(customers, "name"), index);
+  }
+
+  ASSERT_EQ(liquid::RenderCache::current(), nullptr);
+}
+
+TEST(Liquid, numeric_filters) {
+
+  liquid::Map data;
+  data["ints"] = liquid::Array(std::vector<liquid::Value>{ 4, -2, 7, nullptr });
+  data["mixed"] = liquid::Array(std::vector<liquid::Value>{ 1, 2.5, -1 });
+  data["typed"] = liquid::Array::fromInts({ 3, 1, 2 });
+  data["empty"] = liquid::Array();
+  data["products"] = liquid::Array(std::vector<liquid::Value>{ liquid::Map{ {"price", 2} }, liquid::Map{ {"price", 3} }, liquid::Map{} });
+  data["words"] = liquid::Array(std::vector<liquid::Value>{ "a" });
+
+  auto render = [&data](const std::string& str) -> std::string {
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{{ ints | sum }} {{ ints | min }} {{ ints | max }} {{ ints | average }}"), "9 -2 7 3.000000");
+  ASSERT_EQ(render("{{ mixed | sum }} {{ mixed | min }} {{ mixed | max }}"), "2.500000 -1 2.500000");
+  ASSERT_EQ(render("{{ typed | sum }} {{ typed | min }} {{ typed | max }} {{ typed | average }} {{ typed | size }}"), "6 1 3 2.000000 3");
+  ASSERT_EQ(render("{{ empty | sum }}[{{ empty | min }}{{ empty | average }}]"), "0[]");
+  ASSERT_EQ(render("{{ products | sum: 'price' }}"), "5");
+  ASSERT_EQ(render("{{ words | sum }}"), "{! Filter 'sum' expects an array of numbers !}");
+
+  const liquid::simd::Kernels& scalar = *liquid::simd::kernels(liquid::simd::Scalar);
+
+  std::vector<int> ints;
+  std::vector<double> doubles;
+
+  for (int i(0); i < 1000; ++i)
+  {
+    ints.push_back((i * 7919) % 2001 - 1000 + (i == 500 ? 2000000000 : 0));
+    doubles.push_back(ints.back() * 0.5);
+  }
+
+  for (liquid::simd::Level level : { liquid::simd::SSE2, liquid::simd::AVX2 })
+  {
+    const liquid::simd::Kernels* k = liquid::simd::kernels(level);
+
+    if (!k)
+      continue;
+
+    for (size_t n : { 1, 3, 4, 7, 8, 15, 16, 17, 33, 1000 })
+    {
+      ASSERT_EQ(k->sum_int(ints.data(), n), scalar.sum_int(ints.data(), n));
+      ASSERT_EQ(k->sum_double(doubles.data(), n), scalar.sum_double(doubles.data(), n));
+
+      int imin, imax, smin, smax;
+      k->minmax_int(ints.data(), n, &imin, &imax);
+      scalar.minmax_int(ints.data(), n, &smin, &smax);
+      ASSERT_EQ(imin, smin);
+      ASSERT_EQ(imax, smax);
+
+      double dmin, dmax, sdmin, sdmax;
+      k->minmax_double(doubles.data(), n, &dmin, &dmax);
+      scalar.minmax_double(doubles.data(), n, &sdmin, &sdmax);
+      ASSERT_EQ(dmin, sdmin);
+      ASSERT_EQ(dmax, sdmax);
+    }
+  }
+}
+
+#include "liquid/objects.h"
+
+TEST(Liquid, condition_evaluation) {
+
+  liquid::Map data;
+  data["i"] = 3;
+  data["d"] = 3.0;
+  data["s"] = "abc";
+  data["t"] = true;
+  data["f"] = false;
+  data["zero"] = 0;
+  data["a"] = liquid::Array::fromInts({ 1, 2 });
+
+  const std::vector<std::pair<std::string, bool>> conditions = {
+    { "i == 3", true }, { "i != 3", false }, { "i < 4", true }, { "i <= 2", false },
+    { "i > 2", true }, { "i >= 4", false }, { "i == d", true }, { "d < 4", true },
+    { "s == 'abc'", true }, { "s < 'abd'", true }, { "s > 'b'", false }, { "s != ''", true },
+    { "i == s", false }, { "a == a", true }, { "t and i > 2", true }, { "f or zero", false },
+    { "t xor f", true }, { "t xor i", false }, { "not f", true }, { "not s", false },
+    { "zero", false }, { "missing", false }, { "s", true }, { "not zero", true },
+    { "i - 3", false }, { "i + 1", true },
+  };
+
+  liquid::Renderer renderer;
+
+  for (const auto& c : conditions)
+  {
+    liquid::Template tmplt = liquid::parse("{% if " + c.first + " %}1{% else %}0{% endif %}");
+    ASSERT_EQ(renderer.render(tmplt, data), c.second ? "1" : "0") << c.first;
+
+    // the condition path must agree with the value path
+    tmplt = liquid::parse("{% assign r = " + c.first + " %}{% if r %}1{% else %}0{% endif %}");
+    ASSERT_EQ(renderer.render(tmplt, data), c.second ? "1" : "0") << c.first;
+  }
+}
+
+TEST(Liquid, case_tag) {
+
+  liquid::Template tmplt = liquid::parse(
+    "{% for p in products %}"
+    "{% case p.type %} ignored "
+    "{% when 'shirt', 'pants' %}clothes"
+    "{% when 'hat' or 'cap' %}head"
+    "{% when 1 %}one"
+    "{% when 'cap' %}+cap"
+    "{% else %}other"
+    "{% endcase %};"
+    "{% endfor %}");
+
+  const auto& tag = tmplt.nodes().front()->as<liquid::tags::For>().body.front()->as<liquid::tags::Case>();
+  ASSERT_TRUE(tag.hashed);
+  ASSERT_TRUE(tag.hasElse());
+  ASSERT_EQ(tag.whens.size(), 5);
+  ASSERT_EQ(tag.dispatch.size(), 5);
+
+  liquid::Map data;
+  data["products"] = liquid::Array(std::vector<liquid::Value>{
+    liquid::Map{ {"type", "pants"} }, liquid::Map{ {"type", "cap"} }, liquid::Map{ {"type", 1.0} },
+    liquid::Map{ {"type", "shoes"} }, liquid::Map{} });
+
+  ASSERT_EQ(tmplt.render(data), "clothes;head+cap;one;other;other;");
+
+  // values that are not literals are compared one by one
+  tmplt = liquid::parse("{% case x %}{% when y %}y{% when 'b' %}b{% endcase %}|{% case x %}{% when 'c' %}c{% endcase %}");
+  ASSERT_FALSE(tmplt.nodes().front()->as<liquid::tags::Case>().hashed);
+  data["x"] = "b";
+  data["y"] = "b";
+  ASSERT_EQ(tmplt.render(data), "yb|");
+  data["y"] = "a";
+  ASSERT_EQ(tmplt.render(data), "b|");
+
+  tmplt = liquid::parse("{% for i in numbers %}{% case i %}{% when 2 %}{% break %}{% else %}{{ i }}{% endcase %}{% endfor %}");
+  data["numbers"] = liquid::Array::fromInts({ 1, 3, 2, 4 });
+  ASSERT_EQ(tmplt.render(data), "13");
+
+  ASSERT_THROW(liquid::parse("{% when 1 %}"), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{% case x %}{% when %}{% endcase %}"), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{% case x %}{% when 1, %}{% endcase %}"), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{% case x %}{% else %}{% when 1 %}{% endcase %}"), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{% case x %}{% else %}{% else %}{% endcase %}"), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{% if x %}{% endcase %}"), liquid::ParserException);
+}
+
+static int fusion_evaluations = 0;
+
+static liquid::Value count_evaluations(const liquid::Value& val)
+{
+  ++fusion_evaluations;
+  return val;
+}
+
+TEST(Liquid, filter_fusion) {
+
+  liquid::Map data;
+  data["text"] = "  Hello World \n";
+  data["blank"] = "   ";
+  data["accents"] = " \xC3\xA9t\xC3\xA9 \xC3\xA0 Z\xC3\xBCrich ";
+  data["products"] = liquid::Array(std::vector<liquid::Value>{ liquid::Map{ {"title", "A"} }, liquid::Map{ {"title", 2} }, liquid::Map{}, liquid::Map{ {"title", "B"} } });
+  data["n"] = 8;
+
+  // copies of the builtins are not fused
+  liquid::FilterRegistry unfused = liquid::FilterRegistry::builtins();
+
+  for (const char* name : { "map", "join", "strip", "lstrip", "rstrip", "upcase", "downcase", "truncate" })
+    unfused.add(*unfused.find(name));
+
+  const std::vector<std::string> sources = {
+    "{{ products | map: 'title' | join: ', ' }}",
+    "{{ products | map: 'title' | join: 1 }}",
+    "{{ products | map: 'missing' | join: '-' }}",
+    "[{{ text | strip | upcase }}]",
+    "[{{ text | lstrip | downcase | rstrip }}]",
+    "[{{ text | strip | downcase | truncate: n }}]",
+    "[{{ text | upcase | strip | truncate: 4, '' }}]",
+    "[{{ text | strip | truncate: 100 }}]",
+    "[{{ text | strip | truncate: 2, '...' }}]",
+    "[{{ blank | strip | upcase }}]",
+    "[{{ accents | strip | upcase | truncate: n, '.' }}]",
+    "[{{ text | rstrip | upcase | strip | lstrip | downcase | rstrip | upcase | strip | downcase }}]",
+    "{{ n | strip | upcase }}",
+    "{{ text | strip | truncate: blank }}",
+    "{{ n | map: 'title' | join: ',' }}",
+  };
+
+  for (const std::string& src : sources)
+    ASSERT_EQ(liquid::parse(src).render(data), liquid::parse(src, unfused).render(data)) << src;
+
+  ASSERT_EQ(liquid::parse(sources.front()).render(data), "A, B");
+  ASSERT_EQ(liquid::parse(sources.at(5)).render(data), "[hello...]");
+
+  liquid::Template tmplt = liquid::parse("{{ products | map: 'title' | join: ',' }}");
+  ASSERT_EQ(std::dynamic_pointer_cast<liquid::objects::Pipe>(tmplt.nodes().front())->fusion, liquid::objects::Pipe::MapJoin);
+
+  tmplt = liquid::parse("{{ products | map: 'title' | join: ',' }}", unfused);
+  ASSERT_EQ(std::dynamic_pointer_cast<liquid::objects::Pipe>(tmplt.nodes().front())->fusion, liquid::objects::Pipe::NotFused);
+
+  // when fusion does not apply, the values already evaluated are reused
+  liquid::FilterRegistry counted = liquid::FilterRegistry::builtins();
+  counted.add("counted", count_evaluations);
+  unfused.add("counted", count_evaluations);
+
+  for (const char* src : { "{{ n | counted | strip | upcase }}", "{{ n | counted | map: 'title' | join: ',' }}", 
+    "[{{ text | counted | strip | truncate: blank }}]", "[{{ text | counted | upcase | strip | truncate: n, n }}]" })
+  {
+    fusion_evaluations = 0;
+    const std::string result = liquid::parse(src, counted).render(data);
+    ASSERT_EQ(fusion_evaluations, 1) << src;
+    ASSERT_EQ(result, liquid::parse(src, unfused).render(data)) << src;
+  }
+}
+
+TEST(Liquid, array_views) {
+
+  liquid::Map data;
+  data["a"] = liquid::Array(std::vector<liquid::Value>{ 1, 2 });
+  data["b"] = liquid::Array();
+  data["c"] = liquid::Array::fromInts({ 3, 4, 5 });
+  data["persons"] = liquid::Array(std::vector<liquid::Value>{ liquid::Map{ {"name", "Bob"} }, liquid::Map{ {"name", "Eve"} } });
+
+  auto render = [&data](const std::string& str) -> std::string {
+    return liquid::parse(str).render(data);
+  };
+
+  ASSERT_EQ(render("{% assign all = a + b + c %}{{ all.size }} {{ all | sum }} {{ all[2] }}{{ all[4] }}"), "5 15 35");
+  ASSERT_EQ(render("{% assign all = a | concat: c | concat: a %}{{ all | sum }} {{ all | reverse | first }}"), "18 2");
+  ASSERT_EQ(render("{% assign d = c | push: 6 | push: 7 | pop | push: 8 %}{{ d | sum }} {{ d.size }} {{ d | last }} {{ c | pop | pop | pop | pop | size }}"), "26 5 8 0");
+  ASSERT_EQ(render("{{ persons | map: 'name' | reverse | join: ',' }} {{ persons | map: 'name' | sort | last }}"), "Eve,Bob Eve");
+
+  liquid::Array all = liquid::ConcatArrayValue::concat(data["a"].toArray(), data["c"].toArray());
+  ASSERT_FALSE(all.isWritable());
+  ASSERT_EQ(all.impl()->type_index(), std::type_index(typeid(liquid::ConcatArrayValue)));
+
+  // views are copied when written to, their sources are left unchanged
+  all.push(6);
+  all[0] = 0;
+  ASSERT_TRUE(all.isWritable());
+  ASSERT_EQ(all.length(), 6);
+  ASSERT_EQ(all.at(0).as<int>(), 0);
+  ASSERT_EQ(data["a"].toArray().at(0).as<int>(), 1);
+  ASSERT_EQ(data["a"].length(), 2);
+}
+
+TEST(Liquid, persistent_vector) {
+
+  liquid::Array prefix = liquid::Array(std::vector<liquid::Value>{ -1, -2 });
+  liquid::Array list = prefix;
+  std::vector<int> expected = { -1, -2 };
+  std::vector<liquid::Array> snapshots;
+
+  // goes past three levels of the trie, then back
+  for (int i(0); i < 40000; ++i)
+  {
+    list = liquid::ArrayFilters::push(list, i);
+    expected.push_back(i);
+
+    if (i % 997 == 0)
+      snapshots.push_back(list);
+  }
+
+  ASSERT_EQ(list.impl()->type_index(), std::type_index(typeid(liquid::PersistentVectorValue)));
+  ASSERT_EQ(list.length(), expected.size());
+
+  for (size_t i(0); i < expected.size(); i += 7)
+    ASSERT_EQ(list.at(i).as<int>(), expected.at(i));
+
+  while (expected.size() > 1)
+  {
+    list = liquid::ArrayFilters::pop(list);
+    expected.pop_back();
+
+    if (expected.size() % 331 == 0 || expected.size() < 70)
+    {
+      ASSERT_EQ(list.length(), expected.size());
+      ASSERT_EQ(list.at(expected.size() - 1).as<int>(), expected.back());
+      ASSERT_EQ(list.at(expected.size() / 2).as<int>(), expected.at(expected.size() / 2));
+    }
+  }
+
+  ASSERT_EQ(liquid::ArrayFilters::pop(list).length(), 0);
+
+  // earlier versions are left unchanged
+  for (size_t i(0); i < snapshots.size(); ++i)
+  {
+    ASSERT_EQ(snapshots.at(i).length(), i * 997 + 3);
+    ASSERT_EQ(snapshots.at(i).at(i * 997 + 2).as<int>(), static_cast<int>(i * 997));
+  }
+
+  ASSERT_EQ(prefix.length(), 2);
+
+  liquid::Map data;
+  std::vector<int> numbers;
+
+  for (int i(1); i <= 100; ++i)
+    numbers.push_back(i);
+
+  data["numbers"] = liquid::Array::fromInts(numbers);
+  std::string result = liquid::parse("{% assign list = [] %}{% for i in numbers %}{% assign list = list | push: i %}{% endfor %}{% assign list = list | concat: list %}{{ list.size }} {{ list | sum }} {{ list | pop | last }}").render(data);
+  ASSERT_EQ(result, "200 10100 99");
+}
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+TEST(Liquid, map_filter) {
+
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+
+  liquid::FilterRegistry::Filter square;
+  square.name = "square";
+  square.inputType = liquid::FilterRegistry::Int;
+  square.argumentTypes = { liquid::FilterRegistry::Int };
+  square.function = [&mutex, &threads](const liquid::Value& val, liquid::FilterArguments args) -> liquid::Value {
+    {
+      std::lock_guard<std::mutex> lock{ mutex };
+      threads.insert(std::this_thread::get_id());
+    }
+
+    if (val.as<int>() < 0)
+      throw liquid::EvaluationException{ "negative " + std::to_string(val.as<int>()) };
+
+    return val.as<int>() * val.as<int>() + (args.empty() ? 0 : args[0].as<int>());
+  };
+
+  liquid::FilterRegistry filters = liquid::FilterRegistry::builtins();
+  filters.add(square);
+
+  std::vector<int> numbers;
+
+  for (int i(0); i < 1000; ++i)
+    numbers.push_back(i);
+
+  liquid::Map data;
+  data["numbers"] = liquid::Array::fromInts(numbers);
+  data["words"] = liquid::Array(std::vector<liquid::Value>{ "a", "b" });
+
+  const size_t threshold = liquid::ArrayFilters::parallelMapThreshold();
+  liquid::ArrayFilters::setParallelMapThreshold(16);
+
+  liquid::Template tmplt = liquid::parse("{{ numbers | map_filter: 'square', 1 | sum }} {{ numbers | map_filter: 'square' | last }} {{ words | map_filter: 'upcase' | join: ',' }}", filters);
+  ASSERT_EQ(tmplt.render(data), "332834500 998001 A,B");
+  ASSERT_EQ(threads.size(), 1);
+
+  // the order is preserved when the filter is pure
+  filters.setPure("square");
+  ASSERT_TRUE(filters.find("square")->pure);
+  tmplt = liquid::parse("{% assign squares = numbers | map_filter: 'square' %}{{ squares | sum }} {{ squares[10] }} {{ squares | last }}", filters);
+  ASSERT_EQ(tmplt.render(data), "332833500 100 998001");
+
+  if (liquid::ThreadPool::global().size() > 0)
+  {
+    ASSERT_GT(threads.size(), 1);
+  }
+
+  // the first failing element is reported
+  numbers[500] = -2;
+  numbers[900] = -1;
+  data["numbers"] = liquid::Array::fromInts(numbers);
+  ASSERT_EQ(tmplt.render(data), "{! negative -2 !}");
+
+  liquid::ArrayFilters::setParallelMapThreshold(threshold);
+
+  ASSERT_THROW(liquid::parse("{{ numbers | map_filter: 'cube' }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ numbers | map_filter: name }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ numbers | map_filter: 'square', 'two' }}", filters), liquid::ParserException);
+  ASSERT_THROW(liquid::parse("{{ numbers | map_filter: 'square', 1, 2 }}", filters), liquid::ParserException);
+}
+
+#include "liquid/filter-cache.h"
+
+TEST(Liquid, filter_memoization) {
+
+  int calls = 0;
+
+  liquid::FilterRegistry filters = liquid::FilterRegistry::builtins();
+  filters.add("t", [&calls](const liquid::Value& key, liquid::FilterArguments) -> liquid::Value {
+    ++calls;
+    return "<" + liquid::Renderer::defaultStringify(key) + ">";
+  }, liquid::FilterRegistry::Any);
+
+  liquid::Map data;
+  data["key"] = "title";
+  data["one"] = 1;
+  data["real"] = 1.0;
+
+  liquid::Template tmplt = liquid::parse("{{ 'title' | t }}{{ key | t }}{{ 'body' | t }}{{ one | t }}{{ real | t }}{% assign x = 'title' | t %}{{ x }}", filters);
+  liquid::Renderer renderer;
+
+  // impure filters are called every time
+  ASSERT_EQ(renderer.render(tmplt, data), "<title><title><body><1><1.000000><title>");
+  ASSERT_EQ(calls, 6);
+
+  filters.setPure("t");
+  tmplt = liquid::parse(tmplt.source(), filters);
+  calls = 0;
+  ASSERT_EQ(renderer.render(tmplt, data), "<title><title><body><1><1.000000><title>");
+  ASSERT_EQ(calls, 4);
+  ASSERT_EQ(renderer.render(tmplt, data), "<title><title><body><1><1.000000><title>");
+  ASSERT_EQ(calls, 8);
+
+  auto cache = std::make_shared<liquid::FilterCache>(4);
+  renderer.setFilterCache(cache);
+  ASSERT_EQ(renderer.filterCache(), cache);
+
+  calls = 0;
+  renderer.render(tmplt, data);
+  renderer.render(tmplt, data);
+  ASSERT_EQ(calls, 4);
+  ASSERT_EQ(cache->size(), 4);
+  ASSERT_EQ(cache->misses(), 4);
+  ASSERT_EQ(cache->hits(), 4);
+  ASSERT_DOUBLE_EQ(cache->hitRate(), 0.5);
+
+  // the cache can be shared by several renderers
+  liquid::Renderer other;
+  other.setFilterCache(cache);
+  cache->clear();
+  calls = 0;
+  renderer.render(tmplt, data);
+  other.render(tmplt, data);
+  ASSERT_EQ(calls, 4);
+  ASSERT_EQ(cache->hits(), 4);
+
+  // the least recently used result is evicted
+  liquid::FilterCache small{ 2 };
+  std::vector<liquid::Value> args;
+  liquid::Value result;
+  const auto t = filters.find("t");
+  small.insert(liquid::FilterCall(t, "a", args), "A");
+  small.insert(liquid::FilterCall(t, "b", args), "B");
+  ASSERT_TRUE(small.find(liquid::FilterCall(t, "a", args), result));
+  small.insert(liquid::FilterCall(t, "c", args), "C");
+  ASSERT_FALSE(small.find(liquid::FilterCall(t, "b", args), result));
+  ASSERT_TRUE(small.find(liquid::FilterCall(t, "a", args), result));
+  ASSERT_EQ(result.as<std::string>(), "A");
+  ASSERT_EQ(small.size(), 2);
+  ASSERT_FALSE(liquid::FilterCall(t, std::string("x\0y", 3), args) == liquid::FilterCall(t, std::string("x\0z", 3), args));
+
+  // memoized builtins see every byte of their inputs
+  liquid::Map nul;
+  nul["a"] = std::string("\0\x01", 2);
+  nul["b"] = std::string("\0\x05", 2);
+  nul["c"] = std::string("x\0y", 3);
+  nul["d"] = std::string("x\0z", 3);
+  ASSERT_EQ(liquid::parse("{{ a | base64_encode }} {{ b | base64_encode }}").render(nul), "AAE= AAU=");
+  ASSERT_EQ(liquid::parse("{{ c | url_encode }} {{ d | url_encode }}").render(nul), "x%00y x%00z");
+}
+
+#include "liquid/json.h"
+
+TEST(Liquid, json_output) {
+
+  liquid::Map data;
+  data["text"] = std::string("a\"b\\c\nd\x01</script>");
+  data["products"] = liquid::Array(std::vector<liquid::Value>{ liquid::Map{ {"title", "Rocket"}, {"price", 2.5}, {"tags", liquid::Array::fromInts({ 1, -2 })} }, nullptr, true });
+  data["doubles"] = liquid::Array::fromDoubles({ 3, -0.5, 1e20 });
+  data["n"] = -2147483647 - 1;
+
+  auto render = [&data](const std::string& str, liquid::Renderer& renderer) -> std::string {
+    return renderer.render(liquid::parse(str), data);
+  };
+
+  liquid::Renderer renderer;
+  ASSERT_EQ(render("{{ text | json }}", renderer), "\"a\\\"b\\\\c\\nd\\u0001</script>\"");
+  ASSERT_EQ(render("{{ products | json }}", renderer), "[{\"price\":2.5,\"tags\":[1,-2],\"title\":\"Rocket\"},null,true]");
+  ASSERT_EQ(render("{{ doubles | json }} {{ n | json }} {{ products | first | json | size }}", renderer), "[3.0,-0.5,1e+20] -2147483648 44");
+  ASSERT_EQ(render("{% assign j = products | map: 'title' | json %}{{ j }}", renderer), "[\"Rocket\",null,null]");
+
+  // the result of json is escaped like any other string
+  renderer.setEscaping(liquid::Renderer::HtmlEscaping);
+  ASSERT_EQ(render("{{ products | map: 'title' | json }}", renderer), "[&quot;Rocket&quot;,null,null]");
+  ASSERT_EQ(render("{{ products | map: 'title' | json | raw }}", renderer), "[\"Rocket\",null,null]");
+  renderer.setEscaping(liquid::Renderer::NoEscaping);
+
+  ASSERT_EQ(renderer.stringifyMode(), liquid::Renderer::LiquidStringify);
+  ASSERT_EQ(render("{{ doubles }}", renderer), liquid::Renderer::defaultStringify(data["doubles"]));
+
+  renderer.setStringifyMode(liquid::Renderer::JsonStringify);
+  ASSERT_EQ(render("{{ doubles }} {{ text | size }} {{ products[0].title }}", renderer), "[3.0,-0.5,1e+20] 17 Rocket");
+  ASSERT_EQ(renderer.stringify(liquid::Map{ {"a", "\t"} }), "{\"a\":\"\\t\"}");
+
+  // round trip of long strings
+  std::string long_text;
+
+  for (int i(0); i < 1000; ++i)
+    long_text += std::string(i % 37, 'x') + "\"\\\n\x1f";
+
+  ASSERT_EQ(liquid::json::parse(liquid::json::stringify(long_text)).as<std::string>(), long_text);
+
+  // doubles are written with the fewest digits that read back exactly
+  ASSERT_EQ(liquid::json::stringify(0.1), "0.1");
+  ASSERT_EQ(liquid::json::stringify(1.0 / 3.0), "0.3333333333333333");
+  ASSERT_EQ(liquid::json::stringify(0.1 + 0.2), "0.30000000000000004");
+
+  for (double d : { 0.1, 1.0 / 3.0, 0.1 + 0.2, 1e-300, 123456.789, -2.5e17 })
+    ASSERT_EQ(liquid::json::parse(liquid::json::stringify(d)).as<double>(), d);
+}
+
+struct Point
+{
+  int x;
+  int y;
+};
+
+class PointValue : public liquid::IValue
+{
+public:
+  Point point;
+  static int resolutions;
+
+  explicit PointValue(Point pt) : point(pt) { }
+
+  bool is_map() const override { return true; }
+  std::type_index type_index() const override { return std::type_index(typeid(Point)); }
+  void* data() override { return &point; }
+
+  std::set<std::string> propertyNames() const override
+  {
+    return { "x", "y" };
+  }
+
+  liquid::Value property(const std::string& name) const override
+  {
+    return name == "x" ? point.x : (name == "y" ? liquid::Value(point.y) : liquid::Value());
+  }
+
+  int resolve(const std::string& name) const override
+  {
+    ++resolutions;
+    return name == "x" ? 0 : (name == "y" ? 1 : -1);
+  }
+
+  liquid::Value get(int slot) const override
+  {
+    return slot == 0 ? point.x : point.y;
+  }
+};
+
+int PointValue::resolutions = 0;
+
+// a second type with the same slots
+class OtherPointValue : public PointValue
+{
+public:
+  using PointValue::PointValue;
+};
+
+TEST(Liquid, inline_caches) {
+
+  liquid::Array points;
+
+  for (int i(0); i < 100; ++i)
+    points.push(liquid::Value(std::make_shared<PointValue>(Point{ i, -i })));
+
+  liquid::Map data;
+  data["points"] = points;
+
+  // names are resolved once per member access and type
+  liquid::Template tmplt = liquid::parse("{% for p in points %}{% if p.x == 99 %}{{ p.x }},{{ p.y }}{{ p.z }}{% endif %}{% endfor %}");
+  ASSERT_EQ(tmplt.render(data), "99,-99");
+  ASSERT_EQ(PointValue::resolutions, 4);
+  ASSERT_EQ(tmplt.render(data), "99,-99");
+  ASSERT_EQ(PointValue::resolutions, 4);
+
+  // accesses on values of several types
+  liquid::Array mixed;
+  mixed.push(liquid::Value(std::make_shared<PointValue>(Point{ 1, 2 })));
+  mixed.push(liquid::Map{ {"x", "a"}, {"y", "b"} });
+  mixed.push(liquid::Value(std::make_shared<PointValue>(Point{ 3, 4 })));
+  mixed.push(liquid::Map{ {"x", "c"} });
+  data["mixed"] = mixed;
+
+  tmplt = liquid::parse("{% for p in mixed %}{{ p.x }}{{ p.y }};{% endfor %}");
+  ASSERT_EQ(tmplt.render(data), "12;ab;34;c;");
+  ASSERT_EQ(tmplt.render(data), "12;ab;34;c;");
+  ASSERT_EQ(tmplt.render(liquid::Map{ {"mixed", points} }).substr(0, 9), "00;1-1;2-");
+
+  // accesses alternating between two types keep hitting the cache
+  liquid::Array alternating;
+
+  for (int i(0); i < 20; ++i)
+  {
+    if (i % 2 == 0)
+      alternating.push(liquid::Value(std::make_shared<PointValue>(Point{ i, 0 })));
+    else
+      alternating.push(liquid::Value(std::make_shared<OtherPointValue>(Point{ i, 0 })));
+  }
+
+  data["alternating"] = alternating;
+  PointValue::resolutions = 0;
+  tmplt = liquid::parse("{% for p in alternating %}{{ p.x }}{% endfor %}");
+  ASSERT_EQ(tmplt.render(data), "012345678910111213141516171819");
+  ASSERT_EQ(PointValue::resolutions, 2);
+  tmplt.render(data);
+  ASSERT_EQ(PointValue::resolutions, 2);
+
+  // member access chains
+  liquid::Map line;
+  line["a"] = liquid::Value(std::make_shared<PointValue>(Point{ 5, 6 }));
+  data["line"] = line;
+  ASSERT_EQ(liquid::parse("{{ line.a.y }}{{ line.a.size }}").render(data), "6");
+}
@@ -0,0 +1,271 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "corpus.h"
+
+#include <algorithm>
+
+namespace corpus
+{
+
+Random::Random(uint64_t seed)
+  : m_state(seed != 0 ? seed : 0x2545F4914F6CDD1DULL)
+{
+
+}
+
+uint64_t Random::next()
+{
+  // xorshift64*
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545F4914F6CDD1DULL;
+}
+
+int Random::range(int min, int max)
+{
+  const uint64_t n = static_cast<uint64_t>(max - min + 1);
+  return min + static_cast<int>(next() % n);
+}
+
+bool Random::chance(int percent)
+{
+  return range(0, 99) < percent;
+}
+
+std::string Random::word()
+{
+  static const char* syllables[] = {
+    "li", "quid", "ta", "ble", "sho", "pi", "fy", "mo", "ra", "ne",
+    "ko", "san", "del", "tur", "vi", "ox", "pen", "ga", "lu", "der",
+  };
+
+  std::string result;
+  const int n = range(1, 3);
+
+  for (int i(0); i < n; ++i)
+    result += syllables[range(0, 19)];
+
+  return result;
+}
+
+std::string Random::sentence(int nbwords)
+{
+  std::string result;
+
+  for (int i(0); i < nbwords; ++i)
+  {
+    if (i > 0)
+      result.push_back(' ');
+
+    result += word();
+  }
+
+  result.push_back('.');
+  return result;
+}
+
+namespace
+{
+
+/*
+ * Every level of the data is made of nodes with the same properties
+ * (name, value, flag, tags); the nodes iterated by the loop at depth k
+ * have a 'children' array iterated by the loop at depth k + 1.
+ * At the top level, these properties are those of the root map.
+ */
+class Generator
+{
+public:
+  const Shape& shape;
+  Random rng;
+
+  explicit Generator(const Shape& s)
+    : shape(s),
+      rng(s.seed)
+  {
+
+  }
+
+  static std::string subject(int level)
+  {
+    return level == 0 ? std::string() : "item" + std::to_string(level - 1) + ".";
+  }
+
+  void fillNode(liquid::Map& node, int level)
+  {
+    node["name"] = rng.word();
+    node["value"] = rng.range(0, 9);
+    node["flag"] = rng.chance(50);
+
+    liquid::Array tags;
+
+    for (int i(0); i < 4; ++i)
+      tags.push(rng.word());
+
+    node["tags"] = tags;
+
+    if (level < shape.depth)
+      node[level == 0 ? "items" : "children"] = makeChildren(level + 1);
+  }
+
+  liquid::Array makeChildren(int level)
+  {
+    liquid::Array result;
+
+    for (int i(0); i < shape.loopCount; ++i)
+    {
+      liquid::Map node;
+      fillNode(node, level);
+      result.push(node);
+    }
+
+    return result;
+  }
+
+  void writeExpression(std::string& out, int level)
+  {
+    static const char* operators[] = { " + ", " - ", " * " };
+
+    const std::string value = subject(level) + "value";
+    out += value;
+
+    for (int i(1); i < shape.expressionLength; ++i)
+    {
+      out += operators[i % 3];
+
+      if (i % 2 == 0)
+        out += value;
+      else
+        out += std::to_string(rng.range(1, 9));
+    }
+  }
+
+  void writeCondition(std::string& out, int level)
+  {
+    const std::string s = subject(level);
+
+    for (int i(0); i < std::max(shape.expressionLength, 1); ++i)
+    {
+      if (i > 0)
+        out += (i % 2 == 0) ? " or " : " and ";
+
+      switch (i % 3)
+      {
+      case 0:
+        out += s + "value > " + std::to_string(rng.range(0, 9));
+        break;
+      case 1:
+        out += s + "flag";
+        break;
+      default:
+        out += s + "value != " + std::to_string(rng.range(0, 9));
+        break;
+      }
+    }
+  }
+
+  void writeFilterChain(std::string& out, int level)
+  {
+    out += "{{ " + subject(level) + "tags";
+
+    for (int i(1); i < shape.filterChainLength; ++i)
+    {
+      if (i % 2 == 1)
+        out += " | push: '" + rng.word() + "'";
+      else
+        out += " | pop";
+    }
+
+    out += " | join: ', ' }}\n";
+  }
+
+  void writeStatement(std::string& out, int level, int index)
+  {
+    if (rng.chance(shape.textRatio))
+    {
+      out += rng.sentence(rng.range(4, 12));
+      out += "\n";
+      return;
+    }
+
+    switch (index % (shape.filterChainLength > 0 ? 3 : 2))
+    {
+    case 0:
+      out += "{{ " + subject(level) + "name }}: {{ ";
+      writeExpression(out, level);
+      out += " }}\n";
+      break;
+    case 1:
+      out += "{% if ";
+      writeCondition(out, level);
+      out += " %}" + rng.sentence(3) + "{% else %}" + rng.sentence(2) + "{% endif %}\n";
+      break;
+    default:
+      writeFilterChain(out, level);
+      break;
+    }
+  }
+
+  void writeBlock(std::string& out, int level)
+  {
+    for (int i(0); i < shape.statements; ++i)
+    {
+      if (i == shape.statements / 2 && level < shape.depth)
+        writeLoop(out, level);
+
+      writeStatement(out, level, i);
+    }
+
+    if (shape.statements == 0 && level < shape.depth)
+      writeLoop(out, level);
+  }
+
+  void writeLoop(std::string& out, int level)
+  {
+    const std::string var = "item" + std::to_string(level);
+    out += "{% for " + var + " in " + subject(level) + (level == 0 ? "items" : "children") + " %}\n";
+
+    for (int i(0); i < shape.includeFanout; ++i)
+      out += "{% include partial" + std::to_string(i) + " with item = " + var + " %}";
+
+    writeBlock(out, level + 1);
+    out += "{% endfor %}\n";
+  }
+
+  std::string makePartial()
+  {
+    return "<{{ include.item.name }} {{ include.item.value }}>" + rng.sentence(3) + "\n";
+  }
+};
+
+} // namespace
+
+/*!
+ * \fn liquid::Trace generate(const Shape& shape)
+ * \brief generates a template with the given shape together with matching data
+ *
+ * The result has the same layout as a recorded trace: the source of the template,
+ * the partials it includes (named 'partial0', 'partial1', ...) and the data
+ * that must be used to render it.
+ * The same shape and seed always produce the same template and data.
+ */
+liquid::Trace generate(const Shape& shape)
+{
+  Generator gen{ shape };
+  liquid::Trace result;
+
+  result.filePath = "corpus";
+  gen.writeBlock(result.source, 0);
+
+  for (int i(0); i < shape.includeFanout; ++i)
+    result.partials["partial" + std::to_string(i)] = gen.makePartial();
+
+  gen.fillNode(result.data, 0);
+
+  return result;
+}
+
+} // namespace corpus
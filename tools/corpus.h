@@ -0,0 +1,60 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIQUID_CORPUS_H
+#define LIQUID_CORPUS_H
+
+#include "liquid/trace.h"
+
+#include <cstdint>
+#include <string>
+
+namespace corpus
+{
+
+/*!
+ * \class Random
+ * \brief a small deterministic pseudo-random generator
+ *
+ * Unlike the distributions of <random>, the sequence produced by this
+ * generator is the same on every platform, so that generated templates
+ * and data are identical across machines and commits.
+ */
+class Random
+{
+public:
+  explicit Random(uint64_t seed = 0x2545F4914F6CDD1DULL);
+
+  uint64_t next();
+  int range(int min, int max);
+  bool chance(int percent);
+
+  std::string word();
+  std::string sentence(int nbwords);
+
+private:
+  uint64_t m_state;
+};
+
+/*!
+ * \class Shape
+ * \brief describes the shape of a generated template
+ */
+struct Shape
+{
+  int depth = 2;             // number of nested for-loops
+  int loopCount = 4;         // number of iterations of each loop
+  int statements = 4;        // number of text, output and if statements in each block
+  int includeFanout = 0;     // number of partials included in each loop body
+  int expressionLength = 2;  // number of operands in outputs and conditions
+  int textRatio = 50;        // percentage of the statements that are plain text
+  int filterChainLength = 0; // number of filters applied in each output
+  uint64_t seed = 1;
+};
+
+liquid::Trace generate(const Shape& shape);
+
+} // namespace corpus
+
+#endif // LIQUID_CORPUS_H
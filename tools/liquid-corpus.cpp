@@ -0,0 +1,86 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// Generates a synthetic template and its data as a trace bundle
+// that can be rendered with liquid-replay.
+//
+// usage: liquid-corpus [options] [-o output.json]
+
+#include "corpus.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+static void print_usage()
+{
+  std::cerr << "usage: liquid-corpus [options] [-o output.json]\n"
+    "options:\n"
+    "  --depth N               number of nested loops\n"
+    "  --loop-count N          number of iterations of each loop\n"
+    "  --statements N          number of statements in each block\n"
+    "  --includes N            number of partials included in each loop body\n"
+    "  --expression-length N   number of operands in outputs and conditions\n"
+    "  --text-ratio P          percentage of statements that are plain text\n"
+    "  --filter-chain N        number of filters applied in filtered outputs\n"
+    "  --seed N                seed of the generator\n"
+    "  --source-only           only writes the template source\n";
+}
+
+int main(int argc, char* argv[])
+{
+  corpus::Shape shape;
+  std::string output;
+  bool source_only = false;
+
+  std::map<std::string, int*> int_options = {
+    { "--depth", &shape.depth },
+    { "--loop-count", &shape.loopCount },
+    { "--statements", &shape.statements },
+    { "--includes", &shape.includeFanout },
+    { "--expression-length", &shape.expressionLength },
+    { "--text-ratio", &shape.textRatio },
+    { "--filter-chain", &shape.filterChainLength },
+  };
+
+  for (int i(1); i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    auto it = int_options.find(arg);
+
+    if (it != int_options.end() && i + 1 < argc)
+      *it->second = std::max(0, std::atoi(argv[++i]));
+    else if (arg == "--seed" && i + 1 < argc)
+      shape.seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "-o" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "--source-only")
+      source_only = true;
+    else if (arg == "-h" || arg == "--help")
+      return print_usage(), 0;
+    else
+      return print_usage(), 1;
+  }
+
+  try
+  {
+    liquid::Trace trace = corpus::generate(shape);
+
+    if (source_only)
+      std::cout << trace.source;
+    else if (output.empty())
+      std::cout << trace.toJson() << std::endl;
+    else
+      trace.save(output);
+  }
+  catch (const std::exception& ex)
+  {
+    std::cerr << "error: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the liquid project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+// Replays a trace recorded with Renderer::setRecording().
+//
+// usage: liquid-replay [-n iterations] [--print] [--anonymize output.json] bundle.json
+
+#include "liquid/parser.h"
+#include "liquid/renderer.h"
+#include "liquid/template.h"
+#include "liquid/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_usage()
+{
+  std::cerr << "usage: liquid-replay [-n iterations] [--print] [--anonymize output.json] bundle.json" << std::endl;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+  size_t index = static_cast<size_t>(p / 100. * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted.at(std::min(index, sorted.size() - 1));
+}
+
+int main(int argc, char* argv[])
+{
+  int iterations = 100;
+  bool print = false;
+  std::string anonymize_output;
+  std::string bundle_path;
+
+  for (int i(1); i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if (arg == "-n" && i + 1 < argc)
+      iterations = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--print")
+      print = true;
+    else if (arg == "--anonymize" && i + 1 < argc)
+      anonymize_output = argv[++i];
+    else if (arg == "-h" || arg == "--help")
+      return print_usage(), 0;
+    else if (!arg.empty() && arg[0] != '-' && bundle_path.empty())
+      bundle_path = arg;
+    else
+      return print_usage(), 1;
+  }
+
+  if (bundle_path.empty())
+    return print_usage(), 1;
+
+  try
+  {
+    liquid::Trace trace = liquid::Trace::load(bundle_path);
+
+    if (!anonymize_output.empty())
+    {
+      trace.anonymize();
+      trace.save(anonymize_output);
+      std::cout << "anonymized trace written to " << anonymize_output << std::endl;
+      return 0;
+    }
+
+    auto parse_start = std::chrono::steady_clock::now();
+
+    liquid::Renderer renderer;
+    liquid::Template tmplt = liquid::parse(trace.source, trace.filePath);
+
+    for (const auto& p : trace.partials)
+      renderer.templates()[p.first] = liquid::parse(p.second, p.first);
+
+    auto parse_end = std::chrono::steady_clock::now();
+
+    std::vector<double> timings;
+    timings.reserve(static_cast<size_t>(iterations));
+    std::string output;
+
+    for (int i(0); i < iterations; ++i)
+    {
+      auto start = std::chrono::steady_clock::now();
+      output = renderer.render(tmplt, trace.data);
+      auto end = std::chrono::steady_clock::now();
+      timings.push_back(elapsed_us(start, end));
+    }
+
+    if (print)
+      std::cout << output << std::endl;
+
+    double total = 0;
+
+    for (double t : timings)
+      total += t;
+
+    std::sort(timings.begin(), timings.end());
+
+    std::cout << "template:   " << (trace.filePath.empty() ? "<unnamed>" : trace.filePath)
+      << " (" << trace.source.size() << " bytes, " << trace.partials.size() << " partials)" << std::endl;
+    std::cout << "parse:      " << elapsed_us(parse_start, parse_end) << " us" << std::endl;
+    std::cout << "renders:    " << iterations << std::endl;
+    std::cout << "output:     " << output.size() << " bytes, " << renderer.errors().size() << " errors" << std::endl;
+    std::cout << "min:        " << timings.front() << " us" << std::endl;
+    std::cout << "median:     " << percentile(timings, 50) << " us" << std::endl;
+    std::cout << "mean:       " << total / iterations << " us" << std::endl;
+    std::cout << "p99:        " << percentile(timings, 99) << " us" << std::endl;
+    std::cout << "max:        " << timings.back() << " us" << std::endl;
+  }
+  catch (const liquid::ParserException& ex)
+  {
+    std::cerr << bundle_path << ": parsing error at offset " << ex.offset_ << ": " << ex.message_ << std::endl;
+    return 1;
+  }
+  catch (const std::exception& ex)
+  {
+    std::cerr << "error: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}